@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_allocator_h
+#define cu_allocator_h 1
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "cu_debug.h"
+
+
+/*
+ * Memory source of a cu_memblock and so of every container. An allocator
+ * is a table of functions plus a user context passed back to each of them.
+ * Sizes are passed back to realloc and free so that allocators not
+ * tracking them (arenas, mmap) can be plugged in.
+ */
+struct cu_allocator {
+	void* (*alloc)(void* ctx, size_t s);
+	void* (*realloc)(void* ctx, void* p, size_t old_size, size_t s);
+	void (*free)(void* ctx, void* p, size_t s);
+	void* ctx;
+};
+
+
+/* cache line size, alignment of cu_allocator_cacheline() blocks */
+#define cu_ALLOCATOR_CACHELINE (unsigned int)64
+
+/* posix_memalign is only declared with _POSIX_C_SOURCE >= 200112L (implied
+ * by gnu99 and _GNU_SOURCE). Strict C99 builds over-allocate with malloc
+ * and keep the pointer to free in the word before the aligned block. */
+#if defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200112L
+#define cu_ALLOCATOR_POSIX_MEMALIGN 1
+#endif
+
+
+/**
+ * Returns the default allocator, a wrapper of malloc/realloc/free
+ */
+inline const struct cu_allocator* cu_allocator_heap(void);
+
+/**
+ * Fills an allocator returning blocks aligned to a given boundary
+ * @a cu_allocator to be filled
+ * @alignment power of two, at least sizeof(void*)
+ *
+ * Blocks come from posix_memalign where available. Resizing a block
+ * copies it to a new aligned one, so on failure the old block is left
+ * untouched.
+ */
+inline void cu_allocator_aligned(struct cu_allocator* a,
+                                 unsigned int alignment);
+
+/**
+ * Returns an allocator whose blocks are cache line aligned
+ */
+inline const struct cu_allocator* cu_allocator_cacheline(void);
+
+
+
+/* protected api */
+
+inline void* cu_allocator_heap_alloc(void* ctx, size_t s);
+inline void* cu_allocator_heap_realloc(void* ctx, void* p, size_t old_size, size_t s);
+inline void cu_allocator_heap_free(void* ctx, void* p, size_t s);
+
+/* ctx holds the alignment */
+inline void* cu_allocator_aligned_alloc(void* ctx, size_t s);
+inline void* cu_allocator_aligned_realloc(void* ctx, void* p, size_t old_size, size_t s);
+inline void cu_allocator_aligned_free(void* ctx, void* p, size_t s);
+
+
+void* cu_allocator_heap_alloc(void* ctx, size_t s)
+{
+	(void)ctx;
+	return malloc(s);
+}
+
+
+void* cu_allocator_heap_realloc(void* ctx, void* p, size_t old_size, size_t s)
+{
+	(void)ctx;
+	(void)old_size;
+	return realloc(p, s);
+}
+
+
+void cu_allocator_heap_free(void* ctx, void* p, size_t s)
+{
+	(void)ctx;
+	(void)s;
+	free(p);
+}
+
+
+const struct cu_allocator* cu_allocator_heap(void)
+{
+	static const struct cu_allocator heap = {
+		cu_allocator_heap_alloc,
+		cu_allocator_heap_realloc,
+		cu_allocator_heap_free,
+		NULL
+	};
+	return &heap;
+}
+
+
+void* cu_allocator_aligned_alloc(void* ctx, size_t s)
+{
+	void* p;
+#ifdef cu_ALLOCATOR_POSIX_MEMALIGN
+	if (posix_memalign(&p, (size_t)(uintptr_t)ctx, s))
+		return NULL;
+#else
+	size_t alignment = (size_t)(uintptr_t)ctx;
+	void* m;
+
+	if (s > SIZE_MAX - alignment)
+		return NULL;
+	m = malloc(s + alignment);
+	if (!m)
+		return NULL;
+	/* at least one word past m, both being word aligned */
+	p = (void*)(((uintptr_t)m + alignment) & ~((uintptr_t)alignment - 1));
+	((void**)p)[-1] = m;
+#endif
+	return p;
+}
+
+
+void* cu_allocator_aligned_realloc(void* ctx, void* p, size_t old_size, size_t s)
+{
+	void* q;
+
+	/* realloc could move the block to a misaligned address and, once it
+	 * has, a failing aligned copy would lose it: always copy instead */
+	if (p && s == old_size)
+		return p;
+	q = cu_allocator_aligned_alloc(ctx, s);
+	if (!q)
+		return NULL;
+	if (p) {
+		memcpy(q, p, old_size < s ? old_size : s);
+		cu_allocator_aligned_free(ctx, p, old_size);
+	}
+	return q;
+}
+
+
+void cu_allocator_aligned_free(void* ctx, void* p, size_t s)
+{
+	(void)ctx;
+	(void)s;
+#ifdef cu_ALLOCATOR_POSIX_MEMALIGN
+	free(p);
+#else
+	if (p)
+		free(((void**)p)[-1]);
+#endif
+}
+
+
+void cu_allocator_aligned(struct cu_allocator* a,
+                          unsigned int alignment)
+{
+	assert(a);
+	assert(alignment >= sizeof(void*));
+	assert(!(alignment & (alignment - 1)));
+	a->alloc = cu_allocator_aligned_alloc;
+	a->realloc = cu_allocator_aligned_realloc;
+	a->free = cu_allocator_aligned_free;
+	a->ctx = (void*)(uintptr_t)alignment;
+}
+
+
+const struct cu_allocator* cu_allocator_cacheline(void)
+{
+	static const struct cu_allocator cacheline = {
+		cu_allocator_aligned_alloc,
+		cu_allocator_aligned_realloc,
+		cu_allocator_aligned_free,
+		(void*)(uintptr_t)cu_ALLOCATOR_CACHELINE
+	};
+	return &cacheline;
+}
+
+
+#endif /* cu_allocator_h */
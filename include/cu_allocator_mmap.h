@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_allocator_mmap_h
+#define cu_allocator_mmap_h 1
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "cu_debug.h"
+#include "cu_allocator.h"
+
+
+/*
+ * An allocator backing large blocks with anonymous mmap, optionally on
+ * huge pages, and small ones with cache line aligned heap memory. Mapped
+ * blocks are page aligned and grow with mremap where available (Linux,
+ * define _GNU_SOURCE before including any header), else by copying.
+ */
+
+/* blocks of at least this size are mapped when no threshold is given */
+#define cu_ALLOCATOR_MMAP_DEFAULT_THRESHOLD (size_t)(1024*1024)
+
+/* huge page size assumed for rounding mapped blocks */
+#define cu_ALLOCATOR_MMAP_HUGE_PAGE_SIZE (unsigned int)(2*1024*1024)
+
+/* flags */
+#define cu_ALLOCATOR_MMAP_THP     0x1	/* madvise(MADV_HUGEPAGE) mapped blocks */
+#define cu_ALLOCATOR_MMAP_HUGETLB 0x2	/* try MAP_HUGETLB first, fall back to
+					   a normal (THP advised) mapping */
+
+
+struct cu_allocator_mmap {
+	/* private */
+	struct cu_allocator allocator;
+	size_t threshold;	/* smaller blocks come from the heap */
+	unsigned int flags;
+};
+
+
+/**
+ * Inits an mmap allocator
+ * @ma cu_allocator_mmap to be used
+ * @threshold size (in bytes) from which blocks are mapped, 0 selects
+ *   cu_ALLOCATOR_MMAP_DEFAULT_THRESHOLD
+ * @flags or-ed cu_ALLOCATOR_MMAP_* flags
+ */
+inline void cu_allocator_mmap_init(struct cu_allocator_mmap* ma,
+                                   size_t threshold,
+                                   unsigned int flags);
+
+/**
+ * Returns the cu_allocator interface of an mmap allocator
+ * @ma cu_allocator_mmap to be used
+ */
+inline const struct cu_allocator* cu_allocator_mmap_get(struct cu_allocator_mmap* ma);
+
+
+
+/* protected api */
+
+/* length of the mapping holding a block of s bytes */
+inline size_t cu_allocator_mmap_length(struct cu_allocator_mmap* ma,
+                                       size_t s);
+
+/* cu_allocator callbacks, ctx is the cu_allocator_mmap */
+inline void* cu_allocator_mmap_alloc(void* ctx, size_t s);
+inline void* cu_allocator_mmap_realloc(void* ctx, void* p, size_t old_size, size_t s);
+inline void cu_allocator_mmap_free(void* ctx, void* p, size_t s);
+
+
+size_t cu_allocator_mmap_length(struct cu_allocator_mmap* ma,
+                                size_t s)
+{
+	size_t page = ma->flags ? cu_ALLOCATOR_MMAP_HUGE_PAGE_SIZE : 4096;
+	return ((size_t)s + page - 1) & ~(page - 1);
+}
+
+
+void* cu_allocator_mmap_alloc(void* ctx, size_t s)
+{
+	struct cu_allocator_mmap* ma = (struct cu_allocator_mmap*)ctx;
+	size_t len = cu_allocator_mmap_length(ma, s);
+	void* p = MAP_FAILED;
+
+	if (s < ma->threshold)
+		return cu_allocator_aligned_alloc((void*)(uintptr_t)cu_ALLOCATOR_CACHELINE, s);
+
+#ifdef MAP_HUGETLB
+	if (ma->flags & cu_ALLOCATOR_MMAP_HUGETLB)
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+	if (p == MAP_FAILED) {
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			return NULL;
+#ifdef MADV_HUGEPAGE
+		if (ma->flags)
+			madvise(p, len, MADV_HUGEPAGE);
+#endif
+	}
+	return p;
+}
+
+
+void* cu_allocator_mmap_realloc(void* ctx, void* p, size_t old_size, size_t s)
+{
+	struct cu_allocator_mmap* ma = (struct cu_allocator_mmap*)ctx;
+	void* q;
+
+	if (old_size < ma->threshold && s < ma->threshold)
+		return cu_allocator_aligned_realloc((void*)(uintptr_t)cu_ALLOCATOR_CACHELINE,
+		                                    p, old_size, s);
+
+	if (old_size >= ma->threshold && s >= ma->threshold) {
+		size_t old_len = cu_allocator_mmap_length(ma, old_size);
+		size_t len = cu_allocator_mmap_length(ma, s);
+
+		if (len == old_len)
+			return p;
+#ifdef MREMAP_MAYMOVE
+		/* move the pages instead of copying their contents */
+		q = mremap(p, old_len, len, MREMAP_MAYMOVE);
+		if (q == MAP_FAILED)
+			return NULL;
+#ifdef MADV_HUGEPAGE
+		if (ma->flags && len > old_len)
+			madvise(q, len, MADV_HUGEPAGE);
+#endif
+		return q;
+#endif
+	}
+
+	/* crossing the threshold (or no mremap), copy */
+	q = cu_allocator_mmap_alloc(ctx, s);
+	if (!q)
+		return NULL;
+	memcpy(q, p, old_size < s ? old_size : s);
+	cu_allocator_mmap_free(ctx, p, old_size);
+	return q;
+}
+
+
+void cu_allocator_mmap_free(void* ctx, void* p, size_t s)
+{
+	struct cu_allocator_mmap* ma = (struct cu_allocator_mmap*)ctx;
+
+	if (s < ma->threshold)
+		cu_allocator_aligned_free((void*)(uintptr_t)cu_ALLOCATOR_CACHELINE, p, s);
+	else
+		munmap(p, cu_allocator_mmap_length(ma, s));
+}
+
+
+
+void cu_allocator_mmap_init(struct cu_allocator_mmap* ma,
+                            size_t threshold,
+                            unsigned int flags)
+{
+	assert(ma);
+	ma->threshold = threshold ? threshold : cu_ALLOCATOR_MMAP_DEFAULT_THRESHOLD;
+	ma->flags = flags;
+	ma->allocator.alloc = cu_allocator_mmap_alloc;
+	ma->allocator.realloc = cu_allocator_mmap_realloc;
+	ma->allocator.free = cu_allocator_mmap_free;
+	ma->allocator.ctx = ma;
+}
+
+
+const struct cu_allocator* cu_allocator_mmap_get(struct cu_allocator_mmap* ma)
+{
+	assert(ma);
+	return &ma->allocator;
+}
+
+
+#endif /* cu_allocator_mmap_h */
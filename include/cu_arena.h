@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_arena_h
+#define cu_arena_h 1
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cu_debug.h"
+#include "cu_allocator.h"
+
+
+/*
+ * A region allocator: memory is bump allocated from chunks obtained with
+ * malloc and released all at once by cu_arena_reset, cu_arena_rewind or
+ * cu_arena_deinit. Single allocations are never freed.
+ *
+ * cu_arena_allocator exposes the arena as a cu_allocator, so that any
+ * container can be inited against it.
+ */
+
+/* alignment of every allocation, enough for any basic type */
+#define cu_ARENA_ALIGN (size_t)16
+
+/* default size of a chunk */
+#define cu_ARENA_DEFAULT_CHUNK_SIZE (size_t)(64*1024)
+
+
+struct cu_arena_chunk {
+	/* private */
+	struct cu_arena_chunk* prev;
+	size_t size;	/* usable bytes after the header */
+	size_t used;	/* bytes handed out */
+};
+
+
+struct cu_arena {
+	/* private */
+	struct cu_arena_chunk* head;	/* chunk allocations come from */
+	size_t chunk_size;	/* minimum size of new chunks */
+	void* last;			/* last allocation, may grow in place */
+	struct cu_allocator allocator;	/* see cu_arena_allocator */
+};
+
+
+/* a saved allocation point, see cu_arena_mark */
+struct cu_arena_mark {
+	/* private */
+	struct cu_arena_chunk* chunk;
+	size_t used;
+};
+
+
+/**
+ * Inits an empty arena
+ * @a cu_arena to be used
+ * @chunk_size minimum size of the chunks allocated with malloc, 0 selects
+ *   cu_ARENA_DEFAULT_CHUNK_SIZE
+ */
+inline void cu_arena_init(struct cu_arena* a,
+                          size_t chunk_size);
+
+/**
+ * Deinits an arena freeing all its memory
+ * @a cu_arena to be used
+ */
+inline void cu_arena_deinit(struct cu_arena* a);
+
+/**
+ * Allocates memory from an arena
+ * @a cu_arena to be used
+ * @s number of bytes
+ *
+ * The returned memory is aligned to cu_ARENA_ALIGN.
+ */
+inline void* cu_arena_alloc(struct cu_arena* a,
+                            size_t s);
+
+/**
+ * Returns an allocator drawing from the arena
+ * @a cu_arena to be used
+ *
+ * Frees through the allocator are no-ops, memory goes back to the arena
+ * on reset, rewind or deinit.
+ */
+inline const struct cu_allocator* cu_arena_allocator(struct cu_arena* a);
+
+/**
+ * Resizes an allocation
+ * @a cu_arena to be used
+ * @p allocation to be resized, NULL allocates
+ * @old_size current size of p
+ * @s new size
+ *
+ * The most recent allocation is resized in place when its chunk has room,
+ * any other is copied to a new allocation (the old memory is not reused
+ * until the arena is reset).
+ */
+inline void* cu_arena_realloc(struct cu_arena* a,
+                              void* p,
+                              size_t old_size,
+                              size_t s);
+
+/**
+ * Returns the current allocation point
+ * @a cu_arena to be used
+ */
+inline struct cu_arena_mark cu_arena_mark(struct cu_arena* a);
+
+/**
+ * Frees everything allocated after a given allocation point
+ * @a cu_arena to be used
+ * @m value returned by a previous cu_arena_mark
+ */
+inline void cu_arena_rewind(struct cu_arena* a,
+                            struct cu_arena_mark m);
+
+/**
+ * Frees everything allocated in the arena
+ * @a cu_arena to be used
+ *
+ * The most recent chunk is kept for the next allocations.
+ */
+inline void cu_arena_reset(struct cu_arena* a);
+
+
+
+/* chunk data starts right after the header, rounded to the alignment */
+#define cu_ARENA_ROUND(s) (((s) + cu_ARENA_ALIGN - 1) & ~(cu_ARENA_ALIGN - 1))
+#define cu_ARENA_CHUNK_DATA(c) ((char*)(c) + cu_ARENA_ROUND(sizeof(struct cu_arena_chunk)))
+
+/* cu_allocator callbacks, ctx is the arena */
+inline void* cu_arena_allocator_alloc(void* ctx, size_t s);
+inline void* cu_arena_allocator_realloc(void* ctx, void* p, size_t old_size, size_t s);
+inline void cu_arena_allocator_free(void* ctx, void* p, size_t s);
+
+
+void cu_arena_init(struct cu_arena* a,
+                   size_t chunk_size)
+{
+	assert(a);
+	a->head = NULL;
+	a->chunk_size = chunk_size ? chunk_size : cu_ARENA_DEFAULT_CHUNK_SIZE;
+	a->last = NULL;
+	a->allocator.alloc = cu_arena_allocator_alloc;
+	a->allocator.realloc = cu_arena_allocator_realloc;
+	a->allocator.free = cu_arena_allocator_free;
+	a->allocator.ctx = a;
+}
+
+
+void cu_arena_deinit(struct cu_arena* a)
+{
+	assert(a);
+	while (a->head) {
+		struct cu_arena_chunk* prev = a->head->prev;
+		free(a->head);
+		a->head = prev;
+	}
+	a->last = NULL;
+}
+
+
+void* cu_arena_alloc(struct cu_arena* a,
+                     size_t s)
+{
+	assert(a);
+	assert(s);
+	/* rounding, or adding the chunk header, must not wrap around */
+	if (s > SIZE_MAX - cu_ARENA_ALIGN) {
+		printf("warning cu_arena_alloc, size overflows\n");
+		assert(0);
+		return NULL;
+	}
+	s = cu_ARENA_ROUND(s);
+
+	if (!a->head || a->head->size - a->head->used < s) {
+		size_t size = s > a->chunk_size ? s : a->chunk_size;
+		if (size > SIZE_MAX - cu_ARENA_ROUND(sizeof(struct cu_arena_chunk))) {
+			printf("warning cu_arena_alloc, size overflows\n");
+			assert(0);
+			return NULL;
+		}
+		struct cu_arena_chunk* c = (struct cu_arena_chunk*)
+			malloc(cu_ARENA_ROUND(sizeof(struct cu_arena_chunk)) + size);
+
+		if (!c) {
+			printf("warning cu_arena_alloc, malloc failed\n");
+			assert(0);
+			return NULL;
+		}
+		c->prev = a->head;
+		c->size = size;
+		c->used = 0;
+		a->head = c;
+	}
+
+	a->last = cu_ARENA_CHUNK_DATA(a->head) + a->head->used;
+	a->head->used += s;
+	return a->last;
+}
+
+
+void* cu_arena_realloc(struct cu_arena* a,
+                       void* p,
+                       size_t old_size,
+                       size_t s)
+{
+	assert(a);
+	assert(s);
+	if (!p)
+		return cu_arena_alloc(a, s);
+
+	/* grow or shrink the most recent allocation in place */
+	if (p == a->last && s <= SIZE_MAX - cu_ARENA_ALIGN) {
+		size_t offset = (char*)p - cu_ARENA_CHUNK_DATA(a->head);
+		if (a->head->size - offset >= cu_ARENA_ROUND(s)) {
+			a->head->used = offset + cu_ARENA_ROUND(s);
+			return p;
+		}
+	}
+
+	void* q = cu_arena_alloc(a, s);
+	if (!q)
+		return NULL;
+	memcpy(q, p, old_size < s ? old_size : s);
+	return q;
+}
+
+
+const struct cu_allocator* cu_arena_allocator(struct cu_arena* a)
+{
+	assert(a);
+	return &a->allocator;
+}
+
+
+void* cu_arena_allocator_alloc(void* ctx, size_t s)
+{
+	return cu_arena_alloc((struct cu_arena*)ctx, s);
+}
+
+
+void* cu_arena_allocator_realloc(void* ctx, void* p, size_t old_size, size_t s)
+{
+	return cu_arena_realloc((struct cu_arena*)ctx, p, old_size, s);
+}
+
+
+void cu_arena_allocator_free(void* ctx, void* p, size_t s)
+{
+	(void)ctx;
+	(void)p;
+	(void)s;
+}
+
+
+struct cu_arena_mark cu_arena_mark(struct cu_arena* a)
+{
+	assert(a);
+	struct cu_arena_mark m;
+	m.chunk = a->head;
+	m.used = a->head ? a->head->used : 0;
+	return m;
+}
+
+
+void cu_arena_rewind(struct cu_arena* a,
+                     struct cu_arena_mark m)
+{
+	assert(a);
+	while (a->head != m.chunk) {
+		assert(a->head);
+		struct cu_arena_chunk* prev = a->head->prev;
+		free(a->head);
+		a->head = prev;
+	}
+	if (a->head)
+		a->head->used = m.used;
+	a->last = NULL;
+}
+
+
+void cu_arena_reset(struct cu_arena* a)
+{
+	assert(a);
+	if (!a->head)
+		return;
+
+	while (a->head->prev) {
+		struct cu_arena_chunk* prev = a->head->prev->prev;
+		free(a->head->prev);
+		a->head->prev = prev;
+	}
+	a->head->used = 0;
+	a->last = NULL;
+}
+
+
+#endif /* cu_arena_h */
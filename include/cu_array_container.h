@@ -25,23 +25,44 @@
 #define cu_array_container_h 1
 
 #include <stdio.h>
+#include <stdint.h>
 
 #include "cu_debug.h"
 #include "cu_memblock.h"
 
+/* mremap needs _GNU_SOURCE, without it the heap is used and the mmap
+ * allocator is not pulled in */
+#if defined(cu_ARRAY_CONTAINER_MMAP_THRESHOLD) && defined(_GNU_SOURCE)
+#include "cu_allocator_mmap.h"
+#endif
+
 
 /* protected api */
 
-/* minimum number of slots reserved in a cu_array_container
+/* default minimum number of slots reserved in a cu_array_container
  * ! must be a power of two  */
 #define cu_ARRAY_CONTAINER_MIN_RESERVED_SLOTS (unsigned int)32
 
+/* growth policies, see cu_array_container_set_growth */
+#define cu_ARRAY_CONTAINER_GROW_FACTOR     0	/* arg: factor in 1/16ths, 32 doubles */
+#define cu_ARRAY_CONTAINER_GROW_INCREMENT  1	/* arg: number of slots added */
+#define cu_ARRAY_CONTAINER_GROW_PAGE       2	/* doubles and rounds to pages of arg bytes */
+#define cu_ARRAY_CONTAINER_GROW_SIZE_CLASS 3	/* arg: factor as for GROW_FACTOR, rounded
+						   to the allocator size classes */
+
+/* page size used by cu_ARRAY_CONTAINER_GROW_PAGE when arg is 0 */
+#define cu_ARRAY_CONTAINER_PAGE_SIZE (unsigned int)4096
+
 
 struct cu_array_container {
 	/* private */
 	struct cu_memblock mblock;
-	unsigned int size;	 /* in slots */
-	unsigned int reserved; /* reserved memory (in slots) */
+	size_t size;	 /* in slots */
+	size_t reserved; /* reserved memory (in slots) */
+	size_t slot_size;	/* in bytes */
+	size_t min_reserved; /* lower bound for reserved */
+	unsigned int growth;	/* cu_ARRAY_CONTAINER_GROW_* */
+	unsigned int growth_arg;
 };
 
 
@@ -50,7 +71,17 @@ struct cu_array_container {
  * @ac cu_array_container to be used
  * @slot_size slots size (in bytes)
  */
-inline void cu_array_container_init(struct cu_array_container* ac, unsigned int slot_size);
+inline void cu_array_container_init(struct cu_array_container* ac, size_t slot_size);
+
+/**
+ * Inits a cu_array_container whose memory comes from an allocator
+ * @ac cu_array_container to be used
+ * @a allocator to be used, NULL for cu_array_container_default_allocator()
+ * @slot_size slots size (in bytes)
+ */
+inline void cu_array_container_init_allocator(struct cu_array_container* ac,
+                                              const struct cu_allocator* a,
+                                              size_t slot_size);
 
 /**
  * Deinits a cu_array_container
@@ -60,8 +91,59 @@ inline void cu_array_container_deinit(struct cu_array_container* ac);
 
 /**
  * Clears the container
+ *
+ * Reserved memory is kept for refilling, see cu_array_container_shrink_to_fit.
+ */
+inline void cu_array_container_clear(struct cu_array_container* ac, size_t slot_size);
+
+/**
+ * Releases the reserved memory not used by the container
+ * @ac cu_array_container to be used
+ *
+ * The container keeps at least its minimum number of reserved slots.
+ */
+inline void cu_array_container_shrink_to_fit(struct cu_array_container* ac);
+
+/**
+ * Sets how the container grows when full
+ * @ac cu_array_container to be used
+ * @policy one of cu_ARRAY_CONTAINER_GROW_*
+ * @arg policy argument, 0 selects the policy's default (a factor of 2,
+ *   1 slot or cu_ARRAY_CONTAINER_PAGE_SIZE)
+ *
+ * Containers are inited with cu_ARRAY_CONTAINER_GROW_FACTOR and a factor of 2.
+ */
+inline void cu_array_container_set_growth(struct cu_array_container* ac,
+                                          unsigned int policy,
+                                          unsigned int arg);
+
+/**
+ * Sets the minimum number of reserved slots
+ * @ac cu_array_container to be used
+ * @num_slots new minimum, reserving more memory if needed
+ *
+ * Containers are inited with cu_ARRAY_CONTAINER_MIN_RESERVED_SLOTS.
  */
-inline void cu_array_container_clear(struct cu_array_container* ac, unsigned int slot_size);
+inline void cu_array_container_set_min_reserved(struct cu_array_container* ac,
+                                                size_t num_slots);
+
+
+/**
+ * Returns the allocator used by containers inited without one
+ *
+ * With cu_ARRAY_CONTAINER_MMAP_THRESHOLD set, _GNU_SOURCE defined and
+ * mremap available this is a cu_allocator_mmap, small blocks stay on the
+ * heap and large ones grow without copying. Otherwise it is
+ * cu_allocator_heap().
+ */
+inline const struct cu_allocator* cu_array_container_default_allocator(void);
+
+
+/**
+ * Returns num_slots*slot_size, or SIZE_MAX (making the allocation fail)
+ * when the product overflows
+ */
+inline size_t cu_array_container_bytes(size_t num_slots, size_t slot_size);
 
 
 /**
@@ -71,6 +153,18 @@ inline void cu_array_container_clear(struct cu_array_container* ac, unsigned int
 inline void cu_array_container_grow_once(struct cu_array_container* ac);
 
 
+/**
+ * Grows the container, with a single reallocation, so that it reserves at
+ * least the given number of slots
+ * @ac cu_array_container to be used
+ * @min_slots minimum number of slots
+ *
+ * The growth policy is followed unless it doesn't give enough slots.
+ */
+inline void cu_array_container_grow_to(struct cu_array_container* ac,
+                                       size_t min_slots);
+
+
 /**
  * Reserves container memory for the given number of slots
  * @ac cu_array_container to be used
@@ -79,8 +173,8 @@ inline void cu_array_container_grow_once(struct cu_array_container* ac);
  *
  * The number of slots reserved will be the nearest higher power of two for num_slots
  */
-inline void cu_array_container_reserve(struct cu_array_container* ac, unsigned int slot_size,
-                                       unsigned int num_slots);
+inline void cu_array_container_reserve(struct cu_array_container* ac, size_t slot_size,
+                                       size_t num_slots);
 
 
 /**
@@ -89,68 +183,188 @@ inline void cu_array_container_reserve(struct cu_array_container* ac, unsigned i
 inline void cu_array_container_check_size_and_grow(struct cu_array_container* ac);
 
 
+/**
+ * Returns the nearest power of two not less than num_slots, SIZE_MAX
+ * when no power of two is big enough
+ * @num_slots a number of slots, not 0
+ */
+inline size_t cu_array_container_round_pow2(size_t num_slots);
+
 
 
-void cu_array_container_init(struct cu_array_container* ac, unsigned int slot_size) {
+
+void cu_array_container_init(struct cu_array_container* ac, size_t slot_size) {
+	cu_array_container_init_allocator(ac, NULL, slot_size);
+}
+
+
+void cu_array_container_init_allocator(struct cu_array_container* ac,
+                                       const struct cu_allocator* a,
+                                       size_t slot_size)
+{
 	assert(ac);
 	assert(slot_size);
 	ac->reserved = cu_ARRAY_CONTAINER_MIN_RESERVED_SLOTS;
 	ac->size = 0;
-	cu_memblock_init(&ac->mblock, slot_size*cu_ARRAY_CONTAINER_MIN_RESERVED_SLOTS);
+	ac->slot_size = slot_size;
+	ac->min_reserved = cu_ARRAY_CONTAINER_MIN_RESERVED_SLOTS;
+	ac->growth = cu_ARRAY_CONTAINER_GROW_FACTOR;
+	ac->growth_arg = 32;
+	cu_memblock_init_allocator(&ac->mblock, a ? a : cu_array_container_default_allocator(),
+	                           slot_size*cu_ARRAY_CONTAINER_MIN_RESERVED_SLOTS);
 }
 
 
-inline void cu_array_container_deinit(struct cu_array_container* ac) {
+const struct cu_allocator* cu_array_container_default_allocator(void)
+{
+#if defined(cu_ARRAY_CONTAINER_MMAP_THRESHOLD) && defined(_GNU_SOURCE) && defined(MREMAP_MAYMOVE)
+	static struct cu_allocator_mmap ma = {
+		{ cu_allocator_mmap_alloc, cu_allocator_mmap_realloc, cu_allocator_mmap_free, &ma },
+		cu_ARRAY_CONTAINER_MMAP_THRESHOLD,
+		0
+	};
+	return &ma.allocator;
+#else
+	return cu_allocator_heap();
+#endif
+}
+
+
+void cu_array_container_deinit(struct cu_array_container* ac) {
 	assert(ac);
 	cu_memblock_deinit(&ac->mblock);
 }
 
 
-void cu_array_container_clear(struct cu_array_container* ac, unsigned int slot_size) {
+void cu_array_container_clear(struct cu_array_container* ac, size_t slot_size) {
 	assert(ac);
-	assert(slot_size);
-	ac->reserved = cu_ARRAY_CONTAINER_MIN_RESERVED_SLOTS;
+	assert(slot_size == ac->slot_size);
 	ac->size = 0;
-	cu_memblock_set_size(&ac->mblock, slot_size*cu_ARRAY_CONTAINER_MIN_RESERVED_SLOTS);
+}
+
+
+void cu_array_container_shrink_to_fit(struct cu_array_container* ac)
+{
+	assert(ac);
+	size_t num_slots = ac->size > ac->min_reserved ? ac->size : ac->min_reserved;
+
+	if (num_slots != ac->reserved) {
+		cu_memblock_set_size(&ac->mblock, cu_array_container_bytes(num_slots, ac->slot_size));
+		ac->reserved = num_slots;
+	}
+}
 
+
+void cu_array_container_set_growth(struct cu_array_container* ac,
+                                   unsigned int policy,
+                                   unsigned int arg)
+{
+	assert(ac);
+	assert(policy <= cu_ARRAY_CONTAINER_GROW_SIZE_CLASS);
+	if (!arg)
+		arg = policy == cu_ARRAY_CONTAINER_GROW_INCREMENT ? 1 :
+		      policy == cu_ARRAY_CONTAINER_GROW_PAGE ? cu_ARRAY_CONTAINER_PAGE_SIZE : 32;
+	/* a factor must grow */
+	assert(policy == cu_ARRAY_CONTAINER_GROW_INCREMENT
+	       || policy == cu_ARRAY_CONTAINER_GROW_PAGE || arg > 16);
+	ac->growth = policy;
+	ac->growth_arg = arg;
+}
+
+
+void cu_array_container_set_min_reserved(struct cu_array_container* ac,
+                                         size_t num_slots)
+{
+	assert(ac);
+	assert(num_slots);
+	ac->min_reserved = num_slots;
+	if (ac->reserved < num_slots) {
+		cu_memblock_set_size(&ac->mblock, cu_array_container_bytes(num_slots, ac->slot_size));
+		ac->reserved = num_slots;
+	}
+}
+
+
+size_t cu_array_container_bytes(size_t num_slots, size_t slot_size)
+{
+	if (num_slots > SIZE_MAX/slot_size) {
+		printf("warning cu_array_container_bytes, size overflow\n");
+		assert(0);
+		/* let the allocation fail */
+		return SIZE_MAX;
+	}
+	return num_slots*slot_size;
 }
 
 
 void cu_array_container_grow_once(struct cu_array_container* ac)
 {
 	assert(ac);
+	cu_array_container_grow_to(ac, ac->reserved < SIZE_MAX ? ac->reserved + 1 : SIZE_MAX);
+}
+
 
-	/* always grow by a factor of 2 */
-	cu_memblock_set_size(&ac->mblock, ac->mblock.size*2);
-	ac->reserved *= 2;  
+void cu_array_container_grow_to(struct cu_array_container* ac,
+                                size_t min_slots)
+{
+	assert(ac);
+	size_t num_slots, bytes;
+
+	if (min_slots <= ac->reserved)
+		return;
+
+	switch (ac->growth) {
+	case cu_ARRAY_CONTAINER_GROW_INCREMENT:
+		num_slots = ac->reserved + ac->growth_arg;
+		break;
+	case cu_ARRAY_CONTAINER_GROW_PAGE:
+		num_slots = ac->reserved*2;
+		break;
+	default:
+		/* reserved*growth_arg/16 without overflowing the product */
+		num_slots = ac->reserved/16*ac->growth_arg + ac->reserved%16*ac->growth_arg/16;
+		break;
+	}
+
+	/* grow to min_slots at least, this also covers overflows */
+	if (num_slots < min_slots)
+		num_slots = min_slots;
+	bytes = cu_array_container_bytes(num_slots, ac->slot_size);
+
+	if (ac->growth == cu_ARRAY_CONTAINER_GROW_PAGE) {
+		if (bytes <= SIZE_MAX - ac->growth_arg)
+			bytes = (bytes + ac->growth_arg - 1)/ac->growth_arg*ac->growth_arg;
+	} else if (ac->growth == cu_ARRAY_CONTAINER_GROW_SIZE_CLASS) {
+		/* four size classes per power of two, as jemalloc and most
+		 * malloc implementations use, never under 16 bytes apart */
+		size_t step = 16;
+		if (bytes > 64)
+			step = ((size_t)1 << (sizeof(unsigned long)*8 - 1 - __builtin_clzl(bytes - 1)))/4;
+		if (bytes <= SIZE_MAX - step)
+			bytes = (bytes + step - 1) & ~(step - 1);
+	}
+
+	cu_memblock_set_size(&ac->mblock, bytes);
+	ac->reserved = bytes/ac->slot_size;
 }
 
 
-void cu_array_container_reserve(struct cu_array_container* ac, unsigned int slot_size,
-				unsigned int num_slots)
+void cu_array_container_reserve(struct cu_array_container* ac, size_t slot_size,
+				size_t num_slots)
 {
 	assert(ac);
-	assert(slot_size);
+	assert(slot_size == ac->slot_size);
 	assert(num_slots);
 
 	/* respect lower threshold */
-	if (num_slots < cu_ARRAY_CONTAINER_MIN_RESERVED_SLOTS)
-		num_slots = cu_ARRAY_CONTAINER_MIN_RESERVED_SLOTS;
+	if (num_slots < ac->min_reserved)
+		num_slots = ac->min_reserved;
 	else 
-	{
-		/* compute the next highest power of 2 for num_slots */
-		num_slots--;
-		num_slots |= num_slots >> 1;
-		num_slots |= num_slots >> 2;
-		num_slots |= num_slots >> 4;
-		num_slots |= num_slots >> 8;
-		num_slots |= num_slots >> 16;
-		num_slots++;
-	}
+		num_slots = cu_array_container_round_pow2(num_slots);
 
 	if (ac->reserved != num_slots)
 	{
-		cu_memblock_set_size(&ac->mblock, num_slots*slot_size);
+		cu_memblock_set_size(&ac->mblock, cu_array_container_bytes(num_slots, slot_size));
 		ac->reserved = num_slots;
 		/* avoid weird values for size */
 		if (ac->size > ac->reserved)
@@ -159,6 +373,25 @@ void cu_array_container_reserve(struct cu_array_container* ac, unsigned int slot
 }
 
 
+size_t cu_array_container_round_pow2(size_t num_slots)
+{
+	assert(num_slots);
+	/* compute the next highest power of 2 for num_slots */
+	num_slots--;
+	num_slots |= num_slots >> 1;
+	num_slots |= num_slots >> 2;
+	num_slots |= num_slots >> 4;
+	num_slots |= num_slots >> 8;
+	num_slots |= num_slots >> 16;
+	num_slots |= num_slots >> 16 >> 16;
+	num_slots++;
+	/* no power of two is big enough */
+	if (!num_slots)
+		num_slots = SIZE_MAX;
+	return num_slots;
+}
+
+
 void cu_array_container_check_size_and_grow(struct cu_array_container* ac) {
 	assert(ac);
 	if (ac->reserved == ac->size) 
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_atomic_bitmap_h
+#define cu_atomic_bitmap_h 1
+
+#include <stdio.h>
+#include <stdatomic.h>
+
+#include "cu_debug.h"
+#include "cu_memblock.h"
+#include "cu_bitmap.h"
+
+
+/*
+ * A bitmap whose bits can be updated concurrently by several threads,
+ * needs C11 atomics. Storage words are the same as cu_bitmap's.
+ */
+
+/* bits sharing a cache line, threads claiming slots should start their
+ * scans at different multiples of this to avoid bouncing lines (see
+ * cu_atomic_bitmap_claim_first_zero) */
+#define cu_ATOMIC_BITMAP_LINE_BITS (unsigned int)(64*8)
+
+
+struct cu_atomic_bitmap {
+	/* private */
+	struct cu_memblock mblock; /* _Atomic cu_BITMAP_WORD, cache line aligned */
+	size_t size;               /* in bits */
+};
+
+
+/**
+ * Inits a cu_atomic_bitmap with all bits cleared
+ * @bm cu_atomic_bitmap to be used
+ * @size number of bits
+ *
+ * Init and deinit are not thread safe.
+ */
+inline void cu_atomic_bitmap_init(struct cu_atomic_bitmap* bm,
+                                  size_t size);
+
+/**
+ * Deinits a cu_atomic_bitmap
+ * @bm cu_atomic_bitmap to be used
+ */
+inline void cu_atomic_bitmap_deinit(struct cu_atomic_bitmap* bm);
+
+/**
+ * Returns the number of usable bits
+ * @bm cu_atomic_bitmap to be used
+ */
+inline size_t cu_atomic_bitmap_size(struct cu_atomic_bitmap* bm);
+
+/**
+ * Atomically sets a bit and returns its previous state
+ * @bm cu_atomic_bitmap to be used
+ * @at bit's index
+ */
+inline unsigned int cu_atomic_bitmap_test_and_set(struct cu_atomic_bitmap* bm,
+                                                  size_t at);
+
+/**
+ * Atomically clears a bit and returns its previous state
+ * @bm cu_atomic_bitmap to be used
+ * @at bit's index
+ */
+inline unsigned int cu_atomic_bitmap_test_and_clear(struct cu_atomic_bitmap* bm,
+                                                    size_t at);
+
+/**
+ * Atomically sets a bit
+ * @bm cu_atomic_bitmap to be used
+ * @at bit's index
+ */
+inline void cu_atomic_bitmap_set_bit(struct cu_atomic_bitmap* bm,
+                                     size_t at);
+
+/**
+ * Atomically clears a bit
+ * @bm cu_atomic_bitmap to be used
+ * @at bit's index
+ */
+inline void cu_atomic_bitmap_clear_bit(struct cu_atomic_bitmap* bm,
+                                       size_t at);
+
+/**
+ * Returns the state of a bit, 0 for a cleared bit and 1 for a set bit
+ * @bm cu_atomic_bitmap to be used
+ * @at bit's index
+ */
+inline unsigned int cu_atomic_bitmap_get_bit(struct cu_atomic_bitmap* bm,
+                                             size_t at);
+
+/**
+ * Finds a cleared bit and sets it, lock free
+ * @bm cu_atomic_bitmap to be used
+ * @hint index where the scan starts, it wraps around at the end
+ *
+ * Returns the index of the claimed bit or cu_atomic_bitmap_size(..) when
+ * all bits are set.
+ *
+ * The hint is the only protection against false sharing: the words are
+ * cache line aligned, but threads passing the same hint contend on the
+ * same line. Give each thread its own stripe, e.g. a different multiple of
+ * cu_ATOMIC_BITMAP_LINE_BITS. Even then, once a stripe fills up its thread
+ * scans on into the following ones, and threads meet on the first lines
+ * still holding cleared bits.
+ */
+inline size_t cu_atomic_bitmap_claim_first_zero(struct cu_atomic_bitmap* bm,
+                                                size_t hint);
+
+/**
+ * Copies the current state of the bits in a cu_bitmap of the same size
+ * @dest destination bitmap
+ * @src source bitmap
+ *
+ * Each word is read atomically, the copy as a whole is not a snapshot.
+ */
+inline void cu_atomic_bitmap_to_bitmap(struct cu_bitmap* dest,
+                                       struct cu_atomic_bitmap* src);
+
+
+
+#define cu_ATOMIC_BITMAP_WORD(bm, at) \
+	(((_Atomic cu_BITMAP_WORD*)(bm)->mblock.mem) + (at)/cu_BITMAP_WORD_BITS)
+#define cu_ATOMIC_BITMAP_MASK(at) \
+	((cu_BITMAP_WORD)0x1 << ((at)%cu_BITMAP_WORD_BITS))
+
+
+void cu_atomic_bitmap_init(struct cu_atomic_bitmap* bm,
+                           size_t size)
+{
+	assert(bm);
+	assert(size);
+	size_t n = (size + cu_BITMAP_WORD_BITS - 1)/cu_BITMAP_WORD_BITS;
+
+	bm->size = size;
+	/* cache line aligned, so stripes of cu_ATOMIC_BITMAP_LINE_BITS bits
+	 * don't straddle two lines */
+	cu_memblock_init_allocator(&bm->mblock, cu_allocator_cacheline(),
+	                           n*sizeof(_Atomic cu_BITMAP_WORD));
+	for (size_t i=0; i< n; i++)
+		atomic_init(((_Atomic cu_BITMAP_WORD*)bm->mblock.mem) + i, 0);
+}
+
+
+void cu_atomic_bitmap_deinit(struct cu_atomic_bitmap* bm)
+{
+	assert(bm);
+	cu_memblock_deinit(&bm->mblock);
+}
+
+
+size_t cu_atomic_bitmap_size(struct cu_atomic_bitmap* bm)
+{
+	assert(bm);
+	return bm->size;
+}
+
+
+unsigned int cu_atomic_bitmap_test_and_set(struct cu_atomic_bitmap* bm,
+                                           size_t at)
+{
+	assert(bm);
+	assert(at< bm->size);
+	return (atomic_fetch_or_explicit(cu_ATOMIC_BITMAP_WORD(bm, at), cu_ATOMIC_BITMAP_MASK(at),
+	                                 memory_order_acq_rel) & cu_ATOMIC_BITMAP_MASK(at)) != 0;
+}
+
+
+unsigned int cu_atomic_bitmap_test_and_clear(struct cu_atomic_bitmap* bm,
+                                             size_t at)
+{
+	assert(bm);
+	assert(at< bm->size);
+	return (atomic_fetch_and_explicit(cu_ATOMIC_BITMAP_WORD(bm, at), ~cu_ATOMIC_BITMAP_MASK(at),
+	                                  memory_order_acq_rel) & cu_ATOMIC_BITMAP_MASK(at)) != 0;
+}
+
+
+void cu_atomic_bitmap_set_bit(struct cu_atomic_bitmap* bm,
+                              size_t at)
+{
+	cu_atomic_bitmap_test_and_set(bm, at);
+}
+
+
+void cu_atomic_bitmap_clear_bit(struct cu_atomic_bitmap* bm,
+                                size_t at)
+{
+	cu_atomic_bitmap_test_and_clear(bm, at);
+}
+
+
+unsigned int cu_atomic_bitmap_get_bit(struct cu_atomic_bitmap* bm,
+                                      size_t at)
+{
+	assert(bm);
+	assert(at< bm->size);
+	return (atomic_load_explicit(cu_ATOMIC_BITMAP_WORD(bm, at), memory_order_acquire)
+	        >> (at%cu_BITMAP_WORD_BITS)) & 0x1;
+}
+
+
+size_t cu_atomic_bitmap_claim_first_zero(struct cu_atomic_bitmap* bm,
+                                         size_t hint)
+{
+	assert(bm);
+	_Atomic cu_BITMAP_WORD* words = (_Atomic cu_BITMAP_WORD*)bm->mblock.mem;
+	size_t n = (bm->size + cu_BITMAP_WORD_BITS - 1)/cu_BITMAP_WORD_BITS;
+	size_t first = (hint % bm->size)/cu_BITMAP_WORD_BITS;
+
+	for (size_t k=0; k< n; k++) {
+		size_t i = first + k < n ? first + k : first + k - n;
+		cu_BITMAP_WORD w = atomic_load_explicit(words + i, memory_order_relaxed);
+
+		for (;;) {
+			cu_BITMAP_WORD zeros = ~w;
+			/* padding bits of the last word can't be claimed */
+			if (i == n-1 && bm->size % cu_BITMAP_WORD_BITS)
+				zeros &= ((cu_BITMAP_WORD)0x1 << (bm->size % cu_BITMAP_WORD_BITS)) - 1;
+			if (!zeros)
+				break;
+
+			/* on failure w is reloaded and the word searched again */
+			cu_BITMAP_WORD bit = zeros & -zeros;
+			if (atomic_compare_exchange_weak_explicit(words + i, &w, w | bit,
+			                                          memory_order_acq_rel,
+			                                          memory_order_relaxed))
+				return i*cu_BITMAP_WORD_BITS + __builtin_ctzl(bit);
+		}
+	}
+	return bm->size;
+}
+
+
+void cu_atomic_bitmap_to_bitmap(struct cu_bitmap* dest,
+                                struct cu_atomic_bitmap* src)
+{
+	assert(dest);
+	assert(src);
+	assert(dest->size == src->size);
+	cu_BITMAP_WORD* d = (cu_BITMAP_WORD*)dest->mblock.mem;
+	_Atomic cu_BITMAP_WORD* s = (_Atomic cu_BITMAP_WORD*)src->mblock.mem;
+
+	for (size_t i=0; i< cu_bitmap_words(dest); i++)
+		d[i] = atomic_load_explicit(s + i, memory_order_acquire);
+}
+
+
+#endif /* cu_atomic_bitmap_h */
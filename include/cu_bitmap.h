@@ -20,28 +20,51 @@
  *    3. This notice may not be removed or altered from any source
  *    distribution.
  */
-
 #ifndef cu_bitmap_h
 #define cu_bitmap_h 1
 
 #include <stdio.h>
+#include <string.h>
 
 #include "cu_debug.h"
 #include "cu_memblock.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+/* storage word of a cu_bitmap, bit `at' lives in word at/cu_BITMAP_WORD_BITS */
+#define cu_BITMAP_WORD unsigned long
+#define cu_BITMAP_WORD_BITS (unsigned int)(sizeof(cu_BITMAP_WORD)*8)
+
 
 struct cu_bitmap {
 	/* private */
 	struct cu_memblock mblock;
+	size_t size;	/* in bits */
 };
 
 
 /**
  * Inits a cu_bitmap
  * @ac cu_bitmap to be used
+ * @size number of bits
  */
 inline void cu_bitmap_init(struct cu_bitmap* bm,
-                           unsigned int size);
+                           size_t size);
+
+/**
+ * Inits a cu_bitmap whose memory comes from an allocator
+ * @ac cu_bitmap to be used
+ * @a allocator to be used, NULL for cu_allocator_heap()
+ * @size number of bits
+ */
+inline void cu_bitmap_init_allocator(struct cu_bitmap* bm,
+                                     const struct cu_allocator* a,
+                                     size_t size);
 
 /**
  * Deinits a cu_bitmap
@@ -59,7 +82,13 @@ inline void cu_bitmap_clear(struct cu_bitmap* bm);
  * Returns the number of usable bits in a cu_bitmap
  * @ac cu_bitmap to be used
  */
-inline unsigned int cu_bitmap_size(struct cu_bitmap* bm);
+inline size_t cu_bitmap_size(struct cu_bitmap* bm);
+
+/**
+ * Returns the number of storage words in a cu_bitmap
+ * @ac cu_bitmap to be used
+ */
+inline size_t cu_bitmap_words(struct cu_bitmap* bm);
 
 /**
  * Sets a bit
@@ -69,7 +98,7 @@ inline unsigned int cu_bitmap_size(struct cu_bitmap* bm);
  * Bits are indexed from 0 to (cu_bitmap_size(..)-1).
  */
 inline void cu_bitmap_set_bit(struct cu_bitmap* bm,
-                              unsigned int at);
+                              size_t at);
 
 /**
  * Clears the bit
@@ -79,7 +108,7 @@ inline void cu_bitmap_set_bit(struct cu_bitmap* bm,
  * Bits are indexed from 0 to (cu_bitmap_size(..)-1).
  */
 inline void cu_bitmap_clear_bit(struct cu_bitmap* bm,
-                                unsigned int at);
+                                size_t at);
 
 /**
  * Returns the state of a bit
@@ -90,7 +119,7 @@ inline void cu_bitmap_clear_bit(struct cu_bitmap* bm,
  * and 1 for a set bit
  */
 inline unsigned int cu_bitmap_get_bit(struct cu_bitmap* bm,
-                                      unsigned int at);
+                                      size_t at);
 
 /**
  * Clones two bitmaps
@@ -100,13 +129,174 @@ inline unsigned int cu_bitmap_get_bit(struct cu_bitmap* bm,
 inline void cu_bitmap_clone(struct cu_bitmap* dest,
                             struct cu_bitmap* src);
 
+/**
+ * Bitwise and of two bitmaps, dest = a & b
+ * @dest destination bitmap
+ * @a first operand
+ * @b second operand
+ *
+ * All bitmaps must have the same size. dest may be one of the operands,
+ * cu_bitmap_and(a, a, b) works in place.
+ */
+inline void cu_bitmap_and(struct cu_bitmap* dest,
+                          struct cu_bitmap* a,
+                          struct cu_bitmap* b);
+
+/**
+ * Bitwise or of two bitmaps, dest = a | b
+ * @dest destination bitmap
+ * @a first operand
+ * @b second operand
+ *
+ * Same size and aliasing rules as cu_bitmap_and.
+ */
+inline void cu_bitmap_or(struct cu_bitmap* dest,
+                         struct cu_bitmap* a,
+                         struct cu_bitmap* b);
+
+/**
+ * Bitwise xor of two bitmaps, dest = a ^ b
+ * @dest destination bitmap
+ * @a first operand
+ * @b second operand
+ *
+ * Same size and aliasing rules as cu_bitmap_and.
+ */
+inline void cu_bitmap_xor(struct cu_bitmap* dest,
+                          struct cu_bitmap* a,
+                          struct cu_bitmap* b);
+
+/**
+ * Clears in a the bits set in b, dest = a & ~b
+ * @dest destination bitmap
+ * @a first operand
+ * @b second operand
+ *
+ * Same size and aliasing rules as cu_bitmap_and.
+ */
+inline void cu_bitmap_andnot(struct cu_bitmap* dest,
+                             struct cu_bitmap* a,
+                             struct cu_bitmap* b);
+
+/**
+ * Bitwise complement of a bitmap, dest = ~src
+ * @dest destination bitmap
+ * @src source bitmap
+ *
+ * Bits past cu_bitmap_size(..) in the last word are kept cleared.
+ */
+inline void cu_bitmap_not(struct cu_bitmap* dest,
+                          struct cu_bitmap* src);
+
+/**
+ * Returns the number of set bits
+ * @ac cu_bitmap to be used
+ */
+inline size_t cu_bitmap_popcount(struct cu_bitmap* bm);
+
+
+/**
+ * Returns the index of the first set bit at or after a given position
+ * @ac cu_bitmap to be used
+ * @from index to start the search from
+ *
+ * Returns cu_bitmap_size(..) when no such bit exists.
+ */
+inline size_t cu_bitmap_find_next_set(struct cu_bitmap* bm,
+                                      size_t from);
+
+/**
+ * Returns the index of the first cleared bit at or after a given position
+ * @ac cu_bitmap to be used
+ * @from index to start the search from
+ *
+ * Returns cu_bitmap_size(..) when no such bit exists.
+ */
+inline size_t cu_bitmap_find_next_zero(struct cu_bitmap* bm,
+                                       size_t from);
+
+/**
+ * Returns the index of the first set bit, cu_bitmap_size(..) if none
+ * @ac cu_bitmap to be used
+ */
+inline size_t cu_bitmap_find_first_set(struct cu_bitmap* bm);
+
+/**
+ * Returns the index of the first cleared bit, cu_bitmap_size(..) if none
+ * @ac cu_bitmap to be used
+ */
+inline size_t cu_bitmap_find_first_zero(struct cu_bitmap* bm);
+
+/**
+ * Calls a function for each set bit, in increasing order
+ * @ac cu_bitmap to be used
+ * @fn callback, receives the bit's index and the user data
+ * @data user data passed to fn
+ *
+ * The callback must not modify the bitmap.
+ */
+inline void cu_bitmap_foreach_set(struct cu_bitmap* bm,
+                                  void (*fn)(size_t at, void* data),
+                                  void* data);
+
+/**
+ * Sets a range of bits
+ * @ac cu_bitmap to be used
+ * @from index of the first bit
+ * @len number of bits to set
+ */
+inline void cu_bitmap_set_range(struct cu_bitmap* bm,
+                                size_t from,
+                                size_t len);
+
+/**
+ * Clears a range of bits
+ * @ac cu_bitmap to be used
+ * @from index of the first bit
+ * @len number of bits to clear
+ */
+inline void cu_bitmap_clear_range(struct cu_bitmap* bm,
+                                  size_t from,
+                                  size_t len);
+
+/**
+ * Returns 1 when all the bits in a range are set, 0 otherwise
+ * @ac cu_bitmap to be used
+ * @from index of the first bit
+ * @len number of bits to test
+ *
+ * An empty range counts as all set.
+ */
+inline unsigned int cu_bitmap_test_range_all(struct cu_bitmap* bm,
+                                             size_t from,
+                                             size_t len);
+
+/**
+ * Returns 1 when at least one bit in a range is set, 0 otherwise
+ * @ac cu_bitmap to be used
+ * @from index of the first bit
+ * @len number of bits to test
+ */
+inline unsigned int cu_bitmap_test_range_any(struct cu_bitmap* bm,
+                                             size_t from,
+                                             size_t len);
 
 
 void cu_bitmap_init(struct cu_bitmap* bm,
-                    unsigned int size) {
+                    size_t size) {
+	cu_bitmap_init_allocator(bm, NULL, size);
+}
+
+
+void cu_bitmap_init_allocator(struct cu_bitmap* bm,
+                              const struct cu_allocator* a,
+                              size_t size)
+{
 	assert(bm);
 	assert(size);
-	cu_memblock_init(&bm->mblock, size);
+	bm->size = size;
+	cu_memblock_init_allocator(&bm->mblock, a,
+	                           ((size + cu_BITMAP_WORD_BITS - 1)/cu_BITMAP_WORD_BITS)*sizeof(cu_BITMAP_WORD));
 }
 
 
@@ -124,36 +314,43 @@ void cu_bitmap_clear(struct cu_bitmap* bm)
 }
 
 
-unsigned int cu_bitmap_size(struct cu_bitmap* bm)
+size_t cu_bitmap_size(struct cu_bitmap* bm)
+{
+	assert(bm);
+	return bm->size;
+}
+
+
+size_t cu_bitmap_words(struct cu_bitmap* bm)
 {
 	assert(bm);
-	return bm->mblock.size;
+	return bm->mblock.size/sizeof(cu_BITMAP_WORD);
 }
 
 
 void cu_bitmap_set_bit(struct cu_bitmap* bm,
-                       unsigned int at)
+                       size_t at)
 {
 	assert(bm);
-	assert(at< bm->mblock.size);
-	((unsigned int*)bm->mblock.mem)[at/(sizeof(unsigned int)*8)] |= (0x1 << (at%(sizeof(unsigned int)*8)));
+	assert(at< bm->size);
+	((cu_BITMAP_WORD*)bm->mblock.mem)[at/cu_BITMAP_WORD_BITS] |= ((cu_BITMAP_WORD)0x1 << (at%cu_BITMAP_WORD_BITS));
 }
 
 
 void cu_bitmap_clear_bit(struct cu_bitmap* bm,
-                         unsigned int at)
+                         size_t at)
 {
 	assert(bm);
-	assert(at< bm->mblock.size);
-	((unsigned int*)bm->mblock.mem)[at/(sizeof(unsigned int)*8)] &= (!(0x1 << (at%(sizeof(unsigned int)*8))));
+	assert(at< bm->size);
+	((cu_BITMAP_WORD*)bm->mblock.mem)[at/cu_BITMAP_WORD_BITS] &= ~((cu_BITMAP_WORD)0x1 << (at%cu_BITMAP_WORD_BITS));
 }
 
 
-unsigned int cu_bitmap_get_bit(struct cu_bitmap* bm, unsigned int at)
+unsigned int cu_bitmap_get_bit(struct cu_bitmap* bm, size_t at)
 {
 	assert(bm);
-	assert(at< bm->mblock.size);
-	return ((unsigned int*)bm->mblock.mem)[at/(sizeof(unsigned int)*8)] & (0x1 << (at%(sizeof(unsigned int)*8)));
+	assert(at< bm->size);
+	return (((cu_BITMAP_WORD*)bm->mblock.mem)[at/cu_BITMAP_WORD_BITS] >> (at%cu_BITMAP_WORD_BITS)) & 0x1;
 }
 
 
@@ -163,8 +360,316 @@ void cu_bitmap_clone(struct cu_bitmap* dest,
 	assert(dest);
 	assert(src);  
 	cu_memblock_clone(&dest->mblock, &src->mblock);
+	dest->size = src->size;
 }
 
 
-#endif /* cu_bitmap_h */
+/*
+ * simd flavour used by the binary operators, picked at compile time.
+ * Loads are unaligned as memblocks are only malloc aligned.
+ */
+#if defined(__AVX2__)
+#define cu_BITMAP_VEC           __m256i
+#define cu_BITMAP_VLOAD(p)      _mm256_loadu_si256((const __m256i*)(p))
+#define cu_BITMAP_VSTORE(p, x)  _mm256_storeu_si256((__m256i*)(p), x)
+#define cu_BITMAP_VAND(x, y)    _mm256_and_si256(x, y)
+#define cu_BITMAP_VOR(x, y)     _mm256_or_si256(x, y)
+#define cu_BITMAP_VXOR(x, y)    _mm256_xor_si256(x, y)
+#define cu_BITMAP_VANDNOT(x, y) _mm256_andnot_si256(y, x)
+#elif defined(__SSE2__)
+#define cu_BITMAP_VEC           __m128i
+#define cu_BITMAP_VLOAD(p)      _mm_loadu_si128((const __m128i*)(p))
+#define cu_BITMAP_VSTORE(p, x)  _mm_storeu_si128((__m128i*)(p), x)
+#define cu_BITMAP_VAND(x, y)    _mm_and_si128(x, y)
+#define cu_BITMAP_VOR(x, y)     _mm_or_si128(x, y)
+#define cu_BITMAP_VXOR(x, y)    _mm_xor_si128(x, y)
+#define cu_BITMAP_VANDNOT(x, y) _mm_andnot_si128(y, x)
+#endif
+
+#define cu_BITMAP_AND(x, y)    ((x) & (y))
+#define cu_BITMAP_OR(x, y)     ((x) | (y))
+#define cu_BITMAP_XOR(x, y)    ((x) ^ (y))
+#define cu_BITMAP_ANDNOT(x, y) ((x) & ~(y))
+
+/* word loop shared by the binary operators: simd body, scalar tail */
+#ifdef cu_BITMAP_VEC
+#define cu_BITMAP_VLOOP(d, a, b, i, n, vop)                                  \
+	for (; i + sizeof(cu_BITMAP_VEC)/sizeof(cu_BITMAP_WORD) <= n;        \
+	     i += sizeof(cu_BITMAP_VEC)/sizeof(cu_BITMAP_WORD))              \
+		cu_BITMAP_VSTORE(d + i, vop(cu_BITMAP_VLOAD(a + i),          \
+		                            cu_BITMAP_VLOAD(b + i)))
+#else
+#define cu_BITMAP_VLOOP(d, a, b, i, n, vop)
+#endif
+
+#define cu_BITMAP_BINOP(dest, a, b, vop, sop)                                 \
+	do {                                                                  \
+		cu_BITMAP_WORD* d_ = (cu_BITMAP_WORD*)(dest)->mblock.mem;     \
+		const cu_BITMAP_WORD* a_ = (const cu_BITMAP_WORD*)(a)->mblock.mem; \
+		const cu_BITMAP_WORD* b_ = (const cu_BITMAP_WORD*)(b)->mblock.mem; \
+		size_t n_ = cu_bitmap_words(dest);                            \
+		size_t i_ = 0;                                                \
+		cu_BITMAP_VLOOP(d_, a_, b_, i_, n_, vop);                     \
+		for (; i_ < n_; i_++)                                         \
+			d_[i_] = sop(a_[i_], b_[i_]);                         \
+	} while (0)
+
+
+void cu_bitmap_and(struct cu_bitmap* dest,
+                   struct cu_bitmap* a,
+                   struct cu_bitmap* b)
+{
+	assert(dest);
+	assert(a);
+	assert(b);
+	assert(dest->size == a->size && a->size == b->size);
+	cu_BITMAP_BINOP(dest, a, b, cu_BITMAP_VAND, cu_BITMAP_AND);
+}
+
+
+void cu_bitmap_or(struct cu_bitmap* dest,
+                  struct cu_bitmap* a,
+                  struct cu_bitmap* b)
+{
+	assert(dest);
+	assert(a);
+	assert(b);
+	assert(dest->size == a->size && a->size == b->size);
+	cu_BITMAP_BINOP(dest, a, b, cu_BITMAP_VOR, cu_BITMAP_OR);
+}
+
+
+void cu_bitmap_xor(struct cu_bitmap* dest,
+                   struct cu_bitmap* a,
+                   struct cu_bitmap* b)
+{
+	assert(dest);
+	assert(a);
+	assert(b);
+	assert(dest->size == a->size && a->size == b->size);
+	cu_BITMAP_BINOP(dest, a, b, cu_BITMAP_VXOR, cu_BITMAP_XOR);
+}
+
+
+void cu_bitmap_andnot(struct cu_bitmap* dest,
+                      struct cu_bitmap* a,
+                      struct cu_bitmap* b)
+{
+	assert(dest);
+	assert(a);
+	assert(b);
+	assert(dest->size == a->size && a->size == b->size);
+	cu_BITMAP_BINOP(dest, a, b, cu_BITMAP_VANDNOT, cu_BITMAP_ANDNOT);
+}
+
+
+void cu_bitmap_not(struct cu_bitmap* dest,
+                   struct cu_bitmap* src)
+{
+	assert(dest);
+	assert(src);
+	assert(dest->size == src->size);
+
+	cu_BITMAP_WORD* d = (cu_BITMAP_WORD*)dest->mblock.mem;
+	const cu_BITMAP_WORD* s = (const cu_BITMAP_WORD*)src->mblock.mem;
+	size_t n = cu_bitmap_words(dest);
+	for (size_t i=0; i< n; i++)
+		d[i] = ~s[i];
+
+	/* keep the padding bits of the last word cleared */
+	if (dest->size % cu_BITMAP_WORD_BITS)
+		d[n-1] &= ((cu_BITMAP_WORD)0x1 << (dest->size % cu_BITMAP_WORD_BITS)) - 1;
+}
+
+
+size_t cu_bitmap_popcount(struct cu_bitmap* bm)
+{
+	assert(bm);
+	const cu_BITMAP_WORD* w = (const cu_BITMAP_WORD*)bm->mblock.mem;
+	size_t n = cu_bitmap_words(bm);
+	size_t count = 0;
+
+	for (size_t i=0; i+1< n; i++)
+		count += __builtin_popcountl(w[i]);
+
+	/* ignore whatever lives in the padding bits of the last word */
+	cu_BITMAP_WORD last = w[n-1];
+	if (bm->size % cu_BITMAP_WORD_BITS)
+		last &= ((cu_BITMAP_WORD)0x1 << (bm->size % cu_BITMAP_WORD_BITS)) - 1;
+	return count + __builtin_popcountl(last);
+}
+
+
+/* 
+ * shared by the find_next_* functions: inv is 0 to search for set bits
+ * and all ones to search for cleared bits
+ */
+#define cu_BITMAP_FIND_NEXT(bm, from, inv)                                    \
+	do {                                                                  \
+		const cu_BITMAP_WORD* w_ = (const cu_BITMAP_WORD*)(bm)->mblock.mem; \
+		size_t n_ = cu_bitmap_words(bm);                              \
+		size_t i_ = (from)/cu_BITMAP_WORD_BITS;                       \
+		cu_BITMAP_WORD word_;                                         \
+		if ((from) >= (bm)->size)                                     \
+			return (bm)->size;                                    \
+		/* mask off the bits before from in the first word */         \
+		word_ = (w_[i_] ^ (inv)) & (~(cu_BITMAP_WORD)0 << ((from)%cu_BITMAP_WORD_BITS)); \
+		while (!word_) {                                              \
+			if (++i_ == n_)                                       \
+				return (bm)->size;                            \
+			word_ = w_[i_] ^ (inv);                               \
+		}                                                             \
+		i_ = i_*cu_BITMAP_WORD_BITS + __builtin_ctzl(word_);          \
+		/* padding bits of the last word may match, clamp them */     \
+		return i_ < (bm)->size ? i_ : (bm)->size;                     \
+	} while (0)
+
+
+size_t cu_bitmap_find_next_set(struct cu_bitmap* bm,
+                               size_t from)
+{
+	assert(bm);
+	cu_BITMAP_FIND_NEXT(bm, from, (cu_BITMAP_WORD)0);
+}
 
+
+size_t cu_bitmap_find_next_zero(struct cu_bitmap* bm,
+                                size_t from)
+{
+	assert(bm);
+	cu_BITMAP_FIND_NEXT(bm, from, ~(cu_BITMAP_WORD)0);
+}
+
+
+size_t cu_bitmap_find_first_set(struct cu_bitmap* bm)
+{
+	return cu_bitmap_find_next_set(bm, 0);
+}
+
+
+size_t cu_bitmap_find_first_zero(struct cu_bitmap* bm)
+{
+	return cu_bitmap_find_next_zero(bm, 0);
+}
+
+
+void cu_bitmap_foreach_set(struct cu_bitmap* bm,
+                           void (*fn)(size_t at, void* data),
+                           void* data)
+{
+	assert(bm);
+	assert(fn);
+	const cu_BITMAP_WORD* w = (const cu_BITMAP_WORD*)bm->mblock.mem;
+	size_t n = cu_bitmap_words(bm);
+
+	for (size_t i=0; i< n; i++) {
+		cu_BITMAP_WORD word = w[i];
+		if (i == n-1 && bm->size % cu_BITMAP_WORD_BITS)
+			word &= ((cu_BITMAP_WORD)0x1 << (bm->size % cu_BITMAP_WORD_BITS)) - 1;
+
+		/* visit the set bits only, dropping the lowest one each round */
+		while (word) {
+			fn(i*cu_BITMAP_WORD_BITS + __builtin_ctzl(word), data);
+			word &= word - 1;
+		}
+	}
+}
+
+
+/*
+ * a range [from, from+len) spans the words first..last, head and tail
+ * mask the bits of the range living in the first and last word
+ */
+#define cu_BITMAP_RANGE(bm, from, len, first, last, head, tail)         \
+	size_t first = (from)/cu_BITMAP_WORD_BITS;                      \
+	size_t last = ((from) + (len) - 1)/cu_BITMAP_WORD_BITS;         \
+	cu_BITMAP_WORD head = ~(cu_BITMAP_WORD)0 << ((from)%cu_BITMAP_WORD_BITS); \
+	cu_BITMAP_WORD tail = ~(cu_BITMAP_WORD)0 >>                     \
+		(cu_BITMAP_WORD_BITS - 1 - ((from) + (len) - 1)%cu_BITMAP_WORD_BITS); \
+	if (first == last)                                              \
+		head = tail = head & tail
+
+
+void cu_bitmap_set_range(struct cu_bitmap* bm,
+                         size_t from,
+                         size_t len)
+{
+	assert(bm);
+	assert(from <= bm->size && len <= bm->size - from);
+	if (!len)
+		return;
+
+	cu_BITMAP_WORD* w = (cu_BITMAP_WORD*)bm->mblock.mem;
+	cu_BITMAP_RANGE(bm, from, len, first, last, head, tail);
+
+	w[first] |= head;
+	if (last > first + 1)
+		cu_memblock_set_range(&bm->mblock, (first + 1)*sizeof(cu_BITMAP_WORD),
+		                      (last - first - 1)*sizeof(cu_BITMAP_WORD), 0xFF);
+	w[last] |= tail;
+}
+
+
+void cu_bitmap_clear_range(struct cu_bitmap* bm,
+                           size_t from,
+                           size_t len)
+{
+	assert(bm);
+	assert(from <= bm->size && len <= bm->size - from);
+	if (!len)
+		return;
+
+	cu_BITMAP_WORD* w = (cu_BITMAP_WORD*)bm->mblock.mem;
+	cu_BITMAP_RANGE(bm, from, len, first, last, head, tail);
+
+	w[first] &= ~head;
+	if (last > first + 1)
+		cu_memblock_set_range(&bm->mblock, (first + 1)*sizeof(cu_BITMAP_WORD),
+		                      (last - first - 1)*sizeof(cu_BITMAP_WORD), 0);
+	w[last] &= ~tail;
+}
+
+
+unsigned int cu_bitmap_test_range_all(struct cu_bitmap* bm,
+                                      size_t from,
+                                      size_t len)
+{
+	assert(bm);
+	assert(from <= bm->size && len <= bm->size - from);
+	if (!len)
+		return 1;
+
+	const cu_BITMAP_WORD* w = (const cu_BITMAP_WORD*)bm->mblock.mem;
+	cu_BITMAP_RANGE(bm, from, len, first, last, head, tail);
+
+	if ((w[first] & head) != head || (w[last] & tail) != tail)
+		return 0;
+	for (size_t i=first+1; i< last; i++)
+		if (w[i] != ~(cu_BITMAP_WORD)0)
+			return 0;
+	return 1;
+}
+
+
+unsigned int cu_bitmap_test_range_any(struct cu_bitmap* bm,
+                                      size_t from,
+                                      size_t len)
+{
+	assert(bm);
+	assert(from <= bm->size && len <= bm->size - from);
+	if (!len)
+		return 0;
+
+	const cu_BITMAP_WORD* w = (const cu_BITMAP_WORD*)bm->mblock.mem;
+	cu_BITMAP_RANGE(bm, from, len, first, last, head, tail);
+
+	if ((w[first] & head) || (w[last] & tail))
+		return 1;
+	for (size_t i=first+1; i< last; i++)
+		if (w[i])
+			return 1;
+	return 0;
+}
+
+
+#endif /* cu_bitmap_h */
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_bitmap_rank_h
+#define cu_bitmap_rank_h 1
+
+#include <stdio.h>
+
+#include "cu_debug.h"
+#include "cu_memblock.h"
+#include "cu_bitmap.h"
+
+
+/* 
+ * the index keeps an absolute count of set bits every superblock and a
+ * count relative to the enclosing superblock every block, 16 bits per
+ * 512 bits of bitmap or about 3% of overhead
+ */
+#define cu_BITMAP_RANK_BLOCK_BITS (unsigned int)512
+#define cu_BITMAP_RANK_SUPER_BITS (unsigned int)65536
+#define cu_BITMAP_RANK_BLOCK_WORDS (cu_BITMAP_RANK_BLOCK_BITS/cu_BITMAP_WORD_BITS)
+#define cu_BITMAP_RANK_SUPER_BLOCKS (cu_BITMAP_RANK_SUPER_BITS/cu_BITMAP_RANK_BLOCK_BITS)
+
+
+struct cu_bitmap_rank {
+	/* private */
+	struct cu_bitmap* bm;
+	struct cu_memblock supers; /* size_t, set bits before each superblock */
+	struct cu_memblock blocks; /* unsigned short, set bits before each block
+	                              since the start of its superblock */
+	size_t count;              /* total number of set bits */
+};
+
+
+/**
+ * Inits a rank/select index and builds it over a bitmap
+ * @rs cu_bitmap_rank to be used
+ * @bm indexed bitmap
+ *
+ * The index keeps a reference to bm, which must outlive it. Changing the
+ * bitmap invalidates the index until cu_bitmap_rank_build is called again.
+ */
+inline void cu_bitmap_rank_init(struct cu_bitmap_rank* rs,
+                                struct cu_bitmap* bm);
+
+/**
+ * Deinits a rank/select index
+ * @rs cu_bitmap_rank to be used
+ */
+inline void cu_bitmap_rank_deinit(struct cu_bitmap_rank* rs);
+
+/**
+ * Rebuilds the index after the bitmap has been modified
+ * @rs cu_bitmap_rank to be used
+ */
+inline void cu_bitmap_rank_build(struct cu_bitmap_rank* rs);
+
+/**
+ * Returns the number of set bits in the indexed bitmap
+ * @rs cu_bitmap_rank to be used
+ */
+inline size_t cu_bitmap_rank_count(struct cu_bitmap_rank* rs);
+
+/**
+ * Returns the number of set bits before a given position
+ * @rs cu_bitmap_rank to be used
+ * @at bit's index, from 0 to cu_bitmap_size(..)
+ */
+inline size_t cu_bitmap_rank(struct cu_bitmap_rank* rs,
+                             size_t at);
+
+/**
+ * Returns the position of the k-th set bit
+ * @rs cu_bitmap_rank to be used
+ * @k number of set bits preceding the wanted one (k is 0 based)
+ *
+ * Returns cu_bitmap_size(..) when the bitmap has k or less set bits.
+ */
+inline size_t cu_bitmap_select(struct cu_bitmap_rank* rs,
+                               size_t k);
+
+
+
+void cu_bitmap_rank_init(struct cu_bitmap_rank* rs,
+                         struct cu_bitmap* bm)
+{
+	assert(rs);
+	assert(bm);
+	rs->bm = bm;
+	cu_memblock_init(&rs->supers,
+	                 (bm->size/cu_BITMAP_RANK_SUPER_BITS + 1)*sizeof(size_t));
+	cu_memblock_init(&rs->blocks,
+	                 (bm->size/cu_BITMAP_RANK_BLOCK_BITS + 1)*sizeof(unsigned short));
+	cu_bitmap_rank_build(rs);
+}
+
+
+void cu_bitmap_rank_deinit(struct cu_bitmap_rank* rs)
+{
+	assert(rs);
+	cu_memblock_deinit(&rs->supers);
+	cu_memblock_deinit(&rs->blocks);
+}
+
+
+void cu_bitmap_rank_build(struct cu_bitmap_rank* rs)
+{
+	assert(rs);
+	const cu_BITMAP_WORD* w = (const cu_BITMAP_WORD*)rs->bm->mblock.mem;
+	size_t* supers = (size_t*)rs->supers.mem;
+	unsigned short* blocks = (unsigned short*)rs->blocks.mem;
+	size_t n = cu_bitmap_words(rs->bm);
+	size_t count = 0, super_count = 0;
+
+	for (size_t i=0; i< n; i++) {
+		cu_BITMAP_WORD word = w[i];
+
+		if (i % cu_BITMAP_RANK_BLOCK_WORDS == 0) {
+			size_t b = i/cu_BITMAP_RANK_BLOCK_WORDS;
+			if (b % cu_BITMAP_RANK_SUPER_BLOCKS == 0)
+				supers[b/cu_BITMAP_RANK_SUPER_BLOCKS] = super_count = count;
+			blocks[b] = (unsigned short)(count - super_count);
+		}
+
+		/* padding bits of the last word are not part of the bitmap */
+		if (i == n-1 && rs->bm->size % cu_BITMAP_WORD_BITS)
+			word &= ((cu_BITMAP_WORD)0x1 << (rs->bm->size % cu_BITMAP_WORD_BITS)) - 1;
+		count += __builtin_popcountl(word);
+	}
+	rs->count = count;
+}
+
+
+size_t cu_bitmap_rank_count(struct cu_bitmap_rank* rs)
+{
+	assert(rs);
+	return rs->count;
+}
+
+
+size_t cu_bitmap_rank(struct cu_bitmap_rank* rs,
+                      size_t at)
+{
+	assert(rs);
+	assert(at <= rs->bm->size);
+	if (at == rs->bm->size)
+		return rs->count;
+
+	const cu_BITMAP_WORD* w = (const cu_BITMAP_WORD*)rs->bm->mblock.mem;
+	size_t b = at/cu_BITMAP_RANK_BLOCK_BITS;
+	size_t rank = ((size_t*)rs->supers.mem)[at/cu_BITMAP_RANK_SUPER_BITS]
+	              + ((unsigned short*)rs->blocks.mem)[b];
+
+	/* at most cu_BITMAP_RANK_BLOCK_WORDS popcounts */
+	for (size_t i=b*cu_BITMAP_RANK_BLOCK_WORDS; i< at/cu_BITMAP_WORD_BITS; i++)
+		rank += __builtin_popcountl(w[i]);
+	if (at % cu_BITMAP_WORD_BITS)
+		rank += __builtin_popcountl(w[at/cu_BITMAP_WORD_BITS]
+		                            & (((cu_BITMAP_WORD)0x1 << (at % cu_BITMAP_WORD_BITS)) - 1));
+	return rank;
+}
+
+
+size_t cu_bitmap_select(struct cu_bitmap_rank* rs,
+                        size_t k)
+{
+	assert(rs);
+	if (k >= rs->count)
+		return rs->bm->size;
+
+	const cu_BITMAP_WORD* w = (const cu_BITMAP_WORD*)rs->bm->mblock.mem;
+	const size_t* supers = (const size_t*)rs->supers.mem;
+	const unsigned short* blocks = (const unsigned short*)rs->blocks.mem;
+	size_t num_blocks = (cu_bitmap_words(rs->bm) + cu_BITMAP_RANK_BLOCK_WORDS - 1)
+	                    /cu_BITMAP_RANK_BLOCK_WORDS;
+	size_t lo, hi;
+
+	/* last superblock starting with k or less set bits before it */
+	lo = 0;
+	hi = (num_blocks - 1)/cu_BITMAP_RANK_SUPER_BLOCKS;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo + 1)/2;
+		if (supers[mid] <= k)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	k -= supers[lo];
+
+	/* same search among the blocks of that superblock */
+	hi = lo*cu_BITMAP_RANK_SUPER_BLOCKS + cu_BITMAP_RANK_SUPER_BLOCKS - 1;
+	if (hi > num_blocks - 1)
+		hi = num_blocks - 1;
+	lo = lo*cu_BITMAP_RANK_SUPER_BLOCKS;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo + 1)/2;
+		if (blocks[mid] <= k)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	k -= blocks[lo];
+
+	/* scan the words of the block, then the bits of the word */
+	size_t i = lo*cu_BITMAP_RANK_BLOCK_WORDS;
+	for (;;) {
+		size_t c = __builtin_popcountl(w[i]);
+		if (k < c)
+			break;
+		k -= c;
+		i++;
+	}
+
+	cu_BITMAP_WORD word = w[i];
+	while (k--)
+		word &= word - 1;
+	return i*cu_BITMAP_WORD_BITS + __builtin_ctzl(word);
+}
+
+
+#endif /* cu_bitmap_rank_h */
@@ -29,5 +29,12 @@
 //#define NDEBUG
 
 
+/* cu_array_container blocks growing past this size (in bytes) move to
+ * mmap-ed memory and from there on grow by remapping pages instead of
+ * copying them. Needs mremap (Linux, with _GNU_SOURCE defined before
+ * including any header), comment out to always use the heap */
+#define cu_ARRAY_CONTAINER_MMAP_THRESHOLD (unsigned int)(1024*1024)
+
+
 #endif /* cu_config_h */
 
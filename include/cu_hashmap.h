@@ -0,0 +1,535 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_hashmap_h
+#define cu_hashmap_h 1
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "cu_debug.h"
+#include "cu_memblock.h"
+#include "cu_array_container.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+/*
+ * Open addressing hash maps with one control byte per slot, laid out as
+ * in SwissTable: a control byte is cu_HASHMAP_EMPTY, cu_HASHMAP_DELETED or
+ * the low 7 bits of the hash of the key in the slot. A lookup loads
+ * cu_HASHMAP_GROUP control bytes at once, compares them all with the
+ * hash bits of the key (one SSE2 compare) and only reads the slots whose
+ * byte matches, so most lookups touch a single cache line of control
+ * bytes and a single slot.
+ *
+ * Keys and values are stored together in one contiguous array of slots;
+ * the capacity is a power of two and at most 7/8 of the slots are used.
+ * The control bytes are followed by a copy of the first group, so groups
+ * starting near the end of the table are read without wrapping.
+ *
+ * cu_HASHMAP_DECLARE(name, ktype, vtype) declares struct
+ * cu_hashmap_<name>, mapping keys of type ktype to values of type vtype,
+ * and the following functions:
+ *
+ * void cu_hashmap_<name>_init(m)
+ *	inits an empty map
+ * void cu_hashmap_<name>_init_allocator(m, a)
+ *	inits an empty map, memory comes from a (NULL for cu_allocator_heap())
+ * void cu_hashmap_<name>_deinit(m)
+ *	deinits the map
+ * void cu_hashmap_<name>_clear(m)
+ *	removes all the keys, reserved memory is kept
+ * size_t cu_hashmap_<name>_size(m)
+ *	returns the number of keys
+ * void cu_hashmap_<name>_reserve(m, n)
+ *	makes room for n keys without rehashing
+ * int cu_hashmap_<name>_put(m, key, value)
+ *	maps key to value, returns 1 if the key is new, 0 if it was replaced
+ * vtype* cu_hashmap_<name>_find(m, key)
+ *	returns the value of key, NULL if missing; valid until the next put
+ * int cu_hashmap_<name>_get(m, key, value)
+ *	copies the value of key to *value, returns 0 if missing
+ * int cu_hashmap_<name>_erase(m, key)
+ *	removes key, returns 0 if missing
+ * void cu_hashmap_<name>_foreach(m, fn, data)
+ *	calls fn(key, value ptr, data) on every key, in no particular order
+ *
+ * cu_HASHMAP_DEFINE(name, ktype, vtype, hash) defines them; use it in a
+ * single translation unit. hash is a function or macro taking a key and
+ * returning a size_t, keys are compared with ==.
+ */
+#define cu_HASHMAP_GROUP 16
+#define cu_HASHMAP_MIN_CAPACITY (size_t)16
+
+/* control bytes, full slots hold 0 to 127 */
+#define cu_HASHMAP_EMPTY   (signed char)-128
+#define cu_HASHMAP_DELETED (signed char)-2
+
+/* protected api */
+
+/* hash bits giving the first group and the control byte */
+#define cu_HASHMAP_H1(hash) ((hash) >> 7)
+#define cu_HASHMAP_H2(hash) (signed char)((hash) & 0x7f)
+
+
+/**
+ * Returns a hash of an unsigned int key
+ */
+inline size_t cu_hashmap_hash_uint(unsigned int key);
+
+/**
+ * Returns a hash of a pointer key
+ */
+inline size_t cu_hashmap_hash_ptr(const void* key);
+
+/**
+ * Returns a mask of the control bytes equal to h2 in a group
+ * @group cu_HASHMAP_GROUP control bytes, bit i of the mask is group[i]
+ */
+inline unsigned int cu_hashmap_match(const signed char* group,
+                                     signed char h2);
+
+/**
+ * Returns a mask of the empty control bytes in a group
+ */
+inline unsigned int cu_hashmap_match_empty(const signed char* group);
+
+/**
+ * Returns a mask of the empty or deleted control bytes in a group
+ */
+inline unsigned int cu_hashmap_match_free(const signed char* group);
+
+/**
+ * Sets a control byte and its copy past the end of the table
+ * @ctrl control bytes
+ * @capacity number of slots, a power of two
+ * @i slot index
+ * @c new control byte
+ */
+inline void cu_hashmap_set_ctrl(signed char* ctrl,
+                                size_t capacity,
+                                size_t i,
+                                signed char c);
+
+/**
+ * Returns the first empty or deleted slot on the probe sequence of a hash
+ * @ctrl control bytes
+ * @capacity number of slots, a power of two
+ * @hash hash of the key
+ */
+inline size_t cu_hashmap_find_free(const signed char* ctrl,
+                                   size_t capacity,
+                                   size_t hash);
+
+/**
+ * Marks a full slot as free
+ * @ctrl control bytes
+ * @capacity number of slots, a power of two
+ * @i slot index
+ *
+ * Returns 1 if the slot went back to empty, 0 if it was left as a
+ * tombstone because some probe sequence may run past it.
+ */
+inline unsigned int cu_hashmap_erase_ctrl(signed char* ctrl,
+                                          size_t capacity,
+                                          size_t i);
+
+/**
+ * Returns the number of slots that can be used in a table of a given
+ * capacity, 7/8 of them
+ */
+inline size_t cu_hashmap_growth(size_t capacity);
+
+
+
+#define cu_HASHMAP_DECLARE(name, ktype, vtype)                               \
+                                                                             \
+struct cu_hashmap_##name##_slot {                                            \
+	ktype key;                                                           \
+	vtype value;                                                         \
+};                                                                           \
+                                                                             \
+struct cu_hashmap_##name {                                                   \
+	/* private */                                                        \
+	struct cu_memblock ctrl;	/* capacity + cu_HASHMAP_GROUP bytes */ \
+	struct cu_memblock slots;	/* capacity slots */                 \
+	size_t capacity;		/* in slots, a power of two */       \
+	size_t size;			/* number of keys */                 \
+	size_t growth_left;		/* empty slots left before a rehash */ \
+};                                                                           \
+                                                                             \
+inline void cu_hashmap_##name##_init(struct cu_hashmap_##name* m);           \
+inline void cu_hashmap_##name##_init_allocator(struct cu_hashmap_##name* m,  \
+                                               const struct cu_allocator* a); \
+inline void cu_hashmap_##name##_deinit(struct cu_hashmap_##name* m);         \
+inline void cu_hashmap_##name##_clear(struct cu_hashmap_##name* m);          \
+inline size_t cu_hashmap_##name##_size(struct cu_hashmap_##name* m);         \
+inline void cu_hashmap_##name##_reserve(struct cu_hashmap_##name* m,         \
+                                        size_t n);                           \
+inline int cu_hashmap_##name##_put(struct cu_hashmap_##name* m,              \
+                                   ktype key,                                \
+                                   vtype value);                             \
+inline vtype* cu_hashmap_##name##_find(struct cu_hashmap_##name* m,          \
+                                       ktype key);                           \
+inline int cu_hashmap_##name##_get(struct cu_hashmap_##name* m,              \
+                                   ktype key,                                \
+                                   vtype* value);                            \
+inline int cu_hashmap_##name##_erase(struct cu_hashmap_##name* m,            \
+                                     ktype key);                             \
+inline void cu_hashmap_##name##_foreach(struct cu_hashmap_##name* m,         \
+                                        void (*fn)(ktype key,                \
+                                                   vtype* value,             \
+                                                   void* data),              \
+                                        void* data);                         \
+inline struct cu_hashmap_##name##_slot*                                      \
+cu_hashmap_##name##_lookup(struct cu_hashmap_##name* m,                      \
+                           ktype key,                                        \
+                           size_t h);                                        \
+inline void cu_hashmap_##name##_rehash(struct cu_hashmap_##name* m,          \
+                                       size_t capacity)
+
+
+#define cu_HASHMAP_DEFINE(name, ktype, vtype, hash)                          \
+                                                                             \
+void cu_hashmap_##name##_init(struct cu_hashmap_##name* m)                   \
+{                                                                            \
+	cu_hashmap_##name##_init_allocator(m, NULL);                         \
+}                                                                            \
+                                                                             \
+void cu_hashmap_##name##_init_allocator(struct cu_hashmap_##name* m,         \
+                                        const struct cu_allocator* a)        \
+{                                                                            \
+	assert(m);                                                           \
+	cu_memblock_init_allocator(&m->ctrl, a,                              \
+	                           cu_HASHMAP_MIN_CAPACITY + cu_HASHMAP_GROUP); \
+	cu_memblock_init_allocator(&m->slots, a, cu_HASHMAP_MIN_CAPACITY*    \
+	                           sizeof(struct cu_hashmap_##name##_slot)); \
+	cu_memblock_set(&m->ctrl, (unsigned char)cu_HASHMAP_EMPTY);          \
+	m->capacity = cu_HASHMAP_MIN_CAPACITY;                               \
+	m->size = 0;                                                         \
+	m->growth_left = cu_hashmap_growth(m->capacity);                     \
+}                                                                            \
+                                                                             \
+void cu_hashmap_##name##_deinit(struct cu_hashmap_##name* m)                 \
+{                                                                            \
+	assert(m);                                                           \
+	cu_memblock_deinit(&m->ctrl);                                        \
+	cu_memblock_deinit(&m->slots);                                       \
+}                                                                            \
+                                                                             \
+void cu_hashmap_##name##_clear(struct cu_hashmap_##name* m)                  \
+{                                                                            \
+	assert(m);                                                           \
+	cu_memblock_set(&m->ctrl, (unsigned char)cu_HASHMAP_EMPTY);          \
+	m->size = 0;                                                         \
+	m->growth_left = cu_hashmap_growth(m->capacity);                     \
+}                                                                            \
+                                                                             \
+size_t cu_hashmap_##name##_size(struct cu_hashmap_##name* m)                 \
+{                                                                            \
+	assert(m);                                                           \
+	return m->size;                                                      \
+}                                                                            \
+                                                                             \
+void cu_hashmap_##name##_reserve(struct cu_hashmap_##name* m,                \
+                                 size_t n)                                   \
+{                                                                            \
+	assert(m);                                                           \
+	assert(n <= SIZE_MAX/16);                                            \
+	/* smallest power of two keeping n slots under the 7/8 load */       \
+	size_t capacity = cu_array_container_round_pow2(n + (n + 6)/7 + 1);  \
+	if (capacity > m->capacity)                                          \
+		cu_hashmap_##name##_rehash(m, capacity);                     \
+}                                                                            \
+                                                                             \
+struct cu_hashmap_##name##_slot*                                             \
+cu_hashmap_##name##_lookup(struct cu_hashmap_##name* m,                      \
+                           ktype key,                                        \
+                           size_t h)                                         \
+{                                                                            \
+	const signed char* ctrl = (const signed char*)m->ctrl.mem;           \
+	struct cu_hashmap_##name##_slot* slots =                             \
+		(struct cu_hashmap_##name##_slot*)m->slots.mem;              \
+	size_t mask = m->capacity - 1;                                       \
+	size_t pos = cu_HASHMAP_H1(h) & mask;                                \
+	size_t stride = 0;                                                   \
+	for (;;) {                                                           \
+		unsigned int bits = cu_hashmap_match(ctrl + pos, cu_HASHMAP_H2(h)); \
+		while (bits) {                                               \
+			size_t at = (pos + __builtin_ctz(bits)) & mask;      \
+			if (slots[at].key == key)                            \
+				return slots + at;                           \
+			bits &= bits - 1;                                    \
+		}                                                            \
+		/* an empty slot ends every probe sequence through it */     \
+		if (cu_hashmap_match_empty(ctrl + pos))                      \
+			return NULL;                                         \
+		stride += cu_HASHMAP_GROUP;                                  \
+		pos = (pos + stride) & mask;                                 \
+	}                                                                    \
+}                                                                            \
+                                                                             \
+void cu_hashmap_##name##_rehash(struct cu_hashmap_##name* m,                 \
+                                size_t capacity)                             \
+{                                                                            \
+	assert(m);                                                           \
+	assert(capacity >= cu_HASHMAP_MIN_CAPACITY);                         \
+	assert(!(capacity & (capacity - 1)));                                \
+	assert(cu_hashmap_growth(capacity) > m->size);                       \
+	const signed char* old_ctrl = (const signed char*)m->ctrl.mem;       \
+	struct cu_hashmap_##name##_slot* old =                               \
+		(struct cu_hashmap_##name##_slot*)m->slots.mem;              \
+	struct cu_memblock ctrl, slots;                                      \
+	size_t i;                                                            \
+                                                                             \
+	cu_memblock_init_allocator(&ctrl, m->ctrl.allocator,                 \
+	                           capacity + cu_HASHMAP_GROUP);             \
+	cu_memblock_init_allocator(&slots, m->slots.allocator, capacity*     \
+	                           sizeof(struct cu_hashmap_##name##_slot)); \
+	cu_memblock_set(&ctrl, (unsigned char)cu_HASHMAP_EMPTY);             \
+	for (i=0; i<m->capacity; i++)                                        \
+		if (old_ctrl[i] >= 0) {                                      \
+			size_t h = hash(old[i].key);                         \
+			size_t at = cu_hashmap_find_free((signed char*)ctrl.mem, \
+			                                 capacity, h);       \
+			cu_hashmap_set_ctrl((signed char*)ctrl.mem, capacity, \
+			                    at, cu_HASHMAP_H2(h));           \
+			((struct cu_hashmap_##name##_slot*)slots.mem)[at] = old[i]; \
+		}                                                            \
+	cu_memblock_deinit(&m->ctrl);                                        \
+	cu_memblock_deinit(&m->slots);                                       \
+	m->ctrl = ctrl;                                                      \
+	m->slots = slots;                                                    \
+	m->capacity = capacity;                                              \
+	m->growth_left = cu_hashmap_growth(capacity) - m->size;              \
+}                                                                            \
+                                                                             \
+int cu_hashmap_##name##_put(struct cu_hashmap_##name* m,                     \
+                            ktype key,                                       \
+                            vtype value)                                     \
+{                                                                            \
+	assert(m);                                                           \
+	size_t h = hash(key);                                                \
+	struct cu_hashmap_##name##_slot* s =                                 \
+		cu_hashmap_##name##_lookup(m, key, h);                       \
+	if (s) {                                                             \
+		s->value = value;                                            \
+		return 0;                                                    \
+	}                                                                    \
+                                                                             \
+	size_t at = cu_hashmap_find_free((signed char*)m->ctrl.mem,          \
+	                                 m->capacity, h);                    \
+	if (!m->growth_left                                                  \
+	    && ((signed char*)m->ctrl.mem)[at] == cu_HASHMAP_EMPTY) {        \
+		/* mostly tombstones: clean them up in place of growing */   \
+		if (m->size <= cu_hashmap_growth(m->capacity)/2)             \
+			cu_hashmap_##name##_rehash(m, m->capacity);          \
+		else                                                         \
+			cu_hashmap_##name##_rehash(m, m->capacity*2);        \
+		at = cu_hashmap_find_free((signed char*)m->ctrl.mem,         \
+		                          m->capacity, h);                   \
+	}                                                                    \
+	/* reusing a tombstone leaves the empty slots untouched */           \
+	if (((signed char*)m->ctrl.mem)[at] == cu_HASHMAP_EMPTY)             \
+		m->growth_left --;                                           \
+	cu_hashmap_set_ctrl((signed char*)m->ctrl.mem, m->capacity, at,      \
+	                    cu_HASHMAP_H2(h));                               \
+	s = (struct cu_hashmap_##name##_slot*)m->slots.mem + at;             \
+	s->key = key;                                                        \
+	s->value = value;                                                    \
+	m->size ++;                                                          \
+	return 1;                                                            \
+}                                                                            \
+                                                                             \
+vtype* cu_hashmap_##name##_find(struct cu_hashmap_##name* m,                 \
+                                ktype key)                                   \
+{                                                                            \
+	assert(m);                                                           \
+	struct cu_hashmap_##name##_slot* s =                                 \
+		cu_hashmap_##name##_lookup(m, key, hash(key));               \
+	return s ? &s->value : NULL;                                         \
+}                                                                            \
+                                                                             \
+int cu_hashmap_##name##_get(struct cu_hashmap_##name* m,                     \
+                            ktype key,                                       \
+                            vtype* value)                                    \
+{                                                                            \
+	assert(m);                                                           \
+	assert(value);                                                       \
+	struct cu_hashmap_##name##_slot* s =                                 \
+		cu_hashmap_##name##_lookup(m, key, hash(key));               \
+	if (!s)                                                              \
+		return 0;                                                    \
+	*value = s->value;                                                   \
+	return 1;                                                            \
+}                                                                            \
+                                                                             \
+int cu_hashmap_##name##_erase(struct cu_hashmap_##name* m,                   \
+                              ktype key)                                     \
+{                                                                            \
+	assert(m);                                                           \
+	struct cu_hashmap_##name##_slot* s =                                 \
+		cu_hashmap_##name##_lookup(m, key, hash(key));               \
+	if (!s)                                                              \
+		return 0;                                                    \
+	size_t at = s - (struct cu_hashmap_##name##_slot*)m->slots.mem;      \
+	m->growth_left += cu_hashmap_erase_ctrl((signed char*)m->ctrl.mem,   \
+	                                        m->capacity, at);            \
+	m->size --;                                                          \
+	return 1;                                                            \
+}                                                                            \
+                                                                             \
+void cu_hashmap_##name##_foreach(struct cu_hashmap_##name* m,                \
+                                 void (*fn)(ktype key,                       \
+                                            vtype* value,                    \
+                                            void* data),                     \
+                                 void* data)                                 \
+{                                                                            \
+	assert(m);                                                           \
+	assert(fn);                                                          \
+	const signed char* ctrl = (const signed char*)m->ctrl.mem;           \
+	struct cu_hashmap_##name##_slot* slots =                             \
+		(struct cu_hashmap_##name##_slot*)m->slots.mem;              \
+	size_t i;                                                            \
+	for (i=0; i<m->capacity; i++)                                        \
+		if (ctrl[i] >= 0)                                            \
+			fn(slots[i].key, &slots[i].value, data);             \
+}
+
+
+size_t cu_hashmap_hash_uint(unsigned int key)
+{
+	/* multiplicative hashing, folding the high bits down so the 7
+	 * control bits depend on the whole key */
+	uint64_t h = (uint64_t)key*0x9e3779b97f4a7c15ull;
+	return (size_t)(h ^ (h >> 32));
+}
+
+
+size_t cu_hashmap_hash_ptr(const void* key)
+{
+	uint64_t h = (uint64_t)(uintptr_t)key*0x9e3779b97f4a7c15ull;
+	return (size_t)(h ^ (h >> 32));
+}
+
+
+unsigned int cu_hashmap_match(const signed char* group,
+                              signed char h2)
+{
+#if defined(__SSE2__)
+	__m128i g = _mm_loadu_si128((const __m128i*)group);
+	return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(h2)));
+#else
+	unsigned int i, mask = 0;
+	for (i=0; i<cu_HASHMAP_GROUP; i++)
+		mask |= (unsigned int)(group[i] == h2) << i;
+	return mask;
+#endif
+}
+
+
+unsigned int cu_hashmap_match_empty(const signed char* group)
+{
+	return cu_hashmap_match(group, cu_HASHMAP_EMPTY);
+}
+
+
+unsigned int cu_hashmap_match_free(const signed char* group)
+{
+#if defined(__SSE2__)
+	/* empty and deleted are the only bytes with the sign bit set */
+	return (unsigned int)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+	unsigned int i, mask = 0;
+	for (i=0; i<cu_HASHMAP_GROUP; i++)
+		mask |= (unsigned int)(group[i] < 0) << i;
+	return mask;
+#endif
+}
+
+
+void cu_hashmap_set_ctrl(signed char* ctrl,
+                         size_t capacity,
+                         size_t i,
+                         signed char c)
+{
+	assert(ctrl);
+	assert(i < capacity);
+	ctrl[i] = c;
+	/* the first group is cloned after the last slot; for the other
+	 * slots this writes ctrl[i] again */
+	ctrl[((i - cu_HASHMAP_GROUP) & (capacity - 1)) + cu_HASHMAP_GROUP] = c;
+}
+
+
+size_t cu_hashmap_find_free(const signed char* ctrl,
+                            size_t capacity,
+                            size_t hash)
+{
+	assert(ctrl);
+	size_t mask = capacity - 1;
+	size_t pos = cu_HASHMAP_H1(hash) & mask;
+	size_t stride = 0;
+	/* triangular probing over groups visits all the table when the
+	 * capacity is a power of two */
+	for (;;) {
+		unsigned int bits = cu_hashmap_match_free(ctrl + pos);
+		if (bits)
+			return (pos + __builtin_ctz(bits)) & mask;
+		stride += cu_HASHMAP_GROUP;
+		pos = (pos + stride) & mask;
+	}
+}
+
+
+unsigned int cu_hashmap_erase_ctrl(signed char* ctrl,
+                                   size_t capacity,
+                                   size_t i)
+{
+	assert(ctrl);
+	assert(i < capacity);
+	unsigned int before = cu_hashmap_match_empty(ctrl + ((i - cu_HASHMAP_GROUP) & (capacity - 1)));
+	unsigned int after = cu_hashmap_match_empty(ctrl + i);
+
+	/* if no group holding the slot was ever full, no probe sequence
+	 * went past it and it can be empty again */
+	if (before && after
+	    && __builtin_clz(before) - (sizeof(unsigned int)*8 - cu_HASHMAP_GROUP)
+	       + __builtin_ctz(after) < cu_HASHMAP_GROUP) {
+		cu_hashmap_set_ctrl(ctrl, capacity, i, cu_HASHMAP_EMPTY);
+		return 1;
+	}
+	cu_hashmap_set_ctrl(ctrl, capacity, i, cu_HASHMAP_DELETED);
+	return 0;
+}
+
+
+size_t cu_hashmap_growth(size_t capacity)
+{
+	return capacity - capacity/8;
+}
+
+#endif /* cu_hashmap_h */
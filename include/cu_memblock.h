@@ -27,14 +27,17 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "cu_debug.h"
+#include "cu_allocator.h"
 
 
 struct cu_memblock {
 	/* private */
 	void* mem;
-	unsigned int size;	/* in bytes */
+	size_t size;	/* in bytes */
+	const struct cu_allocator* allocator;	/* memory source */
 };
 
 
@@ -44,7 +47,21 @@ struct cu_memblock {
  * @s amount of bytes to be reserved
  */
 inline void cu_memblock_init(struct cu_memblock* mb,
-                             unsigned int s);
+                             size_t s);
+
+
+/**
+ * Inits a cu_memblock allocating the given amount of bytes from an allocator
+ * @mb ptr to the cu_memblock struct to be inited
+ * @a allocator the memory comes from, NULL for cu_allocator_heap()
+ * @s amount of bytes to be reserved
+ *
+ * The allocator must outlive the cu_memblock, which keeps using it to
+ * resize and free its memory.
+ */
+inline void cu_memblock_init_allocator(struct cu_memblock* mb,
+                                       const struct cu_allocator* a,
+                                       size_t s);
 
 
 /**
@@ -59,7 +76,7 @@ inline void cu_memblock_deinit(struct cu_memblock* mb);
  * @r new size in bytes
  */
 inline void cu_memblock_set_size(struct cu_memblock* mb,
-                                 unsigned int r);
+                                 size_t r);
 
 
 /**
@@ -73,7 +90,7 @@ inline void cu_memblock_set_size(struct cu_memblock* mb,
  */
 inline void cu_memblock_assign(struct cu_memblock* mb,
                                const void* buf,
-                               unsigned int len);
+                               size_t len);
 
 
 /**
@@ -85,22 +102,46 @@ inline void cu_memblock_set (struct cu_memblock* mb,
                              unsigned char c);
 
 
+/**
+ * Memsets a range of bytes in the cu_memblock to a given value
+ * @mb cu_memblock to be used
+ * @offset first byte to be set
+ * @len number of bytes to set
+ * @c value to use for memset
+ */
+inline void cu_memblock_set_range(struct cu_memblock* mb,
+                                  size_t offset,
+                                  size_t len,
+                                  unsigned char c);
+
+
 /**
  * Clones two memblocks
  * @dest destination block
  * @src source block
+ *
+ * dest keeps allocating from its own allocator.
  */
 inline void cu_memblock_clone(struct cu_memblock* dest,
                               struct cu_memblock* src);
 
 
 void cu_memblock_init(struct cu_memblock* mb,
-                      unsigned int s)
+                      size_t s)
+{
+	cu_memblock_init_allocator(mb, NULL, s);
+}
+
+
+void cu_memblock_init_allocator(struct cu_memblock* mb,
+                                const struct cu_allocator* a,
+                                size_t s)
 {
 	assert(mb);
 	assert(s);
 	mb->size = s;
-	mb->mem = malloc(s);
+	mb->allocator = a ? a : cu_allocator_heap();
+	mb->mem = mb->allocator->alloc(mb->allocator->ctx, s);
 
 	if (!mb->mem) {
 		printf("warning cu_memblock_init, malloc\n");
@@ -111,17 +152,17 @@ void cu_memblock_init(struct cu_memblock* mb,
 
 void cu_memblock_deinit(struct cu_memblock* mb) {
 	assert(mb);
-	free(mb->mem);
+	mb->allocator->free(mb->allocator->ctx, mb->mem, mb->size);
 }
 
 
 void cu_memblock_set_size(struct cu_memblock* mb,
-                          unsigned int r)
+                          size_t r)
 {
 	assert(mb);
 	assert(r);
+	mb->mem = mb->allocator->realloc(mb->allocator->ctx, mb->mem, mb->size, r);
 	mb->size = r;
-	mb->mem = realloc(mb->mem, mb->size);
 
 	if (!mb->mem) {
 		printf("warning cu_memblock_set_size, realloc failed\n");
@@ -132,7 +173,7 @@ void cu_memblock_set_size(struct cu_memblock* mb,
 
 void cu_memblock_assign(struct cu_memblock* mb,
                         const void* buf,
-                        unsigned int len) 
+                        size_t len) 
 {
 	assert(mb);
 	assert(buf);
@@ -152,13 +193,25 @@ void cu_memblock_set(struct cu_memblock* mb,
 	memset(mb->mem,c,mb->size);
 }
 
+
+void cu_memblock_set_range(struct cu_memblock* mb,
+                           size_t offset,
+                           size_t len,
+                           unsigned char c)
+{
+	assert(mb);
+	assert(offset <= mb->size && len <= mb->size - offset);
+	memset((char*)mb->mem + offset, c, len);
+}
+
+
 void cu_memblock_clone(struct cu_memblock* dest,
                        struct cu_memblock* src)
 {
 	assert(dest);
 	assert(src);
 	cu_memblock_deinit(dest);
-	cu_memblock_init(dest, src->size);
+	cu_memblock_init_allocator(dest, dest->allocator, src->size);
 	cu_memblock_assign(dest, src->mem, src->size);
 }
 
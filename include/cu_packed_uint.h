@@ -0,0 +1,446 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_packed_uint_h
+#define cu_packed_uint_h 1
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cu_debug.h"
+#include "cu_vector.h"
+#include "cu_vector_uint.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+/*
+ * A read-mostly compressed array of unsigned ints. Values are split in
+ * blocks of cu_PACKED_UINT_BLOCK values; each block is stored as the
+ * differences from the previous value (sorted input, cu_PACKED_UINT_DELTA)
+ * or from the block minimum (small ranges, cu_PACKED_UINT_FOR), packed
+ * with as many bits as its biggest difference needs.
+ *
+ * Bits are packed across 4 interleaved 32 bit lanes, value i of a block
+ * going to lane i%4, so a block is decoded with 4 wide SIMD shifts and
+ * masks. A skip index keeps, for each block, its first word, its base
+ * value and its bit width: random access decodes at most one block and
+ * searches on sorted data skip whole blocks.
+ */
+#define cu_PACKED_UINT_BLOCK (size_t)128
+#define cu_PACKED_UINT_LANES 4
+
+#define cu_PACKED_UINT_DELTA 0
+#define cu_PACKED_UINT_FOR   1
+
+
+struct cu_packed_uint_block {
+	size_t offset;		/* first word of the block */
+	unsigned int base;	/* first value (DELTA) or minimum (FOR) */
+	unsigned int bits;	/* bits per packed value, 0 to 32 */
+};
+
+cu_VECTOR_DECLARE(packed_uint_blocks, struct cu_packed_uint_block);
+
+
+struct cu_packed_uint {
+	/* private */
+	struct cu_vector_uint words;
+	struct cu_vector_packed_uint_blocks blocks;
+	size_t size;
+	unsigned int mode;
+};
+
+
+/**
+ * Inits an empty cu_packed_uint
+ * @p cu_packed_uint to be used
+ */
+inline void cu_packed_uint_init(struct cu_packed_uint* p);
+
+/**
+ * Deinits a cu_packed_uint
+ * @p cu_packed_uint to be used
+ */
+inline void cu_packed_uint_deinit(struct cu_packed_uint* p);
+
+/**
+ * Removes all the values
+ * @p cu_packed_uint to be used
+ */
+inline void cu_packed_uint_clear(struct cu_packed_uint* p);
+
+/**
+ * Replaces the contents of a cu_packed_uint with the values of a vector
+ * @p cu_packed_uint to be used
+ * @v values to be packed
+ * @mode cu_PACKED_UINT_DELTA, for values in increasing order (repeated
+ *       values allowed), or cu_PACKED_UINT_FOR for any order
+ */
+inline void cu_packed_uint_from_vector(struct cu_packed_uint* p,
+                                       struct cu_vector_uint* v,
+                                       unsigned int mode);
+
+/**
+ * Returns the number of values
+ * @p cu_packed_uint to be used
+ */
+inline size_t cu_packed_uint_size(struct cu_packed_uint* p);
+
+/**
+ * Returns the number of bytes used by the packed values and their index
+ * @p cu_packed_uint to be used
+ */
+inline size_t cu_packed_uint_memory_usage(struct cu_packed_uint* p);
+
+/**
+ * Returns the value at a given position
+ * @p cu_packed_uint to be used
+ * @at index of the value
+ */
+inline unsigned int cu_packed_uint_at(struct cu_packed_uint* p,
+                                      size_t at);
+
+/**
+ * Decodes a block of values
+ * @p cu_packed_uint to be used
+ * @block index of the block, the values at block*cu_PACKED_UINT_BLOCK on
+ * @out room for cu_PACKED_UINT_BLOCK values
+ *
+ * Returns the number of values in the block, less than
+ * cu_PACKED_UINT_BLOCK for the last one only.
+ */
+inline size_t cu_packed_uint_decode_block(struct cu_packed_uint* p,
+                                          size_t block,
+                                          unsigned int* out);
+
+/**
+ * Appends all the values to a vector
+ * @p cu_packed_uint to be used
+ * @dest cu_vector_uint the values are appended to
+ */
+inline void cu_packed_uint_decode(struct cu_packed_uint* p,
+                                  struct cu_vector_uint* dest);
+
+/**
+ * Returns the index of the first value not less than a given one
+ * @p cu_packed_uint built with cu_PACKED_UINT_DELTA
+ * @value value to look for
+ *
+ * Returns cu_packed_uint_size(..) when all the values are less than value.
+ */
+inline size_t cu_packed_uint_lower_bound(struct cu_packed_uint* p,
+                                         unsigned int value);
+
+
+/* protected api */
+
+/**
+ * Packs a block of cu_PACKED_UINT_BLOCK values, appending
+ * 4*bits words to a vector
+ */
+inline void cu_packed_uint_pack(struct cu_vector_uint* words,
+                                const unsigned int* in,
+                                unsigned int bits);
+
+/**
+ * Unpacks cu_PACKED_UINT_BLOCK values of the given bit width
+ */
+inline void cu_packed_uint_unpack(const unsigned int* words,
+                                  unsigned int bits,
+                                  unsigned int* out);
+
+/**
+ * Returns the value at position i of a packed block
+ */
+inline unsigned int cu_packed_uint_extract(const unsigned int* words,
+                                           unsigned int bits,
+                                           size_t i);
+
+
+
+cu_VECTOR_DEFINE(packed_uint_blocks, struct cu_packed_uint_block)
+
+
+void cu_packed_uint_init(struct cu_packed_uint* p)
+{
+	assert(p);
+	cu_vector_uint_init(&p->words);
+	cu_vector_packed_uint_blocks_init(&p->blocks);
+	p->size = 0;
+	p->mode = cu_PACKED_UINT_DELTA;
+}
+
+
+void cu_packed_uint_deinit(struct cu_packed_uint* p)
+{
+	assert(p);
+	cu_vector_uint_deinit(&p->words);
+	cu_vector_packed_uint_blocks_deinit(&p->blocks);
+}
+
+
+void cu_packed_uint_clear(struct cu_packed_uint* p)
+{
+	assert(p);
+	cu_vector_uint_clear(&p->words);
+	cu_vector_packed_uint_blocks_clear(&p->blocks);
+	p->size = 0;
+}
+
+
+void cu_packed_uint_pack(struct cu_vector_uint* words,
+                         const unsigned int* in,
+                         unsigned int bits)
+{
+	size_t first = cu_vector_uint_size(words);
+	cu_vector_uint_resize(words, first + cu_PACKED_UINT_LANES*bits, 0);
+	unsigned int* w = cu_vector_uint_data(words) + first;
+
+	/* value k of a lane starts at bit k*bits of the lane */
+	for (unsigned int k=0; k< cu_PACKED_UINT_BLOCK/cu_PACKED_UINT_LANES && bits; k++) {
+		unsigned int pos = k*bits, sh = pos % 32;
+		unsigned int* lane = w + pos/32*cu_PACKED_UINT_LANES;
+		for (unsigned int l=0; l< cu_PACKED_UINT_LANES; l++) {
+			unsigned int x = in[k*cu_PACKED_UINT_LANES + l];
+			lane[l] |= x << sh;
+			if (sh + bits > 32)
+				lane[l + cu_PACKED_UINT_LANES] |= x >> (32 - sh);
+		}
+	}
+}
+
+
+void cu_packed_uint_unpack(const unsigned int* words,
+                           unsigned int bits,
+                           unsigned int* out)
+{
+	unsigned int mask = bits == 32 ? ~0u : (1u << bits) - 1;
+
+	if (!bits) {
+		memset(out, 0, cu_PACKED_UINT_BLOCK*sizeof(unsigned int));
+		return;
+	}
+	for (unsigned int k=0; k< cu_PACKED_UINT_BLOCK/cu_PACKED_UINT_LANES; k++) {
+		unsigned int pos = k*bits, sh = pos % 32;
+		const unsigned int* lane = words + pos/32*cu_PACKED_UINT_LANES;
+#if defined(__SSE2__)
+		__m128i x = _mm_srl_epi32(_mm_loadu_si128((const __m128i*)lane),
+		                          _mm_cvtsi32_si128((int)sh));
+		if (sh + bits > 32)
+			x = _mm_or_si128(x, _mm_sll_epi32(_mm_loadu_si128((const __m128i*)(lane + cu_PACKED_UINT_LANES)),
+			                                  _mm_cvtsi32_si128((int)(32 - sh))));
+		_mm_storeu_si128((__m128i*)(out + k*cu_PACKED_UINT_LANES),
+		                 _mm_and_si128(x, _mm_set1_epi32((int)mask)));
+#else
+		for (unsigned int l=0; l< cu_PACKED_UINT_LANES; l++) {
+			unsigned int x = lane[l] >> sh;
+			if (sh + bits > 32)
+				x |= lane[l + cu_PACKED_UINT_LANES] << (32 - sh);
+			out[k*cu_PACKED_UINT_LANES + l] = x & mask;
+		}
+#endif
+	}
+}
+
+
+unsigned int cu_packed_uint_extract(const unsigned int* words,
+                                    unsigned int bits,
+                                    size_t i)
+{
+	unsigned int mask = bits == 32 ? ~0u : (1u << bits) - 1;
+	unsigned int pos = (unsigned int)(i/cu_PACKED_UINT_LANES)*bits, sh = pos % 32;
+	const unsigned int* lane = words + pos/32*cu_PACKED_UINT_LANES + i%cu_PACKED_UINT_LANES;
+	unsigned int x;
+
+	if (!bits)
+		return 0;
+	x = lane[0] >> sh;
+	if (sh + bits > 32)
+		x |= lane[cu_PACKED_UINT_LANES] << (32 - sh);
+	return x & mask;
+}
+
+
+void cu_packed_uint_from_vector(struct cu_packed_uint* p,
+                                struct cu_vector_uint* v,
+                                unsigned int mode)
+{
+	assert(p);
+	assert(v);
+	assert(mode == cu_PACKED_UINT_DELTA || mode == cu_PACKED_UINT_FOR);
+	const unsigned int* d = cu_vector_uint_data(v);
+	size_t n = cu_vector_uint_size(v);
+	unsigned int diffs[cu_PACKED_UINT_BLOCK];
+
+	cu_packed_uint_clear(p);
+	p->mode = mode;
+	p->size = n;
+	cu_vector_packed_uint_blocks_reserve(&p->blocks,
+	                                     (n + cu_PACKED_UINT_BLOCK - 1)/cu_PACKED_UINT_BLOCK + 1);
+
+	for (size_t first=0; first< n; first+= cu_PACKED_UINT_BLOCK) {
+		size_t len = n - first < cu_PACKED_UINT_BLOCK ? n - first : cu_PACKED_UINT_BLOCK;
+		struct cu_packed_uint_block b;
+		unsigned int all = 0;
+
+		b.offset = cu_vector_uint_size(&p->words);
+		b.base = d[first];
+		if (mode == cu_PACKED_UINT_FOR)
+			for (size_t i=1; i< len; i++)
+				b.base = d[first + i] < b.base ? d[first + i] : b.base;
+
+		/* a short last block is padded with zero differences */
+		for (size_t i=0; i< cu_PACKED_UINT_BLOCK; i++) {
+			if (i >= len)
+				diffs[i] = 0;
+			else if (mode == cu_PACKED_UINT_FOR)
+				diffs[i] = d[first + i] - b.base;
+			else {
+				if (i && d[first + i] < d[first + i - 1]) {
+					printf("warning cu_packed_uint_from_vector, values not sorted\n");
+					assert(0);
+				}
+				diffs[i] = i ? d[first + i] - d[first + i - 1] : 0;
+			}
+			all |= diffs[i];
+		}
+
+		b.bits = all ? 32 - __builtin_clz(all) : 0;
+		cu_packed_uint_pack(&p->words, diffs, b.bits);
+		cu_vector_packed_uint_blocks_push_back(&p->blocks, b);
+	}
+}
+
+
+size_t cu_packed_uint_size(struct cu_packed_uint* p)
+{
+	assert(p);
+	return p->size;
+}
+
+
+size_t cu_packed_uint_memory_usage(struct cu_packed_uint* p)
+{
+	assert(p);
+	return cu_vector_uint_size(&p->words)*sizeof(unsigned int)
+	       + cu_vector_packed_uint_blocks_size(&p->blocks)*sizeof(struct cu_packed_uint_block);
+}
+
+
+unsigned int cu_packed_uint_at(struct cu_packed_uint* p,
+                               size_t at)
+{
+	assert(p);
+	assert(at < p->size);
+	struct cu_packed_uint_block* b = cu_vector_packed_uint_blocks_data(&p->blocks)
+	                                 + at/cu_PACKED_UINT_BLOCK;
+	const unsigned int* w = cu_vector_uint_data(&p->words) + b->offset;
+	size_t k = at % cu_PACKED_UINT_BLOCK;
+
+	if (p->mode == cu_PACKED_UINT_FOR)
+		return b->base + cu_packed_uint_extract(w, b->bits, k);
+
+	/* deltas up to k are needed, decoding the block is cheaper than
+	 * extracting them one by one past a few values */
+	if (k < 8) {
+		unsigned int x = b->base;
+		for (size_t i=1; i<= k; i++)
+			x += cu_packed_uint_extract(w, b->bits, i);
+		return x;
+	}
+	unsigned int out[cu_PACKED_UINT_BLOCK];
+	cu_packed_uint_decode_block(p, at/cu_PACKED_UINT_BLOCK, out);
+	return out[k];
+}
+
+
+size_t cu_packed_uint_decode_block(struct cu_packed_uint* p,
+                                   size_t block,
+                                   unsigned int* out)
+{
+	assert(p);
+	assert(out);
+	assert(block < cu_vector_packed_uint_blocks_size(&p->blocks));
+	struct cu_packed_uint_block* b = cu_vector_packed_uint_blocks_data(&p->blocks) + block;
+	size_t first = block*cu_PACKED_UINT_BLOCK;
+
+	cu_packed_uint_unpack(cu_vector_uint_data(&p->words) + b->offset, b->bits, out);
+	if (p->mode == cu_PACKED_UINT_FOR) {
+		for (size_t i=0; i< cu_PACKED_UINT_BLOCK; i++)
+			out[i] += b->base;
+	} else {
+		out[0] = b->base;
+		for (size_t i=1; i< cu_PACKED_UINT_BLOCK; i++)
+			out[i] += out[i-1];
+	}
+	return p->size - first < cu_PACKED_UINT_BLOCK ? p->size - first : cu_PACKED_UINT_BLOCK;
+}
+
+
+void cu_packed_uint_decode(struct cu_packed_uint* p,
+                           struct cu_vector_uint* dest)
+{
+	assert(p);
+	assert(dest);
+	size_t num_blocks = cu_vector_packed_uint_blocks_size(&p->blocks);
+	size_t first = cu_vector_uint_size(dest);
+
+	/* whole blocks are decoded in place, so make room for the padding
+	 * of the last one too */
+	cu_vector_uint_resize(dest, first + num_blocks*cu_PACKED_UINT_BLOCK, 0);
+	for (size_t i=0; i< num_blocks; i++)
+		cu_packed_uint_decode_block(p, i, cu_vector_uint_data(dest) + first + i*cu_PACKED_UINT_BLOCK);
+	cu_vector_uint_resize(dest, first + p->size, 0);
+}
+
+
+size_t cu_packed_uint_lower_bound(struct cu_packed_uint* p,
+                                  unsigned int value)
+{
+	assert(p);
+	assert(p->mode == cu_PACKED_UINT_DELTA);
+	const struct cu_packed_uint_block* b = cu_vector_packed_uint_blocks_data(&p->blocks);
+	size_t lo = 0, hi = cu_vector_packed_uint_blocks_size(&p->blocks);
+	unsigned int out[cu_PACKED_UINT_BLOCK];
+
+	/* last block whose first value is less than value */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo)/2;
+		if (b[mid].base < value)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (!lo)
+		return 0;
+
+	size_t n = cu_packed_uint_decode_block(p, lo - 1, out), k = 0;
+	while (k < n && out[k] < value)
+		k++;
+	return (lo - 1)*cu_PACKED_UINT_BLOCK + k;
+}
+
+#endif /* cu_packed_uint_h */
@@ -0,0 +1,510 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_parallel_h
+#define cu_parallel_h 1
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cu_debug.h"
+#include "cu_thread_pool.h"
+#include "cu_vector_uint.h"
+#include "cu_vector_ptrs.h"
+#include "cu_bitmap.h"
+
+
+/*
+ * Parallel versions of whole container operations, run on a
+ * cu_thread_pool. Each thread gets ranges of about cu_PARALLEL_GRAIN
+ * bytes, big enough to hide the scheduling cost and small enough to
+ * balance the load; small containers are done by the calling thread
+ * alone.
+ */
+#define cu_PARALLEL_GRAIN (size_t)(256*1024)
+
+
+/**
+ * Sets all the elements of a vector to a value
+ * @pool cu_thread_pool to be used
+ * @v cu_vector_uint to be used
+ * @value value to set
+ */
+inline void cu_parallel_vector_uint_fill(struct cu_thread_pool* pool,
+                                         struct cu_vector_uint* v,
+                                         unsigned int value);
+
+/**
+ * Sets dest[i] to fn(src[i]) for all the elements of src
+ * @pool cu_thread_pool to be used
+ * @dest destination vector, resized to the size of src; can be src
+ * @src source vector
+ * @fn called from any thread
+ */
+inline void cu_parallel_vector_uint_transform(struct cu_thread_pool* pool,
+                                              struct cu_vector_uint* dest,
+                                              struct cu_vector_uint* src,
+                                              unsigned int (*fn)(unsigned int));
+
+/**
+ * Returns the sum of the elements, accumulated on 64 bits
+ * @pool cu_thread_pool to be used
+ * @v cu_vector_uint to be used
+ */
+inline uint64_t cu_parallel_vector_uint_sum(struct cu_thread_pool* pool,
+                                            struct cu_vector_uint* v);
+
+/**
+ * Makes dest a copy of src
+ * @pool cu_thread_pool to be used
+ * @dest destination vector
+ * @src source vector
+ */
+inline void cu_parallel_vector_uint_clone(struct cu_thread_pool* pool,
+                                          struct cu_vector_uint* dest,
+                                          struct cu_vector_uint* src);
+
+/**
+ * Sets all the elements of a vector to a value
+ * @pool cu_thread_pool to be used
+ * @v cu_vector_ptrs to be used
+ * @value value to set
+ */
+inline void cu_parallel_vector_ptrs_fill(struct cu_thread_pool* pool,
+                                         struct cu_vector_ptrs* v,
+                                         void* value);
+
+/**
+ * Sets dest[i] to fn(src[i]) for all the elements of src
+ * @pool cu_thread_pool to be used
+ * @dest destination vector, resized to the size of src; can be src
+ * @src source vector
+ * @fn called from any thread
+ */
+inline void cu_parallel_vector_ptrs_transform(struct cu_thread_pool* pool,
+                                              struct cu_vector_ptrs* dest,
+                                              struct cu_vector_ptrs* src,
+                                              void* (*fn)(void*));
+
+/**
+ * Makes dest a copy of src
+ * @pool cu_thread_pool to be used
+ * @dest destination vector
+ * @src source vector
+ */
+inline void cu_parallel_vector_ptrs_clone(struct cu_thread_pool* pool,
+                                          struct cu_vector_ptrs* dest,
+                                          struct cu_vector_ptrs* src);
+
+/**
+ * Sets or clears all the bits of a bitmap
+ * @pool cu_thread_pool to be used
+ * @bm cu_bitmap to be used
+ * @bit 1 to set the bits, 0 to clear them
+ */
+inline void cu_parallel_bitmap_fill(struct cu_thread_pool* pool,
+                                    struct cu_bitmap* bm,
+                                    unsigned int bit);
+
+/**
+ * Sets each word of dest to fn of the same word of src
+ * @pool cu_thread_pool to be used
+ * @dest destination bitmap, same size as src; can be src
+ * @src source bitmap
+ * @fn called from any thread, e.g. a bit permutation or a mask
+ *
+ * The padding bits of the last word are kept cleared.
+ */
+inline void cu_parallel_bitmap_transform(struct cu_thread_pool* pool,
+                                         struct cu_bitmap* dest,
+                                         struct cu_bitmap* src,
+                                         cu_BITMAP_WORD (*fn)(cu_BITMAP_WORD));
+
+/**
+ * Returns the number of set bits
+ * @pool cu_thread_pool to be used
+ * @bm cu_bitmap to be used
+ */
+inline size_t cu_parallel_bitmap_popcount(struct cu_thread_pool* pool,
+                                          struct cu_bitmap* bm);
+
+/**
+ * Makes dest a copy of src
+ * @pool cu_thread_pool to be used
+ * @dest destination bitmap
+ * @src source bitmap
+ */
+inline void cu_parallel_bitmap_clone(struct cu_thread_pool* pool,
+                                     struct cu_bitmap* dest,
+                                     struct cu_bitmap* src);
+
+
+/* protected api */
+
+/* what the range functions work on */
+struct cu_parallel_args {
+	void* dest;
+	const void* src;
+	unsigned int uint_value;
+	void* ptr_value;
+	unsigned int (*uint_fn)(unsigned int);
+	void* (*ptr_fn)(void*);
+	cu_BITMAP_WORD (*word_fn)(cu_BITMAP_WORD);
+};
+
+inline void cu_parallel_copy_range(size_t begin, size_t end, void* data);
+inline void cu_parallel_fill_byte_range(size_t begin, size_t end, void* data);
+inline void cu_parallel_fill_uint_range(size_t begin, size_t end, void* data);
+inline void cu_parallel_fill_ptr_range(size_t begin, size_t end, void* data);
+inline void cu_parallel_transform_uint_range(size_t begin, size_t end, void* data);
+inline void cu_parallel_transform_ptr_range(size_t begin, size_t end, void* data);
+inline void cu_parallel_transform_word_range(size_t begin, size_t end, void* data);
+inline void cu_parallel_sum_uint_range(size_t begin, size_t end,
+                                       void* partial, void* data);
+inline void cu_parallel_popcount_range(size_t begin, size_t end,
+                                       void* partial, void* data);
+inline void cu_parallel_combine_uint64(void* result, const void* partial, void* data);
+
+/**
+ * Copies n bytes from src to dest in parallel
+ */
+inline void cu_parallel_copy(struct cu_thread_pool* pool,
+                             void* dest,
+                             const void* src,
+                             size_t n);
+
+
+
+void cu_parallel_vector_uint_fill(struct cu_thread_pool* pool,
+                                  struct cu_vector_uint* v,
+                                  unsigned int value)
+{
+	assert(v);
+	struct cu_parallel_args args;
+	args.dest = cu_vector_uint_data(v);
+	args.uint_value = value;
+	cu_thread_pool_parallel_for(pool, cu_vector_uint_size(v),
+	                            cu_PARALLEL_GRAIN/sizeof(unsigned int),
+	                            cu_parallel_fill_uint_range, &args);
+}
+
+
+void cu_parallel_vector_uint_transform(struct cu_thread_pool* pool,
+                                       struct cu_vector_uint* dest,
+                                       struct cu_vector_uint* src,
+                                       unsigned int (*fn)(unsigned int))
+{
+	assert(dest);
+	assert(src);
+	assert(fn);
+	struct cu_parallel_args args;
+	cu_array_container_grow_to(&dest->ac, src->ac.size);
+	dest->ac.size = src->ac.size;
+	args.dest = cu_vector_uint_data(dest);
+	args.src = cu_vector_uint_data(src);
+	args.uint_fn = fn;
+	cu_thread_pool_parallel_for(pool, src->ac.size,
+	                            cu_PARALLEL_GRAIN/sizeof(unsigned int),
+	                            cu_parallel_transform_uint_range, &args);
+}
+
+
+uint64_t cu_parallel_vector_uint_sum(struct cu_thread_pool* pool,
+                                     struct cu_vector_uint* v)
+{
+	assert(v);
+	struct cu_parallel_args args;
+	uint64_t sum = 0;
+	args.src = cu_vector_uint_data(v);
+	cu_thread_pool_parallel_reduce(pool, cu_vector_uint_size(v),
+	                               cu_PARALLEL_GRAIN/sizeof(unsigned int),
+	                               cu_parallel_sum_uint_range,
+	                               cu_parallel_combine_uint64,
+	                               &sum, sizeof(sum), &args);
+	return sum;
+}
+
+
+void cu_parallel_vector_uint_clone(struct cu_thread_pool* pool,
+                                   struct cu_vector_uint* dest,
+                                   struct cu_vector_uint* src)
+{
+	assert(dest);
+	assert(src);
+	if (dest == src)
+		return;
+	dest->ac.size = 0;
+	cu_array_container_grow_to(&dest->ac, src->ac.size);
+	dest->ac.size = src->ac.size;
+	cu_parallel_copy(pool, cu_vector_uint_data(dest), cu_vector_uint_data(src),
+	                 src->ac.size*sizeof(unsigned int));
+}
+
+
+void cu_parallel_vector_ptrs_fill(struct cu_thread_pool* pool,
+                                  struct cu_vector_ptrs* v,
+                                  void* value)
+{
+	assert(v);
+	struct cu_parallel_args args;
+	args.dest = cu_vector_ptrs_data(v);
+	args.ptr_value = value;
+	cu_thread_pool_parallel_for(pool, cu_vector_ptrs_size(v),
+	                            cu_PARALLEL_GRAIN/sizeof(void*),
+	                            cu_parallel_fill_ptr_range, &args);
+}
+
+
+void cu_parallel_vector_ptrs_transform(struct cu_thread_pool* pool,
+                                       struct cu_vector_ptrs* dest,
+                                       struct cu_vector_ptrs* src,
+                                       void* (*fn)(void*))
+{
+	assert(dest);
+	assert(src);
+	assert(fn);
+	struct cu_parallel_args args;
+	cu_array_container_grow_to(&dest->ac, src->ac.size);
+	dest->ac.size = src->ac.size;
+	args.dest = cu_vector_ptrs_data(dest);
+	args.src = cu_vector_ptrs_data(src);
+	args.ptr_fn = fn;
+	cu_thread_pool_parallel_for(pool, src->ac.size,
+	                            cu_PARALLEL_GRAIN/sizeof(void*),
+	                            cu_parallel_transform_ptr_range, &args);
+}
+
+
+void cu_parallel_vector_ptrs_clone(struct cu_thread_pool* pool,
+                                   struct cu_vector_ptrs* dest,
+                                   struct cu_vector_ptrs* src)
+{
+	assert(dest);
+	assert(src);
+	if (dest == src)
+		return;
+	dest->ac.size = 0;
+	cu_array_container_grow_to(&dest->ac, src->ac.size);
+	dest->ac.size = src->ac.size;
+	cu_parallel_copy(pool, cu_vector_ptrs_data(dest), cu_vector_ptrs_data(src),
+	                 src->ac.size*sizeof(void*));
+}
+
+
+void cu_parallel_bitmap_fill(struct cu_thread_pool* pool,
+                             struct cu_bitmap* bm,
+                             unsigned int bit)
+{
+	assert(bm);
+	struct cu_parallel_args args;
+	cu_BITMAP_WORD* w = (cu_BITMAP_WORD*)bm->mblock.mem;
+	size_t n = cu_bitmap_words(bm);
+
+	args.dest = w;
+	args.uint_value = bit ? 0xff : 0;
+	cu_thread_pool_parallel_for(pool, n*sizeof(cu_BITMAP_WORD), cu_PARALLEL_GRAIN,
+	                            cu_parallel_fill_byte_range, &args);
+
+	/* keep the padding bits of the last word cleared */
+	if (bit && bm->size % cu_BITMAP_WORD_BITS)
+		w[n-1] &= ((cu_BITMAP_WORD)0x1 << (bm->size % cu_BITMAP_WORD_BITS)) - 1;
+}
+
+
+void cu_parallel_bitmap_transform(struct cu_thread_pool* pool,
+                                  struct cu_bitmap* dest,
+                                  struct cu_bitmap* src,
+                                  cu_BITMAP_WORD (*fn)(cu_BITMAP_WORD))
+{
+	assert(dest);
+	assert(src);
+	assert(fn);
+	assert(dest->size == src->size);
+	struct cu_parallel_args args;
+	cu_BITMAP_WORD* w = (cu_BITMAP_WORD*)dest->mblock.mem;
+	size_t n = cu_bitmap_words(dest);
+
+	args.dest = w;
+	args.src = src->mblock.mem;
+	args.word_fn = fn;
+	cu_thread_pool_parallel_for(pool, n, cu_PARALLEL_GRAIN/sizeof(cu_BITMAP_WORD),
+	                            cu_parallel_transform_word_range, &args);
+
+	if (dest->size % cu_BITMAP_WORD_BITS)
+		w[n-1] &= ((cu_BITMAP_WORD)0x1 << (dest->size % cu_BITMAP_WORD_BITS)) - 1;
+}
+
+
+size_t cu_parallel_bitmap_popcount(struct cu_thread_pool* pool,
+                                   struct cu_bitmap* bm)
+{
+	assert(bm);
+	struct cu_parallel_args args;
+	const cu_BITMAP_WORD* w = (const cu_BITMAP_WORD*)bm->mblock.mem;
+	size_t n = cu_bitmap_words(bm);
+	uint64_t count = 0;
+
+	args.src = w;
+	cu_thread_pool_parallel_reduce(pool, n - 1, cu_PARALLEL_GRAIN/sizeof(cu_BITMAP_WORD),
+	                               cu_parallel_popcount_range,
+	                               cu_parallel_combine_uint64,
+	                               &count, sizeof(count), &args);
+
+	/* ignore whatever lives in the padding bits of the last word */
+	cu_BITMAP_WORD last = w[n-1];
+	if (bm->size % cu_BITMAP_WORD_BITS)
+		last &= ((cu_BITMAP_WORD)0x1 << (bm->size % cu_BITMAP_WORD_BITS)) - 1;
+	return (size_t)count + __builtin_popcountl(last);
+}
+
+
+void cu_parallel_bitmap_clone(struct cu_thread_pool* pool,
+                              struct cu_bitmap* dest,
+                              struct cu_bitmap* src)
+{
+	assert(dest);
+	assert(src);
+	if (dest == src)
+		return;
+	if (dest->mblock.size != src->mblock.size)
+		cu_memblock_set_size(&dest->mblock, src->mblock.size);
+	dest->size = src->size;
+	cu_parallel_copy(pool, dest->mblock.mem, src->mblock.mem, src->mblock.size);
+}
+
+
+void cu_parallel_copy(struct cu_thread_pool* pool,
+                      void* dest,
+                      const void* src,
+                      size_t n)
+{
+	struct cu_parallel_args args;
+	args.dest = dest;
+	args.src = src;
+	cu_thread_pool_parallel_for(pool, n, cu_PARALLEL_GRAIN,
+	                            cu_parallel_copy_range, &args);
+}
+
+
+void cu_parallel_copy_range(size_t begin, size_t end, void* data)
+{
+	struct cu_parallel_args* args = (struct cu_parallel_args*)data;
+	memcpy((char*)args->dest + begin, (const char*)args->src + begin, end - begin);
+}
+
+
+void cu_parallel_fill_byte_range(size_t begin, size_t end, void* data)
+{
+	struct cu_parallel_args* args = (struct cu_parallel_args*)data;
+	memset((char*)args->dest + begin, (int)args->uint_value, end - begin);
+}
+
+
+void cu_parallel_fill_uint_range(size_t begin, size_t end, void* data)
+{
+	struct cu_parallel_args* args = (struct cu_parallel_args*)data;
+	unsigned int* d = (unsigned int*)args->dest;
+	for (size_t i=begin; i< end; i++)
+		d[i] = args->uint_value;
+}
+
+
+void cu_parallel_fill_ptr_range(size_t begin, size_t end, void* data)
+{
+	struct cu_parallel_args* args = (struct cu_parallel_args*)data;
+	void** d = (void**)args->dest;
+	for (size_t i=begin; i< end; i++)
+		d[i] = args->ptr_value;
+}
+
+
+void cu_parallel_transform_uint_range(size_t begin, size_t end, void* data)
+{
+	struct cu_parallel_args* args = (struct cu_parallel_args*)data;
+	unsigned int* d = (unsigned int*)args->dest;
+	const unsigned int* s = (const unsigned int*)args->src;
+	for (size_t i=begin; i< end; i++)
+		d[i] = args->uint_fn(s[i]);
+}
+
+
+void cu_parallel_transform_ptr_range(size_t begin, size_t end, void* data)
+{
+	struct cu_parallel_args* args = (struct cu_parallel_args*)data;
+	void** d = (void**)args->dest;
+	void* const* s = (void* const*)args->src;
+	for (size_t i=begin; i< end; i++)
+		d[i] = args->ptr_fn(s[i]);
+}
+
+
+void cu_parallel_transform_word_range(size_t begin, size_t end, void* data)
+{
+	struct cu_parallel_args* args = (struct cu_parallel_args*)data;
+	cu_BITMAP_WORD* d = (cu_BITMAP_WORD*)args->dest;
+	const cu_BITMAP_WORD* s = (const cu_BITMAP_WORD*)args->src;
+	for (size_t i=begin; i< end; i++)
+		d[i] = args->word_fn(s[i]);
+}
+
+
+void cu_parallel_sum_uint_range(size_t begin, size_t end,
+                                void* partial, void* data)
+{
+	struct cu_parallel_args* args = (struct cu_parallel_args*)data;
+	const unsigned int* s = (const unsigned int*)args->src;
+	uint64_t sum = 0;
+
+#ifdef cu_VECTOR_UINT_AVX2
+	if (cu_VECTOR_UINT_USE_AVX2()) {
+		*(uint64_t*)partial += cu_vector_uint_sum_avx2(s + begin, end - begin);
+		return;
+	}
+#endif
+	for (size_t i=begin; i< end; i++)
+		sum += s[i];
+	*(uint64_t*)partial += sum;
+}
+
+
+void cu_parallel_popcount_range(size_t begin, size_t end,
+                                void* partial, void* data)
+{
+	struct cu_parallel_args* args = (struct cu_parallel_args*)data;
+	const cu_BITMAP_WORD* s = (const cu_BITMAP_WORD*)args->src;
+	uint64_t count = 0;
+	for (size_t i=begin; i< end; i++)
+		count += __builtin_popcountl(s[i]);
+	*(uint64_t*)partial += count;
+}
+
+
+void cu_parallel_combine_uint64(void* result, const void* partial, void* data)
+{
+	(void)data;
+	*(uint64_t*)result += *(const uint64_t*)partial;
+}
+
+
+#endif /* cu_parallel_h */
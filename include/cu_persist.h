@@ -0,0 +1,459 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_persist_h
+#define cu_persist_h 1
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cu_debug.h"
+#include "cu_allocator.h"
+#include "cu_array_container.h"
+#include "cu_bitmap.h"
+
+
+/*
+ * On-disk vectors and bitmaps. A file is a cu_PERSIST_HEADER_SIZE bytes
+ * header followed by the raw contents of the container, so it can be
+ * mapped back with no deserialization: the container memory points into
+ * the mapping, page aligned, and pages are shared through the page cache
+ * by every process mapping the file.
+ *
+ * Files opened with cu_PERSIST_WRITE are mapped shared and read-write. A
+ * vector opened this way has the file as its allocator: growing the
+ * vector extends the file (ftruncate, then mremap where available, define
+ * _GNU_SOURCE before including any header). Call cu_persist_sync_vector
+ * before deiniting it to record its size; shrinking it to fit first
+ * trims the file too.
+ *
+ * Vectors from cu_vector.h are passed by their container, &v.ac. The
+ * format uses the host byte order and is checked when a file is opened.
+ */
+#define cu_PERSIST_HEADER_SIZE (size_t)4096
+#define cu_PERSIST_MAGIC "cutil.pv"
+#define cu_PERSIST_VERSION 1
+#define cu_PERSIST_BYTE_ORDER 0x01020304
+
+/* kinds of containers */
+#define cu_PERSIST_VECTOR 1
+#define cu_PERSIST_BITMAP 2
+
+/* open flags */
+#define cu_PERSIST_READ_ONLY 0x0
+#define cu_PERSIST_WRITE     0x1	/* map read-write, vectors grow the file */
+#define cu_PERSIST_CREATE    0x2	/* create (or truncate) the file */
+
+
+struct cu_persist_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t kind;
+	uint32_t pad;
+	uint64_t slot_size;	/* bytes per element, per storage word for bitmaps */
+	uint64_t size;		/* number of elements, of bits for bitmaps */
+};
+
+
+struct cu_persist_file {
+	/* private */
+	struct cu_allocator allocator;
+	int fd;
+	unsigned int flags;
+	void* map;		/* header, then the contents, MAP_FAILED if unmapped */
+	size_t length;		/* mapped bytes */
+};
+
+
+/**
+ * Writes a vector to a file
+ * @path file to be written
+ * @ac container of the vector
+ *
+ * Returns 0 on success, -1 on errors.
+ */
+inline int cu_persist_save_vector(const char* path,
+                                  struct cu_array_container* ac);
+
+/**
+ * Writes a bitmap to a file
+ * @path file to be written
+ * @bm cu_bitmap to be saved
+ *
+ * Returns 0 on success, -1 on errors.
+ */
+inline int cu_persist_save_bitmap(const char* path,
+                                  struct cu_bitmap* bm);
+
+/**
+ * Inits a vector mapping a file
+ * @f cu_persist_file handle, must outlive the vector
+ * @ac container of the vector to be inited
+ * @path file to be mapped
+ * @slot_size size of an element, must match the file's
+ * @flags or-ed cu_PERSIST_* flags, cu_PERSIST_CREATE needs cu_PERSIST_WRITE
+ *
+ * Returns 0 on success, -1 on errors (ac is left uninited). Vectors
+ * opened read-only must not be modified. Deiniting the vector unmaps and
+ * closes the file.
+ */
+inline int cu_persist_open_vector(struct cu_persist_file* f,
+                                  struct cu_array_container* ac,
+                                  const char* path,
+                                  size_t slot_size,
+                                  unsigned int flags);
+
+/**
+ * Inits a bitmap mapping a file written by cu_persist_save_bitmap
+ * @f cu_persist_file handle, must outlive the bitmap
+ * @bm cu_bitmap to be inited
+ * @path file to be mapped
+ * @flags cu_PERSIST_READ_ONLY or cu_PERSIST_WRITE
+ *
+ * Returns 0 on success, -1 on errors (bm is left uninited). With
+ * cu_PERSIST_WRITE changes to the bitmap go to the file.
+ */
+inline int cu_persist_open_bitmap(struct cu_persist_file* f,
+                                  struct cu_bitmap* bm,
+                                  const char* path,
+                                  unsigned int flags);
+
+/**
+ * Records the size of a vector opened with cu_PERSIST_WRITE in its file
+ * and flushes the mapping to disk
+ * @f cu_persist_file of the vector
+ * @ac container of the vector
+ *
+ * Returns 0 on success, -1 on errors.
+ */
+inline int cu_persist_sync_vector(struct cu_persist_file* f,
+                                  struct cu_array_container* ac);
+
+/**
+ * Flushes the mapping of a file opened with cu_PERSIST_WRITE to disk
+ * @f cu_persist_file to be used
+ *
+ * Returns 0 on success, -1 on errors.
+ */
+inline int cu_persist_sync(struct cu_persist_file* f);
+
+
+/* protected api */
+
+/* writes a header and the contents to a new file */
+inline int cu_persist_write(const char* path,
+                            uint32_t kind,
+                            size_t slot_size,
+                            size_t size,
+                            const void* mem,
+                            size_t bytes);
+
+/* opens a file and checks its header, or writes one with cu_PERSIST_CREATE */
+inline int cu_persist_open(struct cu_persist_file* f,
+                           const char* path,
+                           uint32_t kind,
+                           size_t slot_size,
+                           unsigned int flags,
+                           struct cu_persist_header* h);
+
+/* cu_allocator callbacks, ctx is the cu_persist_file; the first
+ * allocation maps the whole file */
+inline void* cu_persist_alloc(void* ctx, size_t s);
+inline void* cu_persist_realloc(void* ctx, void* p, size_t old_size, size_t s);
+inline void cu_persist_free(void* ctx, void* p, size_t s);
+
+
+
+int cu_persist_write(const char* path,
+                     uint32_t kind,
+                     size_t slot_size,
+                     size_t size,
+                     const void* mem,
+                     size_t bytes)
+{
+	char header[cu_PERSIST_HEADER_SIZE];
+	struct cu_persist_header* h = (struct cu_persist_header*)header;
+	const char* p = (const char*)mem;
+	int fd;
+
+	memset(header, 0, sizeof(header));
+	memcpy(h->magic, cu_PERSIST_MAGIC, sizeof(h->magic));
+	h->version = cu_PERSIST_VERSION;
+	h->byte_order = cu_PERSIST_BYTE_ORDER;
+	h->kind = kind;
+	h->slot_size = slot_size;
+	h->size = size;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		printf("warning cu_persist_write, can't create %s\n", path);
+		return -1;
+	}
+	if (write(fd, header, sizeof(header)) != (ssize_t)sizeof(header))
+		bytes = SIZE_MAX;
+	while (bytes && bytes != SIZE_MAX) {
+		ssize_t w = write(fd, p, bytes);
+		if (w <= 0)
+			bytes = SIZE_MAX;
+		else {
+			p += w;
+			bytes -= w;
+		}
+	}
+	if (close(fd) || bytes) {
+		printf("warning cu_persist_write, can't write %s\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+
+int cu_persist_save_vector(const char* path,
+                           struct cu_array_container* ac)
+{
+	assert(path);
+	assert(ac);
+	return cu_persist_write(path, cu_PERSIST_VECTOR, ac->slot_size, ac->size,
+	                        ac->mblock.mem, ac->size*ac->slot_size);
+}
+
+
+int cu_persist_save_bitmap(const char* path,
+                           struct cu_bitmap* bm)
+{
+	assert(path);
+	assert(bm);
+	return cu_persist_write(path, cu_PERSIST_BITMAP, sizeof(cu_BITMAP_WORD), bm->size,
+	                        bm->mblock.mem, cu_bitmap_words(bm)*sizeof(cu_BITMAP_WORD));
+}
+
+
+int cu_persist_open(struct cu_persist_file* f,
+                    const char* path,
+                    uint32_t kind,
+                    size_t slot_size,
+                    unsigned int flags,
+                    struct cu_persist_header* h)
+{
+	struct stat st;
+	uint64_t bytes;
+
+	assert(f);
+	assert(path);
+	assert(!(flags & cu_PERSIST_CREATE) || (flags & cu_PERSIST_WRITE));
+	f->flags = flags;
+	f->map = MAP_FAILED;
+	f->length = 0;
+	f->allocator.alloc = cu_persist_alloc;
+	f->allocator.realloc = cu_persist_realloc;
+	f->allocator.free = cu_persist_free;
+	f->allocator.ctx = f;
+
+	f->fd = open(path, (flags & cu_PERSIST_WRITE ? O_RDWR : O_RDONLY)
+	                   | (flags & cu_PERSIST_CREATE ? O_CREAT | O_TRUNC : 0), 0644);
+	if (f->fd < 0) {
+		printf("warning cu_persist_open, can't open %s\n", path);
+		return -1;
+	}
+
+	if (flags & cu_PERSIST_CREATE) {
+		char header[cu_PERSIST_HEADER_SIZE];
+		memset(header, 0, sizeof(header));
+		memset(h, 0, sizeof(*h));
+		memcpy(h->magic, cu_PERSIST_MAGIC, sizeof(h->magic));
+		h->version = cu_PERSIST_VERSION;
+		h->byte_order = cu_PERSIST_BYTE_ORDER;
+		h->kind = kind;
+		h->slot_size = slot_size;
+		memcpy(header, h, sizeof(*h));
+		if (write(f->fd, header, sizeof(header)) == (ssize_t)sizeof(header))
+			return 0;
+		printf("warning cu_persist_open, can't write %s\n", path);
+	} else if (pread(f->fd, h, sizeof(*h), 0) != (ssize_t)sizeof(*h)
+	           || memcmp(h->magic, cu_PERSIST_MAGIC, sizeof(h->magic))
+	           || h->version != cu_PERSIST_VERSION
+	           || h->byte_order != cu_PERSIST_BYTE_ORDER) {
+		printf("warning cu_persist_open, %s is not a (compatible) cutil file\n", path);
+	} else if (h->kind != kind || h->slot_size != slot_size) {
+		printf("warning cu_persist_open, %s holds a different container\n", path);
+	} else {
+		/* bitmaps store whole words */
+		bytes = kind == cu_PERSIST_BITMAP ? (h->size + 8*slot_size - 1)/(8*slot_size)*slot_size
+		                                  : h->size*slot_size;
+		if (!fstat(f->fd, &st) && (uint64_t)st.st_size >= cu_PERSIST_HEADER_SIZE + bytes)
+			return 0;
+		printf("warning cu_persist_open, %s is truncated\n", path);
+	}
+
+	close(f->fd);
+	return -1;
+}
+
+
+void* cu_persist_alloc(void* ctx, size_t s)
+{
+	struct cu_persist_file* f = (struct cu_persist_file*)ctx;
+	struct stat st;
+	size_t len;
+
+	assert(f->map == MAP_FAILED);
+	if (fstat(f->fd, &st))
+		return NULL;
+
+	/* map all the file, with room for s bytes at least */
+	len = (size_t)st.st_size > cu_PERSIST_HEADER_SIZE + s ? (size_t)st.st_size
+	                                                      : cu_PERSIST_HEADER_SIZE + s;
+	if ((f->flags & cu_PERSIST_WRITE) && (size_t)st.st_size < len
+	    && ftruncate(f->fd, (off_t)len))
+		return NULL;
+
+	f->map = mmap(NULL, len, PROT_READ | (f->flags & cu_PERSIST_WRITE ? PROT_WRITE : 0),
+	              MAP_SHARED, f->fd, 0);
+	if (f->map == MAP_FAILED)
+		return NULL;
+	f->length = len;
+	return (char*)f->map + cu_PERSIST_HEADER_SIZE;
+}
+
+
+void* cu_persist_realloc(void* ctx, void* p, size_t old_size, size_t s)
+{
+	struct cu_persist_file* f = (struct cu_persist_file*)ctx;
+	size_t len = cu_PERSIST_HEADER_SIZE + s;
+	void* q;
+	(void)p;
+	(void)old_size;
+
+	assert(p == (char*)f->map + cu_PERSIST_HEADER_SIZE);
+	if (!(f->flags & cu_PERSIST_WRITE)) {
+		printf("warning cu_persist_realloc, container is read-only\n");
+		assert(0);
+		return NULL;
+	}
+	if (ftruncate(f->fd, (off_t)len))
+		return NULL;
+
+#ifdef MREMAP_MAYMOVE
+	q = mremap(f->map, f->length, len, MREMAP_MAYMOVE);
+#else
+	/* the contents are in the file, map it again */
+	q = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+	if (q != MAP_FAILED)
+		munmap(f->map, f->length);
+#endif
+	if (q == MAP_FAILED)
+		return NULL;
+	f->map = q;
+	f->length = len;
+	return (char*)q + cu_PERSIST_HEADER_SIZE;
+}
+
+
+void cu_persist_free(void* ctx, void* p, size_t s)
+{
+	struct cu_persist_file* f = (struct cu_persist_file*)ctx;
+	(void)p;
+	(void)s;
+
+	assert(p == (char*)f->map + cu_PERSIST_HEADER_SIZE);
+	munmap(f->map, f->length);
+	close(f->fd);
+	f->map = MAP_FAILED;
+}
+
+
+int cu_persist_open_vector(struct cu_persist_file* f,
+                           struct cu_array_container* ac,
+                           const char* path,
+                           size_t slot_size,
+                           unsigned int flags)
+{
+	struct cu_persist_header h;
+
+	assert(ac);
+	if (cu_persist_open(f, path, cu_PERSIST_VECTOR, slot_size, flags, &h))
+		return -1;
+
+	cu_array_container_init_allocator(ac, &f->allocator, slot_size);
+	if (f->map == MAP_FAILED) {
+		close(f->fd);
+		return -1;
+	}
+	/* the container reserves whatever the file already holds */
+	ac->mblock.size = f->length - cu_PERSIST_HEADER_SIZE;
+	ac->reserved = ac->mblock.size/slot_size;
+	ac->size = h.size;
+	return 0;
+}
+
+
+int cu_persist_open_bitmap(struct cu_persist_file* f,
+                           struct cu_bitmap* bm,
+                           const char* path,
+                           unsigned int flags)
+{
+	struct cu_persist_header h;
+
+	assert(bm);
+	assert(!(flags & cu_PERSIST_CREATE));
+	if (cu_persist_open(f, path, cu_PERSIST_BITMAP, sizeof(cu_BITMAP_WORD), flags, &h))
+		return -1;
+
+	cu_bitmap_init_allocator(bm, &f->allocator, h.size);
+	if (f->map == MAP_FAILED) {
+		close(f->fd);
+		return -1;
+	}
+	return 0;
+}
+
+
+int cu_persist_sync_vector(struct cu_persist_file* f,
+                           struct cu_array_container* ac)
+{
+	assert(f);
+	assert(ac);
+	assert(f->flags & cu_PERSIST_WRITE);
+	((struct cu_persist_header*)f->map)->size = ac->size;
+	return cu_persist_sync(f);
+}
+
+
+int cu_persist_sync(struct cu_persist_file* f)
+{
+	assert(f);
+	assert(f->flags & cu_PERSIST_WRITE);
+	if (msync(f->map, f->length, MS_SYNC)) {
+		printf("warning cu_persist_sync, msync\n");
+		return -1;
+	}
+	return 0;
+}
+
+#endif /* cu_persist_h */
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_pool_h
+#define cu_pool_h 1
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cu_debug.h"
+#include "cu_memblock.h"
+#include "cu_array_container.h"
+#include "cu_bitmap.h"
+
+
+/*
+ * A pool of fixed size objects. Objects are carved from slabs, each slab
+ * a cu_memblock holding twice the objects of the previous one (up to
+ * cu_POOL_MAX_SLAB_OBJS), and handed out from an intrusive free list
+ * threaded through the unused objects. A cu_bitmap per slab tracks the
+ * live objects so that they can be iterated.
+ *
+ * Each slab starts with its cu_pool_slab and each object is preceded by a
+ * hidden word pointing to it, so alloc and free find the bitmap to update
+ * in O(1) at the cost of a pointer per object.
+ */
+
+/* default number of objects in the first slab */
+#define cu_POOL_DEFAULT_SLAB_OBJS (unsigned int)64
+
+/* slabs stop growing past this number of objects */
+#define cu_POOL_MAX_SLAB_OBJS (unsigned int)65536
+
+
+struct cu_pool_slab {
+	/* private */
+	struct cu_memblock mblock;	/* the slab itself, this struct included */
+	struct cu_bitmap used;	/* live objects */
+};
+
+
+struct cu_pool {
+	/* private */
+	struct cu_array_container slabs; /* cu_pool_slab*, sorted by address */
+	void* free_list;                 /* next free object, linked through its first word */
+	unsigned int obj_size;           /* in bytes */
+	unsigned int slab_objs;          /* objects in the next slab */
+	unsigned int live;               /* objects handed out */
+};
+
+
+/**
+ * Inits an empty cu_pool
+ * @p cu_pool to be used
+ * @obj_size size of the objects (in bytes)
+ * @slab_objs number of objects in the first slab, 0 selects
+ *   cu_POOL_DEFAULT_SLAB_OBJS
+ */
+inline void cu_pool_init(struct cu_pool* p,
+                         unsigned int obj_size,
+                         unsigned int slab_objs);
+
+/**
+ * Deinits a cu_pool, releasing all its objects at once
+ * @p cu_pool to be used
+ */
+inline void cu_pool_deinit(struct cu_pool* p);
+
+/**
+ * Releases all objects keeping the slabs for reuse
+ * @p cu_pool to be used
+ */
+inline void cu_pool_clear(struct cu_pool* p);
+
+/**
+ * Returns an object from the pool, its contents are undefined
+ * @p cu_pool to be used
+ *
+ * Takes O(1), plus the cost of a new slab when the free list is empty.
+ */
+inline void* cu_pool_alloc(struct cu_pool* p);
+
+/**
+ * Gives an object back to the pool
+ * @p cu_pool to be used
+ * @obj object returned by cu_pool_alloc
+ *
+ * Takes O(1).
+ */
+inline void cu_pool_free(struct cu_pool* p,
+                         void* obj);
+
+/**
+ * Returns the number of live objects
+ * @p cu_pool to be used
+ */
+inline unsigned int cu_pool_size(struct cu_pool* p);
+
+/**
+ * Calls a function for each live object, in address order
+ * @p cu_pool to be used
+ * @fn callback, receives the object and the user data
+ * @data user data passed to fn
+ *
+ * The callback may free the object it receives but must not allocate.
+ */
+inline void cu_pool_foreach(struct cu_pool* p,
+                            void (*fn)(void* obj, void* data),
+                            void* data);
+
+
+
+/* protected api */
+
+#define cu_POOL_SLAB(p, i) (((struct cu_pool_slab**)(p)->slabs.mblock.mem)[i])
+
+/* bytes taken by the cu_pool_slab at the start of a slab */
+#define cu_POOL_SLAB_HEADER ((sizeof(struct cu_pool_slab) + sizeof(void*) - 1) \
+                             & ~(sizeof(void*) - 1))
+
+/* distance between objects, each one preceded by a pointer to its slab */
+#define cu_POOL_STRIDE(p) ((size_t)(p)->obj_size + sizeof(void*))
+
+/* the i-th object of a slab */
+#define cu_POOL_OBJ(p, slab, i) ((void*)((char*)(slab) + cu_POOL_SLAB_HEADER \
+                                         + (size_t)(i)*cu_POOL_STRIDE(p) + sizeof(void*)))
+
+/* the slab holding an object */
+#define cu_POOL_OBJ_SLAB(obj) (((struct cu_pool_slab**)(obj))[-1])
+
+/* index of an object in its slab */
+#define cu_POOL_OBJ_INDEX(p, slab, obj) \
+	(unsigned int)(((char*)(obj) - (char*)cu_POOL_OBJ(p, slab, 0))/cu_POOL_STRIDE(p))
+
+/* adds a new slab and threads its objects on the free list */
+inline void cu_pool_grow(struct cu_pool* p);
+
+
+void cu_pool_grow(struct cu_pool* p)
+{
+	struct cu_memblock mb;
+	struct cu_pool_slab* slab;
+	unsigned int i;
+
+	if (p->slab_objs > (SIZE_MAX - cu_POOL_SLAB_HEADER)/cu_POOL_STRIDE(p)) {
+		printf("warning cu_pool_grow, slab size overflows\n");
+		assert(0);
+	}
+	cu_memblock_init(&mb, cu_POOL_SLAB_HEADER + (size_t)p->slab_objs*cu_POOL_STRIDE(p));
+	slab = (struct cu_pool_slab*)mb.mem;
+	slab->mblock = mb;
+	cu_bitmap_init(&slab->used, p->slab_objs);
+	cu_bitmap_clear(&slab->used);
+
+	/* keep the slabs sorted by address so that foreach walks the objects
+	 * in address order */
+	cu_array_container_check_size_and_grow(&p->slabs);
+	for (i = p->slabs.size; i > 0; i--)
+		if ((char*)cu_POOL_SLAB(p, i-1) < (char*)slab)
+			break;
+	memmove(&cu_POOL_SLAB(p, i+1), &cu_POOL_SLAB(p, i),
+	        (p->slabs.size - i)*sizeof(struct cu_pool_slab*));
+	cu_POOL_SLAB(p, i) = slab;
+	p->slabs.size++;
+
+	/* push backwards so that objects are handed out in address order */
+	for (i = p->slab_objs; i > 0; i--) {
+		void** obj = (void**)cu_POOL_OBJ(p, slab, i-1);
+		cu_POOL_OBJ_SLAB(obj) = slab;
+		*obj = p->free_list;
+		p->free_list = obj;
+	}
+
+	if (p->slab_objs < cu_POOL_MAX_SLAB_OBJS)
+		p->slab_objs *= 2;
+}
+
+
+
+void cu_pool_init(struct cu_pool* p,
+                  unsigned int obj_size,
+                  unsigned int slab_objs)
+{
+	assert(p);
+	assert(obj_size);
+
+	/* free objects hold the free list link, keep them pointer aligned */
+	if (obj_size < sizeof(void*))
+		obj_size = sizeof(void*);
+	obj_size = (obj_size + sizeof(void*) - 1) & ~(unsigned int)(sizeof(void*) - 1);
+
+	cu_array_container_init(&p->slabs, sizeof(struct cu_pool_slab*));
+	p->free_list = NULL;
+	p->obj_size = obj_size;
+	p->slab_objs = slab_objs ? slab_objs : cu_POOL_DEFAULT_SLAB_OBJS;
+	p->live = 0;
+}
+
+
+void cu_pool_deinit(struct cu_pool* p)
+{
+	assert(p);
+	for (unsigned int i=0; i< p->slabs.size; i++) {
+		/* the memblock lives in the slab it releases */
+		struct cu_memblock mb = cu_POOL_SLAB(p, i)->mblock;
+		cu_bitmap_deinit(&cu_POOL_SLAB(p, i)->used);
+		cu_memblock_deinit(&mb);
+	}
+	cu_array_container_deinit(&p->slabs);
+}
+
+
+void cu_pool_clear(struct cu_pool* p)
+{
+	assert(p);
+	p->free_list = NULL;
+	p->live = 0;
+
+	/* rethread every object, last slab first to keep the address order */
+	for (unsigned int i = p->slabs.size; i > 0; i--) {
+		struct cu_pool_slab* slab = cu_POOL_SLAB(p, i-1);
+		unsigned int n = cu_bitmap_size(&slab->used);
+
+		cu_bitmap_clear(&slab->used);
+		for (unsigned int j = n; j > 0; j--) {
+			void** obj = (void**)cu_POOL_OBJ(p, slab, j-1);
+			*obj = p->free_list;
+			p->free_list = obj;
+		}
+	}
+}
+
+
+void* cu_pool_alloc(struct cu_pool* p)
+{
+	assert(p);
+	void** obj;
+
+	if (!p->free_list)
+		cu_pool_grow(p);
+
+	obj = (void**)p->free_list;
+	p->free_list = *obj;
+
+	struct cu_pool_slab* slab = cu_POOL_OBJ_SLAB(obj);
+	cu_bitmap_set_bit(&slab->used, cu_POOL_OBJ_INDEX(p, slab, obj));
+	p->live++;
+	return obj;
+}
+
+
+void cu_pool_free(struct cu_pool* p,
+                  void* obj)
+{
+	assert(p);
+	assert(obj);
+	struct cu_pool_slab* slab = cu_POOL_OBJ_SLAB(obj);
+	unsigned int at = cu_POOL_OBJ_INDEX(p, slab, obj);
+
+	assert(cu_bitmap_get_bit(&slab->used, at));
+	cu_bitmap_clear_bit(&slab->used, at);
+	*(void**)obj = p->free_list;
+	p->free_list = obj;
+	p->live--;
+}
+
+
+unsigned int cu_pool_size(struct cu_pool* p)
+{
+	assert(p);
+	return p->live;
+}
+
+
+void cu_pool_foreach(struct cu_pool* p,
+                     void (*fn)(void* obj, void* data),
+                     void* data)
+{
+	assert(p);
+	assert(fn);
+	for (unsigned int i=0; i< p->slabs.size; i++) {
+		struct cu_pool_slab* slab = cu_POOL_SLAB(p, i);
+		unsigned int n = cu_bitmap_size(&slab->used);
+
+		for (unsigned int at = cu_bitmap_find_first_set(&slab->used); at < n;
+		     at = cu_bitmap_find_next_set(&slab->used, at+1))
+			fn(cu_POOL_OBJ(p, slab, at), data);
+	}
+}
+
+
+#endif /* cu_pool_h */
@@ -0,0 +1,499 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_ring_h
+#define cu_ring_h 1
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "cu_debug.h"
+#include "cu_memblock.h"
+#include "cu_array_container.h"
+
+
+/*
+ * Bounded lock free queues of pointers, needs C11 atomics.
+ *
+ * cu_ring_spsc is wait free and can be used by exactly one producer thread
+ * and one consumer thread. Head and tail are free running counters on
+ * separate cache lines; each side keeps a private copy of the other's
+ * counter and only reloads it when the queue looks full (or empty), so a
+ * busy queue moves items without bouncing cache lines on every call.
+ *
+ * cu_ring_mpmc can be used by any number of producers and consumers. Each
+ * cell carries a sequence number telling whether it is ready to be
+ * written or read in the current lap (D. Vyukov's bounded MPMC queue),
+ * so producers and consumers only contend on their own counter.
+ *
+ * Capacities are rounded up to a power of two. Batch functions move as
+ * many items as fit with a single update of the shared counter. Init and
+ * deinit are not thread safe.
+ */
+
+/* counters updated by different threads are kept this many bytes apart */
+#define cu_RING_CACHE_LINE 64
+
+
+struct cu_ring_spsc {
+	/* private */
+	struct cu_memblock mblock;	/* capacity void* */
+	size_t mask;			/* capacity - 1 */
+	char pad0[cu_RING_CACHE_LINE];
+	_Atomic size_t tail;		/* producer: next slot to write */
+	size_t head_cache;		/* producer: last head seen */
+	char pad1[cu_RING_CACHE_LINE];
+	_Atomic size_t head;		/* consumer: next slot to read */
+	size_t tail_cache;		/* consumer: last tail seen */
+	char pad2[cu_RING_CACHE_LINE];
+};
+
+
+struct cu_ring_mpmc_cell {
+	_Atomic size_t seq;	/* pos: free for the push at pos,
+				   pos + 1: full for the pop at pos */
+	void* item;
+};
+
+
+struct cu_ring_mpmc {
+	/* private */
+	struct cu_memblock mblock;	/* capacity cu_ring_mpmc_cell */
+	size_t mask;			/* capacity - 1 */
+	char pad0[cu_RING_CACHE_LINE];
+	_Atomic size_t tail;		/* next push position */
+	char pad1[cu_RING_CACHE_LINE];
+	_Atomic size_t head;		/* next pop position */
+	char pad2[cu_RING_CACHE_LINE];
+};
+
+
+/**
+ * Inits an empty cu_ring_spsc
+ * @r cu_ring_spsc to be used
+ * @capacity number of items it can hold, rounded up to a power of two
+ */
+inline void cu_ring_spsc_init(struct cu_ring_spsc* r,
+                              size_t capacity);
+
+/**
+ * Deinits a cu_ring_spsc, the items left are dropped
+ * @r cu_ring_spsc to be used
+ */
+inline void cu_ring_spsc_deinit(struct cu_ring_spsc* r);
+
+/**
+ * Returns the number of items the queue can hold
+ * @r cu_ring_spsc to be used
+ */
+inline size_t cu_ring_spsc_capacity(struct cu_ring_spsc* r);
+
+/**
+ * Returns the number of items in the queue, only a hint while other
+ * threads use it
+ * @r cu_ring_spsc to be used
+ */
+inline size_t cu_ring_spsc_size(struct cu_ring_spsc* r);
+
+/**
+ * Pushes an item, producer thread only
+ * @r cu_ring_spsc to be used
+ * @item item to push
+ *
+ * Returns 0 when the queue is full.
+ */
+inline unsigned int cu_ring_spsc_push(struct cu_ring_spsc* r,
+                                      void* item);
+
+/**
+ * Pops an item, consumer thread only
+ * @r cu_ring_spsc to be used
+ * @item set to the item popped
+ *
+ * Returns 0 when the queue is empty.
+ */
+inline unsigned int cu_ring_spsc_pop(struct cu_ring_spsc* r,
+                                     void** item);
+
+/**
+ * Pushes up to n items, producer thread only
+ * @r cu_ring_spsc to be used
+ * @items items to push, in order
+ * @n number of items
+ *
+ * Returns the number of items pushed, less than n when the queue fills.
+ */
+inline size_t cu_ring_spsc_push_batch(struct cu_ring_spsc* r,
+                                      void* const* items,
+                                      size_t n);
+
+/**
+ * Pops up to n items, consumer thread only
+ * @r cu_ring_spsc to be used
+ * @items room for n items
+ * @n number of items
+ *
+ * Returns the number of items popped, less than n when the queue empties.
+ */
+inline size_t cu_ring_spsc_pop_batch(struct cu_ring_spsc* r,
+                                     void** items,
+                                     size_t n);
+
+
+/**
+ * Inits an empty cu_ring_mpmc
+ * @r cu_ring_mpmc to be used
+ * @capacity number of items it can hold, rounded up to a power of two
+ */
+inline void cu_ring_mpmc_init(struct cu_ring_mpmc* r,
+                              size_t capacity);
+
+/**
+ * Deinits a cu_ring_mpmc, the items left are dropped
+ * @r cu_ring_mpmc to be used
+ */
+inline void cu_ring_mpmc_deinit(struct cu_ring_mpmc* r);
+
+/**
+ * Returns the number of items the queue can hold
+ * @r cu_ring_mpmc to be used
+ */
+inline size_t cu_ring_mpmc_capacity(struct cu_ring_mpmc* r);
+
+/**
+ * Returns the number of items in the queue, only a hint while other
+ * threads use it
+ * @r cu_ring_mpmc to be used
+ */
+inline size_t cu_ring_mpmc_size(struct cu_ring_mpmc* r);
+
+/**
+ * Pushes an item, lock free
+ * @r cu_ring_mpmc to be used
+ * @item item to push
+ *
+ * Returns 0 when the queue is full.
+ */
+inline unsigned int cu_ring_mpmc_push(struct cu_ring_mpmc* r,
+                                      void* item);
+
+/**
+ * Pops an item, lock free
+ * @r cu_ring_mpmc to be used
+ * @item set to the item popped
+ *
+ * Returns 0 when the queue is empty.
+ */
+inline unsigned int cu_ring_mpmc_pop(struct cu_ring_mpmc* r,
+                                     void** item);
+
+/**
+ * Pushes up to n items into consecutive positions, lock free
+ * @r cu_ring_mpmc to be used
+ * @items items to push, in order
+ * @n number of items
+ *
+ * Returns the number of items pushed, 0 only when the queue is full.
+ */
+inline size_t cu_ring_mpmc_push_batch(struct cu_ring_mpmc* r,
+                                      void* const* items,
+                                      size_t n);
+
+/**
+ * Pops up to n items from consecutive positions, lock free
+ * @r cu_ring_mpmc to be used
+ * @items room for n items
+ * @n number of items
+ *
+ * Returns the number of items popped, 0 only when the queue is empty.
+ */
+inline size_t cu_ring_mpmc_pop_batch(struct cu_ring_mpmc* r,
+                                     void** items,
+                                     size_t n);
+
+
+
+void cu_ring_spsc_init(struct cu_ring_spsc* r,
+                       size_t capacity)
+{
+	assert(r);
+	assert(capacity && capacity <= SIZE_MAX/2/sizeof(void*));
+	capacity = cu_array_container_round_pow2(capacity < 2 ? 2 : capacity);
+
+	cu_memblock_init(&r->mblock, capacity*sizeof(void*));
+	r->mask = capacity - 1;
+	atomic_init(&r->tail, 0);
+	atomic_init(&r->head, 0);
+	r->head_cache = 0;
+	r->tail_cache = 0;
+}
+
+
+void cu_ring_spsc_deinit(struct cu_ring_spsc* r)
+{
+	assert(r);
+	cu_memblock_deinit(&r->mblock);
+}
+
+
+size_t cu_ring_spsc_capacity(struct cu_ring_spsc* r)
+{
+	assert(r);
+	return r->mask + 1;
+}
+
+
+size_t cu_ring_spsc_size(struct cu_ring_spsc* r)
+{
+	assert(r);
+	size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+	size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+	return tail - head <= r->mask + 1 ? tail - head : 0;
+}
+
+
+unsigned int cu_ring_spsc_push(struct cu_ring_spsc* r,
+                               void* item)
+{
+	return cu_ring_spsc_push_batch(r, &item, 1) == 1;
+}
+
+
+unsigned int cu_ring_spsc_pop(struct cu_ring_spsc* r,
+                              void** item)
+{
+	return cu_ring_spsc_pop_batch(r, item, 1) == 1;
+}
+
+
+size_t cu_ring_spsc_push_batch(struct cu_ring_spsc* r,
+                               void* const* items,
+                               size_t n)
+{
+	assert(r);
+	assert(items || !n);
+	void** slots = (void**)r->mblock.mem;
+	size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+	size_t room = r->mask + 1 - (tail - r->head_cache);
+
+	/* the consumer's counter is only read when the cached one says
+	 * there is no room */
+	if (room < n) {
+		r->head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+		room = r->mask + 1 - (tail - r->head_cache);
+	}
+	if (n > room)
+		n = room;
+	if (!n)
+		return 0;
+
+	size_t at = tail & r->mask;
+	size_t first = n < r->mask + 1 - at ? n : r->mask + 1 - at;
+	memcpy(slots + at, items, first*sizeof(void*));
+	memcpy(slots, items + first, (n - first)*sizeof(void*));
+	atomic_store_explicit(&r->tail, tail + n, memory_order_release);
+	return n;
+}
+
+
+size_t cu_ring_spsc_pop_batch(struct cu_ring_spsc* r,
+                              void** items,
+                              size_t n)
+{
+	assert(r);
+	assert(items || !n);
+	void** slots = (void**)r->mblock.mem;
+	size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+	size_t ready = r->tail_cache - head;
+
+	if (ready < n) {
+		r->tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire);
+		ready = r->tail_cache - head;
+	}
+	if (n > ready)
+		n = ready;
+	if (!n)
+		return 0;
+
+	size_t at = head & r->mask;
+	size_t first = n < r->mask + 1 - at ? n : r->mask + 1 - at;
+	memcpy(items, slots + at, first*sizeof(void*));
+	memcpy(items + first, slots, (n - first)*sizeof(void*));
+	atomic_store_explicit(&r->head, head + n, memory_order_release);
+	return n;
+}
+
+
+void cu_ring_mpmc_init(struct cu_ring_mpmc* r,
+                       size_t capacity)
+{
+	assert(r);
+	assert(capacity && capacity <= SIZE_MAX/2/sizeof(struct cu_ring_mpmc_cell));
+	capacity = cu_array_container_round_pow2(capacity < 2 ? 2 : capacity);
+
+	cu_memblock_init(&r->mblock, capacity*sizeof(struct cu_ring_mpmc_cell));
+	struct cu_ring_mpmc_cell* cells = (struct cu_ring_mpmc_cell*)r->mblock.mem;
+	for (size_t i=0; i< capacity; i++) {
+		atomic_init(&cells[i].seq, i);
+		cells[i].item = NULL;
+	}
+	r->mask = capacity - 1;
+	atomic_init(&r->tail, 0);
+	atomic_init(&r->head, 0);
+}
+
+
+void cu_ring_mpmc_deinit(struct cu_ring_mpmc* r)
+{
+	assert(r);
+	cu_memblock_deinit(&r->mblock);
+}
+
+
+size_t cu_ring_mpmc_capacity(struct cu_ring_mpmc* r)
+{
+	assert(r);
+	return r->mask + 1;
+}
+
+
+size_t cu_ring_mpmc_size(struct cu_ring_mpmc* r)
+{
+	assert(r);
+	size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+	size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+	return tail - head <= r->mask + 1 ? tail - head : 0;
+}
+
+
+unsigned int cu_ring_mpmc_push(struct cu_ring_mpmc* r,
+                               void* item)
+{
+	return cu_ring_mpmc_push_batch(r, &item, 1) == 1;
+}
+
+
+unsigned int cu_ring_mpmc_pop(struct cu_ring_mpmc* r,
+                              void** item)
+{
+	return cu_ring_mpmc_pop_batch(r, item, 1) == 1;
+}
+
+
+size_t cu_ring_mpmc_push_batch(struct cu_ring_mpmc* r,
+                               void* const* items,
+                               size_t n)
+{
+	assert(r);
+	assert(items || !n);
+	struct cu_ring_mpmc_cell* cells = (struct cu_ring_mpmc_cell*)r->mblock.mem;
+	size_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+	size_t k;
+
+	if (!n)
+		return 0;
+	if (n > r->mask + 1)
+		n = r->mask + 1;
+	for (;;) {
+		/* count the free cells from pos on; they stay free until
+		 * somebody moves tail past them, so claiming them all takes
+		 * a single compare and swap */
+		for (k=0; k< n; k++) {
+			size_t seq = atomic_load_explicit(&cells[(pos + k) & r->mask].seq,
+			                                  memory_order_acquire);
+			if (seq != pos + k)
+				break;
+		}
+		if (k) {
+			if (atomic_compare_exchange_weak_explicit(&r->tail, &pos, pos + k,
+			                                          memory_order_relaxed,
+			                                          memory_order_relaxed))
+				break;
+		} else {
+			size_t seq = atomic_load_explicit(&cells[pos & r->mask].seq,
+			                                  memory_order_acquire);
+			/* the cell still holds the item of the previous lap */
+			if ((intptr_t)(seq - pos) < 0)
+				return 0;
+			pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+		}
+	}
+
+	for (size_t i=0; i< k; i++) {
+		struct cu_ring_mpmc_cell* c = &cells[(pos + i) & r->mask];
+		c->item = items[i];
+		atomic_store_explicit(&c->seq, pos + i + 1, memory_order_release);
+	}
+	return k;
+}
+
+
+size_t cu_ring_mpmc_pop_batch(struct cu_ring_mpmc* r,
+                              void** items,
+                              size_t n)
+{
+	assert(r);
+	assert(items || !n);
+	struct cu_ring_mpmc_cell* cells = (struct cu_ring_mpmc_cell*)r->mblock.mem;
+	size_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+	size_t k;
+
+	if (!n)
+		return 0;
+	if (n > r->mask + 1)
+		n = r->mask + 1;
+	for (;;) {
+		for (k=0; k< n; k++) {
+			size_t seq = atomic_load_explicit(&cells[(pos + k) & r->mask].seq,
+			                                  memory_order_acquire);
+			if (seq != pos + k + 1)
+				break;
+		}
+		if (k) {
+			if (atomic_compare_exchange_weak_explicit(&r->head, &pos, pos + k,
+			                                          memory_order_relaxed,
+			                                          memory_order_relaxed))
+				break;
+		} else {
+			size_t seq = atomic_load_explicit(&cells[pos & r->mask].seq,
+			                                  memory_order_acquire);
+			/* no producer filled the cell yet */
+			if ((intptr_t)(seq - (pos + 1)) < 0)
+				return 0;
+			pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+		}
+	}
+
+	for (size_t i=0; i< k; i++) {
+		struct cu_ring_mpmc_cell* c = &cells[(pos + i) & r->mask];
+		items[i] = c->item;
+		/* free the cell for the push one lap later */
+		atomic_store_explicit(&c->seq, pos + i + r->mask + 1, memory_order_release);
+	}
+	return k;
+}
+
+
+#endif /* cu_ring_h */
@@ -0,0 +1,806 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_roaring_h
+#define cu_roaring_h 1
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cu_debug.h"
+#include "cu_memblock.h"
+#include "cu_array_container.h"
+#include "cu_bitmap.h"
+
+
+/*
+ * A compressed bitmap over the 32 bit unsigned int space. The space is
+ * split in chunks of 64K values keyed by the upper 16 bits; each chunk
+ * stores the lower 16 bits of its values either as a sorted array, as a
+ * plain 64K bit bitmap or as a list of runs, whichever fits the content.
+ */
+
+#define cu_ROARING_CHUNK_BITS (unsigned int)65536
+#define cu_ROARING_CHUNK_WORDS (cu_ROARING_CHUNK_BITS/cu_BITMAP_WORD_BITS)
+
+/* array chunks holding more values than this are turned into bitmaps */
+#define cu_ROARING_ARRAY_MAX (unsigned int)4096
+
+/* chunk types */
+#define cu_ROARING_ARRAY  0	/* sorted unsigned shorts */
+#define cu_ROARING_BITMAP 1	/* cu_ROARING_CHUNK_WORDS bitmap words */
+#define cu_ROARING_RUN    2	/* sorted (start, length-1) unsigned short pairs */
+
+
+struct cu_roaring_chunk {
+	/* private */
+	struct cu_memblock data;
+	unsigned int card;	/* number of values in the chunk */
+	unsigned int runs;	/* number of runs, for run chunks only */
+	unsigned short key;	/* upper 16 bits of the values */
+	unsigned char type;
+};
+
+
+struct cu_roaring {
+	/* private */
+	struct cu_array_container chunks; /* cu_roaring_chunk, sorted by key */
+};
+
+
+/**
+ * Inits an empty cu_roaring
+ * @r cu_roaring to be used
+ */
+inline void cu_roaring_init(struct cu_roaring* r);
+
+/**
+ * Deinits a cu_roaring
+ * @r cu_roaring to be used
+ */
+inline void cu_roaring_deinit(struct cu_roaring* r);
+
+/**
+ * Removes all values
+ * @r cu_roaring to be used
+ */
+inline void cu_roaring_clear(struct cu_roaring* r);
+
+/**
+ * Sets a bit
+ * @r cu_roaring to be used
+ * @at bit's index
+ */
+inline void cu_roaring_set_bit(struct cu_roaring* r,
+                               unsigned int at);
+
+/**
+ * Clears a bit
+ * @r cu_roaring to be used
+ * @at bit's index
+ */
+inline void cu_roaring_clear_bit(struct cu_roaring* r,
+                                 unsigned int at);
+
+/**
+ * Returns the state of a bit, 0 for a cleared bit and 1 for a set bit
+ * @r cu_roaring to be used
+ * @at bit's index
+ */
+inline unsigned int cu_roaring_get_bit(struct cu_roaring* r,
+                                       unsigned int at);
+
+/**
+ * Returns the number of set bits
+ * @r cu_roaring to be used
+ */
+inline unsigned long cu_roaring_cardinality(struct cu_roaring* r);
+
+/**
+ * Returns the number of bytes allocated by a cu_roaring
+ * @r cu_roaring to be used
+ */
+inline unsigned long cu_roaring_memory_usage(struct cu_roaring* r);
+
+/**
+ * Union of two compressed bitmaps, dest = a | b
+ * @dest destination, must be inited
+ * @a first operand
+ * @b second operand
+ *
+ * dest may be one of the operands.
+ */
+inline void cu_roaring_or(struct cu_roaring* dest,
+                          struct cu_roaring* a,
+                          struct cu_roaring* b);
+
+/**
+ * Intersection of two compressed bitmaps, dest = a & b
+ * @dest destination, must be inited
+ * @a first operand
+ * @b second operand
+ *
+ * dest may be one of the operands.
+ */
+inline void cu_roaring_and(struct cu_roaring* dest,
+                           struct cu_roaring* a,
+                           struct cu_roaring* b);
+
+/**
+ * Re-encodes every chunk with its smallest representation
+ * @r cu_roaring to be used
+ *
+ * Single bit updates never produce run chunks (a run chunk is turned into
+ * an array or a bitmap on its first update); call this once the content
+ * settles to get clustered values stored as runs.
+ */
+inline void cu_roaring_optimize(struct cu_roaring* r);
+
+/**
+ * Loads the set bits of a cu_bitmap
+ * @r cu_roaring to be used, previous contents are dropped
+ * @bm source bitmap
+ *
+ * Returns 0 on success, -1 when bm holds more than 2^32 bits, the most
+ * chunk keys can address (r is left empty).
+ */
+inline int cu_roaring_from_bitmap(struct cu_roaring* r,
+                                  struct cu_bitmap* bm);
+
+/**
+ * Stores the set bits in a cu_bitmap
+ * @r cu_roaring to be used
+ * @bm destination bitmap, must be big enough to hold the highest set bit
+ */
+inline void cu_roaring_to_bitmap(struct cu_roaring* r,
+                                 struct cu_bitmap* bm);
+
+
+
+/* protected api */
+
+#define cu_ROARING_CHUNK(r, i) (((struct cu_roaring_chunk*)(r)->chunks.mblock.mem) + (i))
+
+
+/* wraps a chunk sized words buffer into a cu_bitmap to reuse its word ops */
+inline void cu_roaring_words_view(struct cu_bitmap* view,
+                                  cu_BITMAP_WORD* words);
+
+/* lower bound of key among the chunks */
+inline unsigned int cu_roaring_find(struct cu_roaring* r,
+                                    unsigned short key);
+
+/* lower bound of v in a sorted array of unsigned shorts */
+inline unsigned int cu_roaring_array_find(const unsigned short* a,
+                                          unsigned int n,
+                                          unsigned short v);
+
+/* inserts an empty array chunk at position i */
+inline struct cu_roaring_chunk* cu_roaring_insert(struct cu_roaring* r,
+                                                  unsigned int i,
+                                                  unsigned short key);
+
+/* removes the chunk at position i */
+inline void cu_roaring_remove(struct cu_roaring* r,
+                              unsigned int i);
+
+/* expands a chunk in a zeroed bitmap words buffer */
+inline void cu_roaring_to_words(struct cu_roaring_chunk* c,
+                                cu_BITMAP_WORD* words);
+
+/*
+ * re-encodes a chunk from a bitmap words buffer holding at least one set
+ * bit, picking the smallest of the array, bitmap and (if allowed) run
+ * representations
+ */
+inline void cu_roaring_from_words(struct cu_roaring_chunk* c,
+                                  cu_BITMAP_WORD* words,
+                                  unsigned int allow_runs);
+
+/* turns a run chunk into an array or a bitmap before updating it */
+inline void cu_roaring_unrun(struct cu_roaring_chunk* c);
+
+/* appends a copy of a chunk, used by the set operations */
+inline void cu_roaring_append_copy(struct cu_roaring* r,
+                                   struct cu_roaring_chunk* src);
+
+/* replaces dest with a freshly built result, dest may be an operand */
+inline void cu_roaring_move(struct cu_roaring* dest,
+                            struct cu_roaring* tmp);
+
+
+void cu_roaring_words_view(struct cu_bitmap* view,
+                           cu_BITMAP_WORD* words)
+{
+	view->mblock.mem = words;
+	view->mblock.size = cu_ROARING_CHUNK_WORDS*sizeof(cu_BITMAP_WORD);
+	view->size = cu_ROARING_CHUNK_BITS;
+}
+
+
+unsigned int cu_roaring_find(struct cu_roaring* r,
+                             unsigned short key)
+{
+	unsigned int lo = 0, hi = r->chunks.size;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo)/2;
+		if (cu_ROARING_CHUNK(r, mid)->key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+
+unsigned int cu_roaring_array_find(const unsigned short* a,
+                                   unsigned int n,
+                                   unsigned short v)
+{
+	unsigned int lo = 0, hi = n;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo)/2;
+		if (a[mid] < v)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+
+struct cu_roaring_chunk* cu_roaring_insert(struct cu_roaring* r,
+                                           unsigned int i,
+                                           unsigned short key)
+{
+	struct cu_roaring_chunk* c;
+
+	cu_array_container_check_size_and_grow(&r->chunks);
+	c = cu_ROARING_CHUNK(r, i);
+	memmove(c + 1, c, (r->chunks.size - i)*sizeof(struct cu_roaring_chunk));
+	r->chunks.size++;
+
+	cu_memblock_init(&c->data, 4*sizeof(unsigned short));
+	c->card = 0;
+	c->runs = 0;
+	c->key = key;
+	c->type = cu_ROARING_ARRAY;
+	return c;
+}
+
+
+void cu_roaring_remove(struct cu_roaring* r,
+                       unsigned int i)
+{
+	struct cu_roaring_chunk* c = cu_ROARING_CHUNK(r, i);
+
+	cu_memblock_deinit(&c->data);
+	r->chunks.size--;
+	memmove(c, c + 1, (r->chunks.size - i)*sizeof(struct cu_roaring_chunk));
+}
+
+
+void cu_roaring_to_words(struct cu_roaring_chunk* c,
+                         cu_BITMAP_WORD* words)
+{
+	struct cu_bitmap view;
+	const unsigned short* a = (const unsigned short*)c->data.mem;
+
+	cu_roaring_words_view(&view, words);
+	switch (c->type) {
+	case cu_ROARING_ARRAY:
+		cu_bitmap_clear(&view);
+		for (unsigned int i=0; i< c->card; i++)
+			words[a[i]/cu_BITMAP_WORD_BITS] |= (cu_BITMAP_WORD)0x1 << (a[i]%cu_BITMAP_WORD_BITS);
+		break;
+	case cu_ROARING_BITMAP:
+		memcpy(words, c->data.mem, cu_ROARING_CHUNK_WORDS*sizeof(cu_BITMAP_WORD));
+		break;
+	case cu_ROARING_RUN:
+		cu_bitmap_clear(&view);
+		for (unsigned int i=0; i< c->runs; i++)
+			cu_bitmap_set_range(&view, a[2*i], (unsigned int)a[2*i+1] + 1);
+		break;
+	}
+}
+
+
+void cu_roaring_from_words(struct cu_roaring_chunk* c,
+                           cu_BITMAP_WORD* words,
+                           unsigned int allow_runs)
+{
+	struct cu_bitmap view;
+	unsigned int card = 0, runs = 0;
+	cu_BITMAP_WORD carry = 0;
+	unsigned long bytes;
+
+	for (unsigned int i=0; i< cu_ROARING_CHUNK_WORDS; i++) {
+		card += __builtin_popcountl(words[i]);
+		/* a run starts at every set bit whose predecessor is cleared */
+		runs += __builtin_popcountl(words[i] & ~((words[i] << 1) | carry));
+		carry = words[i] >> (cu_BITMAP_WORD_BITS - 1);
+	}
+	assert(card);
+
+	c->card = card;
+	c->runs = 0;
+	c->type = cu_ROARING_BITMAP;
+	bytes = cu_ROARING_CHUNK_WORDS*sizeof(cu_BITMAP_WORD);
+	if (card <= cu_ROARING_ARRAY_MAX && card*sizeof(unsigned short) < bytes) {
+		c->type = cu_ROARING_ARRAY;
+		bytes = card*sizeof(unsigned short);
+	}
+	if (allow_runs && runs*2*sizeof(unsigned short) < bytes) {
+		c->type = cu_ROARING_RUN;
+		c->runs = runs;
+		bytes = runs*2*sizeof(unsigned short);
+	}
+
+	cu_memblock_set_size(&c->data, bytes);
+	cu_roaring_words_view(&view, words);
+	if (c->type == cu_ROARING_BITMAP) {
+		memcpy(c->data.mem, words, bytes);
+	} else if (c->type == cu_ROARING_ARRAY) {
+		unsigned short* a = (unsigned short*)c->data.mem;
+		unsigned int n = 0;
+		for (unsigned int i=0; i< cu_ROARING_CHUNK_WORDS; i++) {
+			cu_BITMAP_WORD w = words[i];
+			while (w) {
+				a[n++] = (unsigned short)(i*cu_BITMAP_WORD_BITS + __builtin_ctzl(w));
+				w &= w - 1;
+			}
+		}
+	} else {
+		unsigned short* a = (unsigned short*)c->data.mem;
+		unsigned int start = cu_bitmap_find_first_set(&view);
+		for (unsigned int i=0; i< runs; i++) {
+			unsigned int end = cu_bitmap_find_next_zero(&view, start);
+			a[2*i] = (unsigned short)start;
+			a[2*i+1] = (unsigned short)(end - start - 1);
+			start = cu_bitmap_find_next_set(&view, end);
+		}
+	}
+}
+
+
+void cu_roaring_unrun(struct cu_roaring_chunk* c)
+{
+	cu_BITMAP_WORD words[cu_ROARING_CHUNK_WORDS];
+
+	cu_roaring_to_words(c, words);
+	cu_roaring_from_words(c, words, 0);
+}
+
+
+void cu_roaring_append_copy(struct cu_roaring* r,
+                            struct cu_roaring_chunk* src)
+{
+	struct cu_roaring_chunk* c = cu_roaring_insert(r, r->chunks.size, src->key);
+
+	cu_memblock_clone(&c->data, &src->data);
+	c->card = src->card;
+	c->runs = src->runs;
+	c->type = src->type;
+}
+
+
+void cu_roaring_move(struct cu_roaring* dest,
+                     struct cu_roaring* tmp)
+{
+	cu_roaring_deinit(dest);
+	*dest = *tmp;
+}
+
+
+
+void cu_roaring_init(struct cu_roaring* r)
+{
+	assert(r);
+	cu_array_container_init(&r->chunks, sizeof(struct cu_roaring_chunk));
+}
+
+
+void cu_roaring_deinit(struct cu_roaring* r)
+{
+	assert(r);
+	for (unsigned int i=0; i< r->chunks.size; i++)
+		cu_memblock_deinit(&cu_ROARING_CHUNK(r, i)->data);
+	cu_array_container_deinit(&r->chunks);
+}
+
+
+void cu_roaring_clear(struct cu_roaring* r)
+{
+	assert(r);
+	for (unsigned int i=0; i< r->chunks.size; i++)
+		cu_memblock_deinit(&cu_ROARING_CHUNK(r, i)->data);
+	cu_array_container_clear(&r->chunks, sizeof(struct cu_roaring_chunk));
+}
+
+
+void cu_roaring_set_bit(struct cu_roaring* r,
+                        unsigned int at)
+{
+	assert(r);
+	unsigned short key = (unsigned short)(at >> 16);
+	unsigned short low = (unsigned short)(at & 0xFFFF);
+	unsigned int i = cu_roaring_find(r, key);
+	struct cu_roaring_chunk* c;
+
+	if (i == r->chunks.size || cu_ROARING_CHUNK(r, i)->key != key)
+		c = cu_roaring_insert(r, i, key);
+	else
+		c = cu_ROARING_CHUNK(r, i);
+
+	if (c->type == cu_ROARING_RUN)
+		cu_roaring_unrun(c);
+
+	if (c->type == cu_ROARING_ARRAY) {
+		unsigned short* a = (unsigned short*)c->data.mem;
+		unsigned int pos = cu_roaring_array_find(a, c->card, low);
+
+		if (pos < c->card && a[pos] == low)
+			return;
+
+		if (c->card == cu_ROARING_ARRAY_MAX) {
+			/* full array, switch to a bitmap */
+			cu_BITMAP_WORD words[cu_ROARING_CHUNK_WORDS];
+			cu_roaring_to_words(c, words);
+			words[low/cu_BITMAP_WORD_BITS] |= (cu_BITMAP_WORD)0x1 << (low%cu_BITMAP_WORD_BITS);
+			cu_roaring_from_words(c, words, 0);
+			return;
+		}
+
+		if ((c->card + 1)*sizeof(unsigned short) > c->data.size) {
+			cu_memblock_set_size(&c->data, c->data.size*2);
+			a = (unsigned short*)c->data.mem;
+		}
+		memmove(a + pos + 1, a + pos, (c->card - pos)*sizeof(unsigned short));
+		a[pos] = low;
+		c->card++;
+	} else {
+		cu_BITMAP_WORD* w = (cu_BITMAP_WORD*)c->data.mem + low/cu_BITMAP_WORD_BITS;
+		cu_BITMAP_WORD bit = (cu_BITMAP_WORD)0x1 << (low%cu_BITMAP_WORD_BITS);
+
+		if (!(*w & bit)) {
+			*w |= bit;
+			c->card++;
+		}
+	}
+}
+
+
+void cu_roaring_clear_bit(struct cu_roaring* r,
+                          unsigned int at)
+{
+	assert(r);
+	unsigned short key = (unsigned short)(at >> 16);
+	unsigned short low = (unsigned short)(at & 0xFFFF);
+	unsigned int i = cu_roaring_find(r, key);
+	struct cu_roaring_chunk* c;
+
+	if (i == r->chunks.size || cu_ROARING_CHUNK(r, i)->key != key)
+		return;
+	c = cu_ROARING_CHUNK(r, i);
+
+	if (c->type == cu_ROARING_RUN)
+		cu_roaring_unrun(c);
+
+	if (c->type == cu_ROARING_ARRAY) {
+		unsigned short* a = (unsigned short*)c->data.mem;
+		unsigned int pos = cu_roaring_array_find(a, c->card, low);
+
+		if (pos == c->card || a[pos] != low)
+			return;
+		memmove(a + pos, a + pos + 1, (c->card - pos - 1)*sizeof(unsigned short));
+		c->card--;
+	} else {
+		cu_BITMAP_WORD* w = (cu_BITMAP_WORD*)c->data.mem + low/cu_BITMAP_WORD_BITS;
+		cu_BITMAP_WORD bit = (cu_BITMAP_WORD)0x1 << (low%cu_BITMAP_WORD_BITS);
+
+		if (!(*w & bit))
+			return;
+		*w &= ~bit;
+		c->card--;
+
+		/* back to an array once it is small enough */
+		if (c->card && c->card <= cu_ROARING_ARRAY_MAX) {
+			cu_BITMAP_WORD words[cu_ROARING_CHUNK_WORDS];
+			cu_roaring_to_words(c, words);
+			cu_roaring_from_words(c, words, 0);
+		}
+	}
+
+	if (!c->card)
+		cu_roaring_remove(r, i);
+}
+
+
+unsigned int cu_roaring_get_bit(struct cu_roaring* r,
+                                unsigned int at)
+{
+	assert(r);
+	unsigned short key = (unsigned short)(at >> 16);
+	unsigned short low = (unsigned short)(at & 0xFFFF);
+	unsigned int i = cu_roaring_find(r, key);
+	struct cu_roaring_chunk* c;
+
+	if (i == r->chunks.size || cu_ROARING_CHUNK(r, i)->key != key)
+		return 0;
+	c = cu_ROARING_CHUNK(r, i);
+
+	if (c->type == cu_ROARING_ARRAY) {
+		const unsigned short* a = (const unsigned short*)c->data.mem;
+		unsigned int pos = cu_roaring_array_find(a, c->card, low);
+		return pos < c->card && a[pos] == low;
+	} else if (c->type == cu_ROARING_BITMAP) {
+		const cu_BITMAP_WORD* w = (const cu_BITMAP_WORD*)c->data.mem;
+		return (w[low/cu_BITMAP_WORD_BITS] >> (low%cu_BITMAP_WORD_BITS)) & 0x1;
+	} else {
+		/* last run starting at or before low */
+		const unsigned short* a = (const unsigned short*)c->data.mem;
+		unsigned int lo = 0, hi = c->runs;
+		while (lo < hi) {
+			unsigned int mid = lo + (hi - lo)/2;
+			if (a[2*mid] <= low)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo && (unsigned int)low - a[2*(lo-1)] <= a[2*(lo-1)+1];
+	}
+}
+
+
+unsigned long cu_roaring_cardinality(struct cu_roaring* r)
+{
+	assert(r);
+	unsigned long card = 0;
+	for (unsigned int i=0; i< r->chunks.size; i++)
+		card += cu_ROARING_CHUNK(r, i)->card;
+	return card;
+}
+
+
+unsigned long cu_roaring_memory_usage(struct cu_roaring* r)
+{
+	assert(r);
+	unsigned long bytes = r->chunks.mblock.size;
+	for (unsigned int i=0; i< r->chunks.size; i++)
+		bytes += cu_ROARING_CHUNK(r, i)->data.size;
+	return bytes;
+}
+
+
+void cu_roaring_or(struct cu_roaring* dest,
+                   struct cu_roaring* a,
+                   struct cu_roaring* b)
+{
+	assert(dest);
+	assert(a);
+	assert(b);
+	struct cu_roaring tmp;
+	unsigned int i = 0, j = 0;
+
+	cu_roaring_init(&tmp);
+	while (i < a->chunks.size || j < b->chunks.size) {
+		struct cu_roaring_chunk* ca = i < a->chunks.size ? cu_ROARING_CHUNK(a, i) : NULL;
+		struct cu_roaring_chunk* cb = j < b->chunks.size ? cu_ROARING_CHUNK(b, j) : NULL;
+
+		if (!cb || (ca && ca->key < cb->key)) {
+			cu_roaring_append_copy(&tmp, ca);
+			i++;
+		} else if (!ca || cb->key < ca->key) {
+			cu_roaring_append_copy(&tmp, cb);
+			j++;
+		} else if (ca->type == cu_ROARING_ARRAY && cb->type == cu_ROARING_ARRAY
+		           && ca->card + cb->card <= cu_ROARING_ARRAY_MAX) {
+			/* merge two small sorted arrays */
+			struct cu_roaring_chunk* c = cu_roaring_insert(&tmp, tmp.chunks.size, ca->key);
+			const unsigned short* x = (const unsigned short*)ca->data.mem;
+			const unsigned short* y = (const unsigned short*)cb->data.mem;
+			unsigned short* out;
+			unsigned int p = 0, q = 0, n = 0;
+
+			cu_memblock_set_size(&c->data, (ca->card + cb->card)*sizeof(unsigned short));
+			out = (unsigned short*)c->data.mem;
+			while (p < ca->card && q < cb->card) {
+				if (x[p] < y[q])
+					out[n++] = x[p++];
+				else if (y[q] < x[p])
+					out[n++] = y[q++];
+				else {
+					out[n++] = x[p++];
+					q++;
+				}
+			}
+			while (p < ca->card)
+				out[n++] = x[p++];
+			while (q < cb->card)
+				out[n++] = y[q++];
+			c->card = n;
+			i++;
+			j++;
+		} else {
+			cu_BITMAP_WORD wa[cu_ROARING_CHUNK_WORDS], wb[cu_ROARING_CHUNK_WORDS];
+			struct cu_bitmap va, vb;
+
+			cu_roaring_to_words(ca, wa);
+			cu_roaring_to_words(cb, wb);
+			cu_roaring_words_view(&va, wa);
+			cu_roaring_words_view(&vb, wb);
+			cu_bitmap_or(&va, &va, &vb);
+			cu_roaring_from_words(cu_roaring_insert(&tmp, tmp.chunks.size, ca->key), wa, 1);
+			i++;
+			j++;
+		}
+	}
+	cu_roaring_move(dest, &tmp);
+}
+
+
+void cu_roaring_and(struct cu_roaring* dest,
+                    struct cu_roaring* a,
+                    struct cu_roaring* b)
+{
+	assert(dest);
+	assert(a);
+	assert(b);
+	struct cu_roaring tmp;
+	unsigned int i = 0, j = 0;
+
+	cu_roaring_init(&tmp);
+	while (i < a->chunks.size && j < b->chunks.size) {
+		struct cu_roaring_chunk* ca = cu_ROARING_CHUNK(a, i);
+		struct cu_roaring_chunk* cb = cu_ROARING_CHUNK(b, j);
+
+		if (ca->key < cb->key) {
+			i++;
+		} else if (cb->key < ca->key) {
+			j++;
+		} else if (ca->type == cu_ROARING_ARRAY || cb->type == cu_ROARING_ARRAY) {
+			/* probe the array values in the other chunk */
+			struct cu_roaring_chunk* small = ca->type != cu_ROARING_ARRAY
+			                                 || (cb->type == cu_ROARING_ARRAY && cb->card < ca->card) ? cb : ca;
+			struct cu_roaring_chunk* other = small == ca ? cb : ca;
+			cu_BITMAP_WORD wo[cu_ROARING_CHUNK_WORDS];
+			const unsigned short* x = (const unsigned short*)small->data.mem;
+			unsigned short out[cu_ROARING_ARRAY_MAX];
+			unsigned int n = 0;
+
+			cu_roaring_to_words(other, wo);
+			for (unsigned int p=0; p< small->card; p++)
+				if ((wo[x[p]/cu_BITMAP_WORD_BITS] >> (x[p]%cu_BITMAP_WORD_BITS)) & 0x1)
+					out[n++] = x[p];
+			if (n) {
+				struct cu_roaring_chunk* c = cu_roaring_insert(&tmp, tmp.chunks.size, ca->key);
+				cu_memblock_assign(&c->data, out, n*sizeof(unsigned short));
+				c->card = n;
+			}
+			i++;
+			j++;
+		} else {
+			cu_BITMAP_WORD wa[cu_ROARING_CHUNK_WORDS], wb[cu_ROARING_CHUNK_WORDS];
+			struct cu_bitmap va, vb;
+
+			cu_roaring_to_words(ca, wa);
+			cu_roaring_to_words(cb, wb);
+			cu_roaring_words_view(&va, wa);
+			cu_roaring_words_view(&vb, wb);
+			cu_bitmap_and(&va, &va, &vb);
+			if (cu_bitmap_find_first_set(&va) < cu_ROARING_CHUNK_BITS)
+				cu_roaring_from_words(cu_roaring_insert(&tmp, tmp.chunks.size, ca->key), wa, 1);
+			i++;
+			j++;
+		}
+	}
+	cu_roaring_move(dest, &tmp);
+}
+
+
+void cu_roaring_optimize(struct cu_roaring* r)
+{
+	assert(r);
+	cu_BITMAP_WORD words[cu_ROARING_CHUNK_WORDS];
+
+	for (unsigned int i=0; i< r->chunks.size; i++) {
+		cu_roaring_to_words(cu_ROARING_CHUNK(r, i), words);
+		cu_roaring_from_words(cu_ROARING_CHUNK(r, i), words, 1);
+	}
+}
+
+
+int cu_roaring_from_bitmap(struct cu_roaring* r,
+                           struct cu_bitmap* bm)
+{
+	assert(r);
+	assert(bm);
+	const cu_BITMAP_WORD* src = (const cu_BITMAP_WORD*)bm->mblock.mem;
+	size_t n = cu_bitmap_words(bm);
+	cu_BITMAP_WORD words[cu_ROARING_CHUNK_WORDS];
+
+	cu_roaring_clear(r);
+	if ((unsigned long long)bm->size > (1ULL << 32)) {
+		/* chunk keys are 16 bits, higher chunks would wrap */
+		printf("warning cu_roaring_from_bitmap, bitmap too big\n");
+		assert(0);
+		return -1;
+	}
+	for (size_t first=0; first< n; first+= cu_ROARING_CHUNK_WORDS) {
+		size_t len = n - first < cu_ROARING_CHUNK_WORDS ? n - first : cu_ROARING_CHUNK_WORDS;
+		unsigned int any = 0;
+
+		memset(words, 0, sizeof(words));
+		memcpy(words, src + first, len*sizeof(cu_BITMAP_WORD));
+		/* drop the padding bits of the bitmap's last word */
+		if (first + len == n && bm->size % cu_BITMAP_WORD_BITS)
+			words[len-1] &= ((cu_BITMAP_WORD)0x1 << (bm->size % cu_BITMAP_WORD_BITS)) - 1;
+
+		for (size_t i=0; i< len && !any; i++)
+			any = words[i] != 0;
+		if (any)
+			cu_roaring_from_words(cu_roaring_insert(r, r->chunks.size,
+			                                        (unsigned short)(first/cu_ROARING_CHUNK_WORDS)),
+			                      words, 1);
+	}
+	return 0;
+}
+
+
+void cu_roaring_to_bitmap(struct cu_roaring* r,
+                          struct cu_bitmap* bm)
+{
+	assert(r);
+	assert(bm);
+	cu_BITMAP_WORD* dst = (cu_BITMAP_WORD*)bm->mblock.mem;
+	unsigned int n = cu_bitmap_words(bm);
+
+	cu_bitmap_clear(bm);
+	for (unsigned int i=0; i< r->chunks.size; i++) {
+		struct cu_roaring_chunk* c = cu_ROARING_CHUNK(r, i);
+		const unsigned short* a = (const unsigned short*)c->data.mem;
+		unsigned int base = (unsigned int)c->key << 16;
+
+		switch (c->type) {
+		case cu_ROARING_ARRAY:
+			for (unsigned int j=0; j< c->card; j++)
+				cu_bitmap_set_bit(bm, base + a[j]);
+			break;
+		case cu_ROARING_BITMAP: {
+			unsigned int first = base/cu_BITMAP_WORD_BITS;
+			assert(first < n);
+			memcpy(dst + first, c->data.mem,
+			       (n - first < cu_ROARING_CHUNK_WORDS ? n - first : cu_ROARING_CHUNK_WORDS)
+			       *sizeof(cu_BITMAP_WORD));
+			break;
+		}
+		case cu_ROARING_RUN:
+			for (unsigned int j=0; j< c->runs; j++)
+				cu_bitmap_set_range(bm, base + a[2*j], (unsigned int)a[2*j+1] + 1);
+			break;
+		}
+	}
+}
+
+
+#endif /* cu_roaring_h */
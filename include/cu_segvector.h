@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_segvector_h
+#define cu_segvector_h 1
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cu_debug.h"
+#include "cu_allocator.h"
+#include "cu_vector_ptrs.h"
+
+
+/*
+ * cu_SEGVECTOR_DECLARE(name, type) declares struct cu_segvector_<name>, a
+ * vector of values of the given type stored in fixed size chunks of
+ * cu_SEGVECTOR_CHUNK elements. A small directory (a cu_vector_ptrs) keeps
+ * the address of each chunk: growing allocates a new chunk and never
+ * moves the elements already stored, so pointers to them stay valid
+ * until the vector is cleared or deinited, and there is no copy (nor
+ * twice the memory) when a big vector grows.
+ *
+ * Element i lives at index i%cu_SEGVECTOR_CHUNK of chunk
+ * i/cu_SEGVECTOR_CHUNK, both computed with a shift and a mask. Loops over
+ * all the elements should go chunk by chunk, each chunk being a plain
+ * array the compiler can vectorize:
+ *
+ *	for (c=0; c< cu_segvector_<name>_chunks(v); c++) {
+ *		type* d = cu_segvector_<name>_chunk(v, c, &n);
+ *		for (i=0; i< n; i++)
+ *			... d[i] ...
+ *	}
+ *
+ * The following functions are declared:
+ *
+ * void cu_segvector_<name>_init(v)
+ *	inits an empty vector
+ * void cu_segvector_<name>_init_allocator(v, a)
+ *	inits an empty vector, memory comes from a (NULL for cu_allocator_heap())
+ * void cu_segvector_<name>_deinit(v)
+ *	deinits the vector
+ * size_t cu_segvector_<name>_size(v)
+ *	returns the size of the vector
+ * type cu_segvector_<name>_at(v, at)
+ *	returns the element at a given position
+ * void cu_segvector_<name>_set(v, at, value)
+ *	sets the element at a given position
+ * type* cu_segvector_<name>_ptr(v, at)
+ *	returns the address of an element, stable while the vector grows
+ * void cu_segvector_<name>_push_back(v, value)
+ *	pushes a new element at the back of the vector
+ * void cu_segvector_<name>_append(v, values, n)
+ *	pushes n elements at the back of the vector
+ * void cu_segvector_<name>_reserve(v, n)
+ *	allocates the chunks needed to hold n elements
+ * void cu_segvector_<name>_clear(v)
+ *	clears the vector, its chunks are kept for reuse
+ * void cu_segvector_<name>_shrink_to_fit(v)
+ *	frees the chunks not used by the vector
+ * size_t cu_segvector_<name>_chunks(v)
+ *	returns the number of chunks holding elements
+ * type* cu_segvector_<name>_chunk(v, c, n)
+ *	returns chunk c and sets *n to the number of elements it holds
+ *
+ * cu_SEGVECTOR_DEFINE(name, type) defines them; use it in a single
+ * translation unit.
+ */
+
+/* elements per chunk, a power of two */
+#ifndef cu_SEGVECTOR_CHUNK_SHIFT
+#define cu_SEGVECTOR_CHUNK_SHIFT 12
+#endif
+#define cu_SEGVECTOR_CHUNK ((size_t)1 << cu_SEGVECTOR_CHUNK_SHIFT)
+
+
+#define cu_SEGVECTOR_DECLARE(name, type)                                     \
+                                                                             \
+struct cu_segvector_##name {                                                 \
+	/* private */                                                        \
+	struct cu_vector_ptrs chunks;	/* type[cu_SEGVECTOR_CHUNK] each */  \
+	size_t size;			/* in elements */                    \
+	const struct cu_allocator* allocator;	/* chunks source */          \
+};                                                                           \
+                                                                             \
+inline void cu_segvector_##name##_init(struct cu_segvector_##name* v);       \
+inline void cu_segvector_##name##_init_allocator(struct cu_segvector_##name* v, \
+                                                 const struct cu_allocator* a); \
+inline void cu_segvector_##name##_deinit(struct cu_segvector_##name* v);     \
+inline size_t cu_segvector_##name##_size(struct cu_segvector_##name* v);     \
+inline type cu_segvector_##name##_at(struct cu_segvector_##name* v,          \
+                                     size_t at);                             \
+inline void cu_segvector_##name##_set(struct cu_segvector_##name* v,         \
+                                      size_t at,                             \
+                                      type value);                           \
+inline type* cu_segvector_##name##_ptr(struct cu_segvector_##name* v,        \
+                                       size_t at);                           \
+inline void cu_segvector_##name##_push_back(struct cu_segvector_##name* v,   \
+                                            type value);                     \
+inline void cu_segvector_##name##_append(struct cu_segvector_##name* v,      \
+                                         type const* values,                 \
+                                         size_t n);                          \
+inline void cu_segvector_##name##_reserve(struct cu_segvector_##name* v,     \
+                                          size_t n);                         \
+inline void cu_segvector_##name##_clear(struct cu_segvector_##name* v);      \
+inline void cu_segvector_##name##_shrink_to_fit(struct cu_segvector_##name* v); \
+inline size_t cu_segvector_##name##_chunks(struct cu_segvector_##name* v);   \
+inline type* cu_segvector_##name##_chunk(struct cu_segvector_##name* v,      \
+                                         size_t c,                           \
+                                         size_t* n);                         \
+inline void cu_segvector_##name##_add_chunk(struct cu_segvector_##name* v)
+
+
+#define cu_SEGVECTOR_DEFINE(name, type)                                      \
+                                                                             \
+void cu_segvector_##name##_init(struct cu_segvector_##name* v)               \
+{                                                                            \
+	cu_segvector_##name##_init_allocator(v, NULL);                       \
+}                                                                            \
+                                                                             \
+void cu_segvector_##name##_init_allocator(struct cu_segvector_##name* v,     \
+                                          const struct cu_allocator* a)      \
+{                                                                            \
+	assert(v);                                                           \
+	v->allocator = a ? a : cu_allocator_heap();                          \
+	cu_vector_ptrs_init_allocator(&v->chunks, v->allocator);             \
+	v->size = 0;                                                         \
+}                                                                            \
+                                                                             \
+void cu_segvector_##name##_deinit(struct cu_segvector_##name* v)             \
+{                                                                            \
+	assert(v);                                                           \
+	void** d = cu_vector_ptrs_data(&v->chunks);                          \
+	for (size_t c=0; c< cu_vector_ptrs_size(&v->chunks); c++)            \
+		v->allocator->free(v->allocator->ctx, d[c],                  \
+		                   cu_SEGVECTOR_CHUNK*sizeof(type));         \
+	cu_vector_ptrs_deinit(&v->chunks);                                   \
+}                                                                            \
+                                                                             \
+size_t cu_segvector_##name##_size(struct cu_segvector_##name* v)             \
+{                                                                            \
+	assert(v);                                                           \
+	return v->size;                                                      \
+}                                                                            \
+                                                                             \
+type cu_segvector_##name##_at(struct cu_segvector_##name* v,                 \
+                              size_t at)                                     \
+{                                                                            \
+	assert(v);                                                           \
+	assert(at < v->size);                                                \
+	return ((type*)cu_vector_ptrs_data(&v->chunks)[at >> cu_SEGVECTOR_CHUNK_SHIFT]) \
+	       [at & (cu_SEGVECTOR_CHUNK - 1)];                              \
+}                                                                            \
+                                                                             \
+void cu_segvector_##name##_set(struct cu_segvector_##name* v,                \
+                               size_t at,                                    \
+                               type value)                                   \
+{                                                                            \
+	*cu_segvector_##name##_ptr(v, at) = value;                           \
+}                                                                            \
+                                                                             \
+type* cu_segvector_##name##_ptr(struct cu_segvector_##name* v,               \
+                                size_t at)                                   \
+{                                                                            \
+	assert(v);                                                           \
+	assert(at < v->size);                                                \
+	return (type*)cu_vector_ptrs_data(&v->chunks)[at >> cu_SEGVECTOR_CHUNK_SHIFT] \
+	       + (at & (cu_SEGVECTOR_CHUNK - 1));                            \
+}                                                                            \
+                                                                             \
+void cu_segvector_##name##_add_chunk(struct cu_segvector_##name* v)          \
+{                                                                            \
+	void* chunk = v->allocator->alloc(v->allocator->ctx,                 \
+	                                  cu_SEGVECTOR_CHUNK*sizeof(type));  \
+	if (!chunk) {                                                        \
+		printf("warning cu_segvector_add_chunk, alloc failed\n");    \
+		assert(0);                                                   \
+	}                                                                    \
+	cu_vector_ptrs_push_back(&v->chunks, chunk);                         \
+}                                                                            \
+                                                                             \
+void cu_segvector_##name##_push_back(struct cu_segvector_##name* v,          \
+                                     type value)                             \
+{                                                                            \
+	assert(v);                                                           \
+	size_t c = v->size >> cu_SEGVECTOR_CHUNK_SHIFT;                      \
+	/* only the first element of a chunk can need a new one */           \
+	if (c == cu_vector_ptrs_size(&v->chunks))                            \
+		cu_segvector_##name##_add_chunk(v);                          \
+	((type*)cu_vector_ptrs_data(&v->chunks)[c])                          \
+		[v->size & (cu_SEGVECTOR_CHUNK - 1)] = value;                \
+	v->size ++;                                                          \
+}                                                                            \
+                                                                             \
+void cu_segvector_##name##_append(struct cu_segvector_##name* v,             \
+                                  type const* values,                        \
+                                  size_t n)                                  \
+{                                                                            \
+	assert(v);                                                           \
+	assert(values || !n);                                                \
+	assert(n <= SIZE_MAX - v->size);                                     \
+	cu_segvector_##name##_reserve(v, v->size + n);                       \
+	while (n) {                                                          \
+		size_t off = v->size & (cu_SEGVECTOR_CHUNK - 1);             \
+		size_t k = cu_SEGVECTOR_CHUNK - off < n ? cu_SEGVECTOR_CHUNK - off : n; \
+		type* d = (type*)cu_vector_ptrs_data(&v->chunks)             \
+			[v->size >> cu_SEGVECTOR_CHUNK_SHIFT];               \
+		memcpy(d + off, values, k*sizeof(type));                     \
+		values += k;                                                 \
+		v->size += k;                                                \
+		n -= k;                                                      \
+	}                                                                    \
+}                                                                            \
+                                                                             \
+void cu_segvector_##name##_reserve(struct cu_segvector_##name* v,            \
+                                   size_t n)                                 \
+{                                                                            \
+	assert(v);                                                           \
+	size_t chunks = (n >> cu_SEGVECTOR_CHUNK_SHIFT)                      \
+	                + ((n & (cu_SEGVECTOR_CHUNK - 1)) != 0);             \
+	if (chunks > cu_vector_ptrs_reserved(&v->chunks))                      \
+		cu_vector_ptrs_reserve(&v->chunks, chunks);                  \
+	while (cu_vector_ptrs_size(&v->chunks) < chunks)                     \
+		cu_segvector_##name##_add_chunk(v);                          \
+}                                                                            \
+                                                                             \
+void cu_segvector_##name##_clear(struct cu_segvector_##name* v)              \
+{                                                                            \
+	assert(v);                                                           \
+	v->size = 0;                                                         \
+}                                                                            \
+                                                                             \
+void cu_segvector_##name##_shrink_to_fit(struct cu_segvector_##name* v)      \
+{                                                                            \
+	assert(v);                                                           \
+	size_t used = cu_segvector_##name##_chunks(v);                       \
+	void** d = cu_vector_ptrs_data(&v->chunks);                          \
+	for (size_t c=used; c< cu_vector_ptrs_size(&v->chunks); c++)         \
+		v->allocator->free(v->allocator->ctx, d[c],                  \
+		                   cu_SEGVECTOR_CHUNK*sizeof(type));         \
+	cu_vector_ptrs_erase_range(&v->chunks, used,                         \
+	                           cu_vector_ptrs_size(&v->chunks) - used);  \
+	cu_vector_ptrs_shrink_to_fit(&v->chunks);                            \
+}                                                                            \
+                                                                             \
+size_t cu_segvector_##name##_chunks(struct cu_segvector_##name* v)           \
+{                                                                            \
+	assert(v);                                                           \
+	return (v->size >> cu_SEGVECTOR_CHUNK_SHIFT)                         \
+	       + ((v->size & (cu_SEGVECTOR_CHUNK - 1)) != 0);                \
+}                                                                            \
+                                                                             \
+type* cu_segvector_##name##_chunk(struct cu_segvector_##name* v,             \
+                                  size_t c,                                  \
+                                  size_t* n)                                 \
+{                                                                            \
+	assert(v);                                                           \
+	assert(n);                                                           \
+	assert(c < cu_segvector_##name##_chunks(v));                         \
+	*n = v->size - (c << cu_SEGVECTOR_CHUNK_SHIFT) < cu_SEGVECTOR_CHUNK ? \
+	     v->size - (c << cu_SEGVECTOR_CHUNK_SHIFT) : cu_SEGVECTOR_CHUNK; \
+	return (type*)cu_vector_ptrs_data(&v->chunks)[c];                    \
+}
+
+#endif /* cu_segvector_h */
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_smallvector_h
+#define cu_smallvector_h 1
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cu_debug.h"
+#include "cu_memblock.h"
+
+
+/*
+ * cu_SMALLVECTOR_DECLARE(name, type, n) declares struct
+ * cu_smallvector_<name>, a vector of values of the given type that keeps
+ * up to n elements inside the struct itself and only allocates memory
+ * (a cu_memblock from cu_allocator_heap()) when it grows past them. The
+ * inline elements share their space with the cu_memblock, so a small n
+ * costs no memory: on 64 bit systems 6 unsigned ints fit in it.
+ *
+ * The struct holds no pointer to itself and can be moved with memcpy,
+ * e.g. stored by value in a cu_vector. Element addresses change when the
+ * vector spills to the heap.
+ *
+ * The following functions are declared:
+ *
+ * void cu_smallvector_<name>_init(v)
+ *	inits an empty vector, no memory is allocated
+ * void cu_smallvector_<name>_deinit(v)
+ *	deinits the vector
+ * type cu_smallvector_<name>_at(v, at)
+ *	returns the element at a given position
+ * void cu_smallvector_<name>_set(v, at, value)
+ *	sets the element at a given position
+ * type* cu_smallvector_<name>_data(v)
+ *	returns the elements as a plain array, valid until the vector grows
+ * size_t cu_smallvector_<name>_size(v)
+ *	returns the size of the vector
+ * size_t cu_smallvector_<name>_reserved(v)
+ *	returns the number of reserved slots, n while the elements are inline
+ * void cu_smallvector_<name>_clear(v)
+ *	clears the vector, reserved memory is kept
+ * void cu_smallvector_<name>_reserve(v, num_slots)
+ *	reserves memory for the given number of elements
+ * void cu_smallvector_<name>_shrink_to_fit(v)
+ *	moves the elements back inline when they fit, freeing the heap memory
+ * void cu_smallvector_<name>_push_back(v, value)
+ *	pushes a new element at the back of the vector
+ * void cu_smallvector_<name>_append(v, values, count)
+ *	pushes count elements at the back of the vector
+ * void cu_smallvector_<name>_erase_range(v, at, count)
+ *	removes count elements starting from position at
+ *
+ * cu_SMALLVECTOR_DEFINE(name, type, n) defines them; use it in a single
+ * translation unit.
+ */
+
+#define cu_SMALLVECTOR_DECLARE(name, type, n)                                \
+                                                                             \
+struct cu_smallvector_##name {                                               \
+	/* private */                                                        \
+	size_t size;		/* in elements */                            \
+	size_t reserved;	/* n while inline */                         \
+	union {                                                              \
+		type local[n];                                               \
+		struct cu_memblock mblock;	/* once reserved > n */      \
+	} u;                                                                 \
+};                                                                           \
+                                                                             \
+inline void cu_smallvector_##name##_init(struct cu_smallvector_##name* v);   \
+inline void cu_smallvector_##name##_deinit(struct cu_smallvector_##name* v); \
+inline type cu_smallvector_##name##_at(struct cu_smallvector_##name* v,      \
+                                       size_t at);                           \
+inline void cu_smallvector_##name##_set(struct cu_smallvector_##name* v,     \
+                                        size_t at,                           \
+                                        type value);                         \
+inline type* cu_smallvector_##name##_data(struct cu_smallvector_##name* v);  \
+inline size_t cu_smallvector_##name##_size(struct cu_smallvector_##name* v); \
+inline size_t cu_smallvector_##name##_reserved(struct cu_smallvector_##name* v); \
+inline void cu_smallvector_##name##_clear(struct cu_smallvector_##name* v);  \
+inline void cu_smallvector_##name##_reserve(struct cu_smallvector_##name* v, \
+                                            size_t num_slots);               \
+inline void cu_smallvector_##name##_shrink_to_fit(struct cu_smallvector_##name* v); \
+inline void cu_smallvector_##name##_push_back(struct cu_smallvector_##name* v, \
+                                              type value);                   \
+inline void cu_smallvector_##name##_append(struct cu_smallvector_##name* v,  \
+                                           type const* values,               \
+                                           size_t count);                    \
+inline void cu_smallvector_##name##_erase_range(struct cu_smallvector_##name* v, \
+                                                size_t at,                   \
+                                                size_t count)
+
+
+#define cu_SMALLVECTOR_DEFINE(name, type, n)                                 \
+                                                                             \
+void cu_smallvector_##name##_init(struct cu_smallvector_##name* v)           \
+{                                                                            \
+	assert(v);                                                           \
+	v->size = 0;                                                         \
+	v->reserved = n;                                                     \
+}                                                                            \
+                                                                             \
+void cu_smallvector_##name##_deinit(struct cu_smallvector_##name* v)         \
+{                                                                            \
+	assert(v);                                                           \
+	if (v->reserved > n)                                                 \
+		cu_memblock_deinit(&v->u.mblock);                            \
+}                                                                            \
+                                                                             \
+type cu_smallvector_##name##_at(struct cu_smallvector_##name* v,             \
+                                size_t at)                                   \
+{                                                                            \
+	assert(v);                                                           \
+	assert(at < v->size);                                                \
+	return cu_smallvector_##name##_data(v)[at];                          \
+}                                                                            \
+                                                                             \
+void cu_smallvector_##name##_set(struct cu_smallvector_##name* v,            \
+                                 size_t at,                                  \
+                                 type value)                                 \
+{                                                                            \
+	assert(v);                                                           \
+	assert(at < v->size);                                                \
+	cu_smallvector_##name##_data(v)[at] = value;                         \
+}                                                                            \
+                                                                             \
+type* cu_smallvector_##name##_data(struct cu_smallvector_##name* v)          \
+{                                                                            \
+	assert(v);                                                           \
+	return v->reserved > n ? (type*)v->u.mblock.mem : v->u.local;        \
+}                                                                            \
+                                                                             \
+size_t cu_smallvector_##name##_size(struct cu_smallvector_##name* v)         \
+{                                                                            \
+	assert(v);                                                           \
+	return v->size;                                                      \
+}                                                                            \
+                                                                             \
+size_t cu_smallvector_##name##_reserved(struct cu_smallvector_##name* v)     \
+{                                                                            \
+	assert(v);                                                           \
+	return v->reserved;                                                  \
+}                                                                            \
+                                                                             \
+void cu_smallvector_##name##_clear(struct cu_smallvector_##name* v)          \
+{                                                                            \
+	assert(v);                                                           \
+	v->size = 0;                                                         \
+}                                                                            \
+                                                                             \
+void cu_smallvector_##name##_reserve(struct cu_smallvector_##name* v,        \
+                                     size_t num_slots)                       \
+{                                                                            \
+	assert(v);                                                           \
+	assert(num_slots <= SIZE_MAX/sizeof(type));                          \
+	if (num_slots <= v->reserved)                                        \
+		return;                                                      \
+	if (v->reserved > n) {                                               \
+		cu_memblock_set_size(&v->u.mblock, num_slots*sizeof(type));  \
+	} else {                                                             \
+		/* spill: the inline elements move to the heap */            \
+		struct cu_memblock mb;                                       \
+		cu_memblock_init(&mb, num_slots*sizeof(type));               \
+		memcpy(mb.mem, v->u.local, v->size*sizeof(type));            \
+		v->u.mblock = mb;                                            \
+	}                                                                    \
+	v->reserved = num_slots;                                             \
+}                                                                            \
+                                                                             \
+void cu_smallvector_##name##_shrink_to_fit(struct cu_smallvector_##name* v)  \
+{                                                                            \
+	assert(v);                                                           \
+	if (v->reserved <= n || v->size == v->reserved)                      \
+		return;                                                      \
+	if (v->size <= n) {                                                  \
+		struct cu_memblock mb = v->u.mblock;                         \
+		memcpy(v->u.local, mb.mem, v->size*sizeof(type));            \
+		cu_memblock_deinit(&mb);                                     \
+		v->reserved = n;                                             \
+	} else {                                                             \
+		cu_memblock_set_size(&v->u.mblock, v->size*sizeof(type));    \
+		v->reserved = v->size;                                       \
+	}                                                                    \
+}                                                                            \
+                                                                             \
+void cu_smallvector_##name##_push_back(struct cu_smallvector_##name* v,      \
+                                       type value)                           \
+{                                                                            \
+	assert(v);                                                           \
+	if (v->size == v->reserved)                                          \
+		cu_smallvector_##name##_reserve(v, v->reserved*2);           \
+	cu_smallvector_##name##_data(v)[v->size] = value;                    \
+	v->size ++;                                                          \
+}                                                                            \
+                                                                             \
+void cu_smallvector_##name##_append(struct cu_smallvector_##name* v,         \
+                                    type const* values,                      \
+                                    size_t count)                            \
+{                                                                            \
+	assert(v);                                                           \
+	assert(values || !count);                                            \
+	assert(count <= SIZE_MAX - v->size);                                 \
+	if (v->size + count > v->reserved)                                   \
+		cu_smallvector_##name##_reserve(v, v->size + count > v->reserved*2 ? \
+		                                   v->size + count : v->reserved*2); \
+	if (count)                                                           \
+		memcpy(cu_smallvector_##name##_data(v) + v->size, values,    \
+		       count*sizeof(type));                                  \
+	v->size += count;                                                    \
+}                                                                            \
+                                                                             \
+void cu_smallvector_##name##_erase_range(struct cu_smallvector_##name* v,    \
+                                         size_t at,                          \
+                                         size_t count)                       \
+{                                                                            \
+	assert(v);                                                           \
+	assert(at <= v->size && count <= v->size - at);                      \
+	type* d = cu_smallvector_##name##_data(v);                           \
+	if (count)                                                           \
+		memmove(d + at, d + at + count, (v->size - at - count)*sizeof(type)); \
+	v->size -= count;                                                    \
+}
+
+#endif /* cu_smallvector_h */
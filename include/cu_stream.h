@@ -0,0 +1,751 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_stream_h
+#define cu_stream_h 1
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "cu_debug.h"
+#include "cu_memblock.h"
+#include "cu_array_container.h"
+#include "cu_bitmap.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#include <nmmintrin.h>
+#define cu_STREAM_CRC32C_SSE42 1
+#endif
+
+
+/*
+ * Streaming serialization of memblocks, vectors and bitmaps over a file
+ * descriptor. After a stream header the data is cut in chunks of at most
+ * cu_STREAM_CHUNK_SIZE bytes, each one preceded by its sizes and the
+ * CRC32C of its stored bytes, and optionally compressed by a
+ * cu_stream_codec. An empty chunk ends the stream.
+ *
+ * Big payloads are written straight from the container memory (one
+ * writev per chunk, no copy) and read straight into it, a chunk at a
+ * time, so neither side ever holds the whole stream.
+ *
+ * The format uses the host byte order, checked by the stream header.
+ */
+#define cu_STREAM_CHUNK_SIZE (size_t)(1024*1024)
+#define cu_STREAM_MAGIC "cutil.st"
+#define cu_STREAM_VERSION 1
+#define cu_STREAM_BYTE_ORDER 0x01020304
+
+/* chunk flags */
+#define cu_STREAM_COMPRESSED 0x1
+
+/* kinds of records */
+#define cu_STREAM_MEMBLOCK 1
+#define cu_STREAM_VECTOR   2
+#define cu_STREAM_BITMAP   3
+
+
+/*
+ * Compression hook: compress returns the compressed size, or 0 to store
+ * the chunk as it is (for instance when it doesn't fit in cap bytes);
+ * decompress returns the decompressed size, anything but the original
+ * chunk size is an error.
+ */
+struct cu_stream_codec {
+	size_t (*compress)(void* ctx, const void* src, size_t n, void* dst, size_t cap);
+	size_t (*decompress)(void* ctx, const void* src, size_t n, void* dst, size_t cap);
+	void* ctx;
+};
+
+
+struct cu_stream_writer {
+	/* private */
+	int fd;
+	int error;
+	const struct cu_stream_codec* codec;
+	struct cu_memblock buf;		/* chunk being filled */
+	size_t used;
+	struct cu_memblock zbuf;	/* compressed chunk, only with a codec */
+};
+
+
+struct cu_stream_reader {
+	/* private */
+	int fd;
+	int error;
+	int end;			/* the end chunk was read */
+	const struct cu_stream_codec* codec;
+	struct cu_memblock buf;		/* current chunk */
+	size_t pos, len;
+	struct cu_memblock zbuf;	/* compressed chunk, only with a codec */
+};
+
+
+/**
+ * Inits a stream writer and writes the stream header
+ * @w cu_stream_writer to be used
+ * @fd file descriptor to write to
+ * @codec compression hook, NULL to store chunks as they are
+ *
+ * Returns 0 on success, -1 on errors.
+ */
+inline int cu_stream_writer_init(struct cu_stream_writer* w,
+                                 int fd,
+                                 const struct cu_stream_codec* codec);
+
+/**
+ * Deinits a stream writer, the file descriptor is not closed
+ * @w cu_stream_writer to be used
+ *
+ * Call cu_stream_writer_finish first, or the stream will be truncated.
+ */
+inline void cu_stream_writer_deinit(struct cu_stream_writer* w);
+
+/**
+ * Writes bytes to a stream
+ * @w cu_stream_writer to be used
+ * @data bytes to be written
+ * @len number of bytes
+ *
+ * Returns 0 on success, -1 if this or an earlier write failed.
+ */
+inline int cu_stream_write(struct cu_stream_writer* w,
+                           const void* data,
+                           size_t len);
+
+/**
+ * Writes the pending data and the end of the stream
+ * @w cu_stream_writer to be used
+ *
+ * Returns 0 on success, -1 if any write failed.
+ */
+inline int cu_stream_writer_finish(struct cu_stream_writer* w);
+
+/**
+ * Writes the contents of a memblock, a vector or a bitmap
+ * @w cu_stream_writer to be used
+ *
+ * Vectors from cu_vector.h are passed by their container, &v.ac.
+ * Return 0 on success, -1 on errors.
+ */
+inline int cu_stream_write_memblock(struct cu_stream_writer* w,
+                                    struct cu_memblock* mb);
+inline int cu_stream_write_vector(struct cu_stream_writer* w,
+                                  struct cu_array_container* ac);
+inline int cu_stream_write_bitmap(struct cu_stream_writer* w,
+                                  struct cu_bitmap* bm);
+
+/**
+ * Inits a stream reader and checks the stream header
+ * @r cu_stream_reader to be used
+ * @fd file descriptor to read from
+ * @codec compression hook, needed if the stream has compressed chunks
+ *
+ * Returns 0 on success, -1 on errors.
+ */
+inline int cu_stream_reader_init(struct cu_stream_reader* r,
+                                 int fd,
+                                 const struct cu_stream_codec* codec);
+
+/**
+ * Deinits a stream reader, the file descriptor is not closed
+ * @r cu_stream_reader to be used
+ */
+inline void cu_stream_reader_deinit(struct cu_stream_reader* r);
+
+/**
+ * Reads bytes from a stream
+ * @r cu_stream_reader to be used
+ * @data where the bytes go
+ * @len number of bytes
+ *
+ * Returns 0 on success, -1 on errors: read errors, corrupted chunks
+ * (checksum or size mismatch) or a stream ending early.
+ */
+inline int cu_stream_read(struct cu_stream_reader* r,
+                          void* data,
+                          size_t len);
+
+/**
+ * Reads a memblock, a vector or a bitmap written by the cu_stream_write_*
+ * function of the same kind
+ * @r cu_stream_reader to be used
+ *
+ * The container must be inited, it is resized to the stored contents;
+ * vectors must have the stored element size. Return 0 on success, -1 on
+ * errors.
+ */
+inline int cu_stream_read_memblock(struct cu_stream_reader* r,
+                                   struct cu_memblock* mb);
+inline int cu_stream_read_vector(struct cu_stream_reader* r,
+                                 struct cu_array_container* ac);
+inline int cu_stream_read_bitmap(struct cu_stream_reader* r,
+                                 struct cu_bitmap* bm);
+
+/**
+ * Returns the CRC32C (Castagnoli) of some bytes
+ * @crc CRC32C of the preceding bytes, 0 to start
+ * @data bytes to be checksummed
+ * @len number of bytes
+ */
+inline uint32_t cu_stream_crc32c(uint32_t crc,
+                                 const void* data,
+                                 size_t len);
+
+
+/* protected api */
+
+struct cu_stream_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+};
+
+struct cu_stream_chunk {
+	uint32_t size;		/* bytes of data */
+	uint32_t stored;	/* bytes following the chunk header */
+	uint32_t crc;		/* CRC32C of the stored bytes */
+	uint32_t flags;
+};
+
+struct cu_stream_record {
+	uint32_t kind;
+	uint32_t pad;
+	uint64_t slot_size;	/* bytes per element, per storage word for bitmaps */
+	uint64_t size;		/* bytes, elements or bits */
+};
+
+/* slicing-by-1 table of the reflected Castagnoli polynomial 0x82f63b78 */
+extern const uint32_t cu_stream_crc32c_table[256];
+
+#ifdef cu_STREAM_CRC32C_SSE42
+inline uint32_t cu_stream_crc32c_sse42(uint32_t crc, const void* data, size_t len);
+#endif
+
+/* writes all of an iovec array, returns 0 on success */
+inline int cu_stream_writev(int fd, struct iovec* iov, int n);
+
+/* reads len bytes unless the file ends, returns how many were read or -1 */
+inline ssize_t cu_stream_read_full(int fd, void* data, size_t len);
+
+/* writes one chunk */
+inline int cu_stream_write_chunk(struct cu_stream_writer* w,
+                                 const void* data,
+                                 size_t len);
+
+/* reads the header of the next chunk, and its data unless direct is not
+ * NULL and the chunk is stored as it is and fits in direct_len bytes;
+ * returns the chunk size, -1 on errors */
+inline ssize_t cu_stream_read_chunk(struct cu_stream_reader* r,
+                                    void* direct,
+                                    size_t direct_len);
+
+/* writes or reads and checks a record header */
+inline int cu_stream_write_record(struct cu_stream_writer* w,
+                                  uint32_t kind,
+                                  size_t slot_size,
+                                  size_t size);
+inline int cu_stream_read_record(struct cu_stream_reader* r,
+                                 uint32_t kind,
+                                 struct cu_stream_record* rec);
+
+
+
+const uint32_t cu_stream_crc32c_table[256] = {
+	0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c,
+	0x26a1e7e8, 0xd4ca64eb, 0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b,
+	0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24, 0x105ec76f, 0xe235446c,
+	0xf165b798, 0x030e349b, 0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+	0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc,
+	0xbc267848, 0x4e4dfb4b, 0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a,
+	0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35, 0xaa64d611, 0x580f5512,
+	0x4b5fa6e6, 0xb93425e5, 0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+	0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad,
+	0x1642ae59, 0xe4292d5a, 0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a,
+	0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595, 0x417b1dbc, 0xb3109ebf,
+	0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+	0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687, 0x0c38d26c, 0xfe53516f,
+	0xed03a29b, 0x1f682198, 0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927,
+	0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38, 0xdbfc821c, 0x2997011f,
+	0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+	0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096, 0xa65c047d, 0x5437877e,
+	0x4767748a, 0xb50cf789, 0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859,
+	0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46, 0x7198540d, 0x83f3d70e,
+	0x90a324fa, 0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+	0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd, 0xceb018de,
+	0xdde0eb2a, 0x2f8b6829, 0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c,
+	0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93, 0x082f63b7, 0xfa44e0b4,
+	0xe9141340, 0x1b7f9043, 0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+	0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b,
+	0xb4091bff, 0x466298fc, 0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c,
+	0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033, 0xa24bb5a6, 0x502036a5,
+	0x4370c551, 0xb11b4652, 0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+	0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975,
+	0x0e330a81, 0xfc588982, 0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d,
+	0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622, 0x38cc2a06, 0xcaa7a905,
+	0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+	0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530, 0x0417b1db, 0xf67c32d8,
+	0xe52cc12c, 0x1747422f, 0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff,
+	0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0, 0xd3d3e1ab, 0x21b862a8,
+	0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+	0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90, 0x9e902e7b, 0x6cfbad78,
+	0x7fab5e8c, 0x8dc0dd8f, 0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee,
+	0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1, 0x69e9f0d5, 0x9b8273d6,
+	0x88d28022, 0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+	0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a, 0xc69f7b69,
+	0xd5cf889d, 0x27a40b9e, 0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e,
+	0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351
+};
+
+
+#ifdef cu_STREAM_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+uint32_t cu_stream_crc32c_sse42(uint32_t crc, const void* data, size_t len)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	uint64_t c = ~crc;
+
+	for (; len >= 8; p+= 8, len-= 8) {
+		uint64_t x;
+		memcpy(&x, p, 8);
+		c = _mm_crc32_u64(c, x);
+	}
+	for (; len; p++, len--)
+		c = _mm_crc32_u8((uint32_t)c, *p);
+	return ~(uint32_t)c;
+}
+#endif
+
+
+uint32_t cu_stream_crc32c(uint32_t crc,
+                          const void* data,
+                          size_t len)
+{
+	const unsigned char* p = (const unsigned char*)data;
+
+#ifdef cu_STREAM_CRC32C_SSE42
+	if (__builtin_cpu_supports("sse4.2"))
+		return cu_stream_crc32c_sse42(crc, data, len);
+#endif
+	crc = ~crc;
+	for (; len; p++, len--)
+		crc = cu_stream_crc32c_table[(crc ^ *p) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+
+int cu_stream_writev(int fd, struct iovec* iov, int n)
+{
+	while (n) {
+		ssize_t w = writev(fd, iov, n);
+		if (w < 0)
+			return -1;
+		/* skip what was written, partial writes are possible */
+		while (n && (size_t)w >= iov->iov_len) {
+			w -= iov->iov_len;
+			iov++;
+			n--;
+		}
+		if (n) {
+			iov->iov_base = (char*)iov->iov_base + w;
+			iov->iov_len -= w;
+		}
+	}
+	return 0;
+}
+
+
+ssize_t cu_stream_read_full(int fd, void* data, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t n = read(fd, (char*)data + done, len - done);
+		if (n < 0)
+			return -1;
+		if (!n)
+			break;
+		done += n;
+	}
+	return done;
+}
+
+
+int cu_stream_writer_init(struct cu_stream_writer* w,
+                          int fd,
+                          const struct cu_stream_codec* codec)
+{
+	struct cu_stream_header h;
+	struct iovec iov;
+
+	assert(w);
+	w->fd = fd;
+	w->error = 0;
+	w->codec = codec;
+	w->used = 0;
+	cu_memblock_init(&w->buf, cu_STREAM_CHUNK_SIZE);
+	if (codec)
+		cu_memblock_init(&w->zbuf, cu_STREAM_CHUNK_SIZE);
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, cu_STREAM_MAGIC, sizeof(h.magic));
+	h.version = cu_STREAM_VERSION;
+	h.byte_order = cu_STREAM_BYTE_ORDER;
+	iov.iov_base = &h;
+	iov.iov_len = sizeof(h);
+	if (cu_stream_writev(fd, &iov, 1)) {
+		printf("warning cu_stream_writer_init, write\n");
+		w->error = -1;
+	}
+	return w->error;
+}
+
+
+void cu_stream_writer_deinit(struct cu_stream_writer* w)
+{
+	assert(w);
+	cu_memblock_deinit(&w->buf);
+	if (w->codec)
+		cu_memblock_deinit(&w->zbuf);
+}
+
+
+int cu_stream_write_chunk(struct cu_stream_writer* w,
+                          const void* data,
+                          size_t len)
+{
+	struct cu_stream_chunk c;
+	struct iovec iov[2];
+	size_t stored = 0;
+
+	assert(len <= cu_STREAM_CHUNK_SIZE);
+	if (w->codec && len)
+		stored = w->codec->compress(w->codec->ctx, data, len, w->zbuf.mem, len);
+
+	c.size = (uint32_t)len;
+	c.flags = stored ? cu_STREAM_COMPRESSED : 0;
+	if (stored)
+		data = w->zbuf.mem;
+	else
+		stored = len;
+	c.stored = (uint32_t)stored;
+	c.crc = cu_stream_crc32c(0, data, stored);
+
+	iov[0].iov_base = &c;
+	iov[0].iov_len = sizeof(c);
+	iov[1].iov_base = (void*)data;
+	iov[1].iov_len = stored;
+	if (cu_stream_writev(w->fd, iov, 2)) {
+		printf("warning cu_stream_write_chunk, write\n");
+		w->error = -1;
+	}
+	return w->error;
+}
+
+
+int cu_stream_write(struct cu_stream_writer* w,
+                    const void* data,
+                    size_t len)
+{
+	assert(w);
+	assert(data || !len);
+	const char* p = (const char*)data;
+
+	while (len && !w->error) {
+		/* whole chunks go out from the caller's memory */
+		if (!w->used && len >= cu_STREAM_CHUNK_SIZE) {
+			cu_stream_write_chunk(w, p, cu_STREAM_CHUNK_SIZE);
+			p += cu_STREAM_CHUNK_SIZE;
+			len -= cu_STREAM_CHUNK_SIZE;
+			continue;
+		}
+
+		size_t n = cu_STREAM_CHUNK_SIZE - w->used < len ? cu_STREAM_CHUNK_SIZE - w->used : len;
+		memcpy((char*)w->buf.mem + w->used, p, n);
+		w->used += n;
+		p += n;
+		len -= n;
+		if (w->used == cu_STREAM_CHUNK_SIZE) {
+			cu_stream_write_chunk(w, w->buf.mem, w->used);
+			w->used = 0;
+		}
+	}
+	return w->error;
+}
+
+
+int cu_stream_writer_finish(struct cu_stream_writer* w)
+{
+	assert(w);
+	if (w->used && !w->error)
+		cu_stream_write_chunk(w, w->buf.mem, w->used);
+	w->used = 0;
+	/* the empty chunk ending the stream */
+	if (!w->error)
+		cu_stream_write_chunk(w, NULL, 0);
+	return w->error;
+}
+
+
+int cu_stream_write_record(struct cu_stream_writer* w,
+                           uint32_t kind,
+                           size_t slot_size,
+                           size_t size)
+{
+	struct cu_stream_record rec;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.kind = kind;
+	rec.slot_size = slot_size;
+	rec.size = size;
+	return cu_stream_write(w, &rec, sizeof(rec));
+}
+
+
+int cu_stream_write_memblock(struct cu_stream_writer* w,
+                             struct cu_memblock* mb)
+{
+	assert(w);
+	assert(mb);
+	cu_stream_write_record(w, cu_STREAM_MEMBLOCK, 1, mb->size);
+	return cu_stream_write(w, mb->mem, mb->size);
+}
+
+
+int cu_stream_write_vector(struct cu_stream_writer* w,
+                           struct cu_array_container* ac)
+{
+	assert(w);
+	assert(ac);
+	cu_stream_write_record(w, cu_STREAM_VECTOR, ac->slot_size, ac->size);
+	return cu_stream_write(w, ac->mblock.mem, ac->size*ac->slot_size);
+}
+
+
+int cu_stream_write_bitmap(struct cu_stream_writer* w,
+                           struct cu_bitmap* bm)
+{
+	assert(w);
+	assert(bm);
+	cu_stream_write_record(w, cu_STREAM_BITMAP, sizeof(cu_BITMAP_WORD), bm->size);
+	return cu_stream_write(w, bm->mblock.mem, bm->mblock.size);
+}
+
+
+int cu_stream_reader_init(struct cu_stream_reader* r,
+                          int fd,
+                          const struct cu_stream_codec* codec)
+{
+	struct cu_stream_header h;
+
+	assert(r);
+	r->fd = fd;
+	r->error = 0;
+	r->end = 0;
+	r->codec = codec;
+	r->pos = r->len = 0;
+	cu_memblock_init(&r->buf, cu_STREAM_CHUNK_SIZE);
+	if (codec)
+		cu_memblock_init(&r->zbuf, cu_STREAM_CHUNK_SIZE);
+
+	if (cu_stream_read_full(fd, &h, sizeof(h)) != (ssize_t)sizeof(h)
+	    || memcmp(h.magic, cu_STREAM_MAGIC, sizeof(h.magic))
+	    || h.version != cu_STREAM_VERSION
+	    || h.byte_order != cu_STREAM_BYTE_ORDER) {
+		printf("warning cu_stream_reader_init, not a (compatible) cutil stream\n");
+		r->error = -1;
+	}
+	return r->error;
+}
+
+
+void cu_stream_reader_deinit(struct cu_stream_reader* r)
+{
+	assert(r);
+	cu_memblock_deinit(&r->buf);
+	if (r->codec)
+		cu_memblock_deinit(&r->zbuf);
+}
+
+
+ssize_t cu_stream_read_chunk(struct cu_stream_reader* r,
+                             void* direct,
+                             size_t direct_len)
+{
+	struct cu_stream_chunk c;
+	void* dst;
+
+	if (r->end) {
+		printf("warning cu_stream_read, reading past the end of the stream\n");
+		return r->error = -1;
+	}
+	if (cu_stream_read_full(r->fd, &c, sizeof(c)) != (ssize_t)sizeof(c)
+	    || c.size > cu_STREAM_CHUNK_SIZE || c.stored > cu_STREAM_CHUNK_SIZE
+	    || (!(c.flags & cu_STREAM_COMPRESSED) && c.stored != c.size)
+	    || ((c.flags & cu_STREAM_COMPRESSED) && !r->codec)) {
+		printf("warning cu_stream_read, bad or missing chunk header\n");
+		return r->error = -1;
+	}
+
+	if (c.flags & cu_STREAM_COMPRESSED)
+		dst = r->zbuf.mem;
+	else if (direct && c.size <= direct_len)
+		dst = direct;
+	else
+		dst = r->buf.mem;
+	if (cu_stream_read_full(r->fd, dst, c.stored) != (ssize_t)c.stored
+	    || cu_stream_crc32c(0, dst, c.stored) != c.crc) {
+		printf("warning cu_stream_read, truncated or corrupted chunk\n");
+		return r->error = -1;
+	}
+	if ((c.flags & cu_STREAM_COMPRESSED)
+	    && r->codec->decompress(r->codec->ctx, dst, c.stored, r->buf.mem,
+	                            cu_STREAM_CHUNK_SIZE) != c.size) {
+		printf("warning cu_stream_read, decompression failed\n");
+		return r->error = -1;
+	}
+
+	r->end = !c.size;
+	r->pos = 0;
+	r->len = dst == direct ? 0 : c.size;
+	return c.size;
+}
+
+
+int cu_stream_read(struct cu_stream_reader* r,
+                   void* data,
+                   size_t len)
+{
+	assert(r);
+	assert(data || !len);
+	char* p = (char*)data;
+
+	while (len && !r->error) {
+		if (r->pos == r->len) {
+			/* chunks fitting in what's left go straight to data */
+			ssize_t n = cu_stream_read_chunk(r, p, len);
+			if (n > 0 && !r->len) {
+				p += n;
+				len -= n;
+			}
+			if (!n) {
+				printf("warning cu_stream_read, stream ends early\n");
+				r->error = -1;
+			}
+			continue;
+		}
+
+		size_t n = r->len - r->pos < len ? r->len - r->pos : len;
+		memcpy(p, (char*)r->buf.mem + r->pos, n);
+		r->pos += n;
+		p += n;
+		len -= n;
+	}
+	return r->error;
+}
+
+
+int cu_stream_read_record(struct cu_stream_reader* r,
+                          uint32_t kind,
+                          struct cu_stream_record* rec)
+{
+	if (cu_stream_read(r, rec, sizeof(*rec)))
+		return -1;
+	if (rec->kind != kind) {
+		printf("warning cu_stream_read, unexpected record kind %u\n", rec->kind);
+		return r->error = -1;
+	}
+	return 0;
+}
+
+
+int cu_stream_read_memblock(struct cu_stream_reader* r,
+                            struct cu_memblock* mb)
+{
+	struct cu_stream_record rec;
+
+	assert(r);
+	assert(mb);
+	if (cu_stream_read_record(r, cu_STREAM_MEMBLOCK, &rec))
+		return -1;
+	if (rec.size != mb->size)
+		cu_memblock_set_size(mb, rec.size ? rec.size : 1);
+	return cu_stream_read(r, mb->mem, rec.size);
+}
+
+
+int cu_stream_read_vector(struct cu_stream_reader* r,
+                          struct cu_array_container* ac)
+{
+	struct cu_stream_record rec;
+
+	assert(r);
+	assert(ac);
+	if (cu_stream_read_record(r, cu_STREAM_VECTOR, &rec))
+		return -1;
+	if (rec.slot_size != ac->slot_size) {
+		printf("warning cu_stream_read_vector, element size %lu instead of %zu\n",
+		       (unsigned long)rec.slot_size, ac->slot_size);
+		return r->error = -1;
+	}
+	/* the record comes from the stream, don't trust its size */
+	if (rec.size > SIZE_MAX/rec.slot_size) {
+		printf("warning cu_stream_read_vector, bad vector size\n");
+		return r->error = -1;
+	}
+	ac->size = 0;
+	cu_array_container_grow_to(ac, rec.size);
+	if (cu_stream_read(r, ac->mblock.mem, rec.size*rec.slot_size))
+		return -1;
+	ac->size = rec.size;
+	return 0;
+}
+
+
+int cu_stream_read_bitmap(struct cu_stream_reader* r,
+                          struct cu_bitmap* bm)
+{
+	struct cu_stream_record rec;
+
+	assert(r);
+	assert(bm);
+	if (cu_stream_read_record(r, cu_STREAM_BITMAP, &rec))
+		return -1;
+	uint64_t words = rec.size/cu_BITMAP_WORD_BITS + (rec.size%cu_BITMAP_WORD_BITS != 0);
+	if (rec.slot_size != sizeof(cu_BITMAP_WORD) || !rec.size
+	    || rec.size > SIZE_MAX || words > SIZE_MAX/sizeof(cu_BITMAP_WORD)) {
+		printf("warning cu_stream_read_bitmap, bad bitmap record\n");
+		return r->error = -1;
+	}
+	cu_memblock_set_size(&bm->mblock, (size_t)words*sizeof(cu_BITMAP_WORD));
+	if (cu_stream_read(r, bm->mblock.mem, bm->mblock.size))
+		return -1;
+	/* only now the size matches the contents */
+	bm->size = rec.size;
+	return 0;
+}
+
+#endif /* cu_stream_h */
@@ -0,0 +1,522 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_thread_pool_h
+#define cu_thread_pool_h 1
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "cu_debug.h"
+#include "cu_memblock.h"
+
+
+/*
+ * A pool of worker threads running data parallel loops, needs pthreads
+ * and C11 atomics.
+ *
+ * cu_thread_pool_parallel_for(pool, n, grain, fn, data) calls fn on
+ * disjoint ranges covering [0, n), none longer than grain. The range is
+ * split in halves lazily: a thread running a range bigger than grain
+ * pushes its right half on its own work stealing deque (Chase-Lev) and
+ * goes on with the left half, idle threads steal the biggest pending
+ * halves from the top of the other deques. A task is the index of a node
+ * of the implicit binary tree of halves, so deques hold plain integers
+ * and nothing is allocated while a loop runs.
+ *
+ * The thread calling parallel_for (or parallel_reduce) works too and
+ * returns when the whole range is done. Only one thread at a time may
+ * call them, and not from inside fn.
+ */
+
+/* deque slots, more than the depth of any tree of halves */
+#define cu_THREAD_POOL_DEQUE_SIZE 128
+#define cu_THREAD_POOL_CACHE_LINE 64
+
+
+struct cu_thread_pool;
+
+struct cu_thread_pool_deque {
+	/* private */
+	_Atomic int64_t top;		/* thieves take from here */
+	char pad0[cu_THREAD_POOL_CACHE_LINE];
+	_Atomic int64_t bottom;		/* the owner pushes and takes here */
+	_Atomic size_t tasks[cu_THREAD_POOL_DEQUE_SIZE];
+	struct cu_thread_pool* pool;
+	unsigned int slot;		/* owner thread */
+	char pad1[cu_THREAD_POOL_CACHE_LINE];
+};
+
+
+struct cu_thread_pool_job {
+	/* private */
+	size_t n;
+	size_t grain;
+	void (*fn)(size_t begin, size_t end, void* data);
+	void (*reduce_fn)(size_t begin, size_t end, void* partial, void* data);
+	char* partials;		/* one per slot, partial_stride bytes apart */
+	size_t partial_stride;
+	void* data;
+	_Atomic size_t remaining;	/* elements not done yet */
+};
+
+
+struct cu_thread_pool {
+	/* private */
+	struct cu_memblock deques;	/* cu_thread_pool_deque, one per slot */
+	struct cu_memblock threads;	/* pthread_t, one per worker */
+	size_t workers;			/* the caller uses slot workers */
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	size_t generation;		/* bumped for each job, under lock */
+	struct cu_thread_pool_job* job;	/* current job, under lock */
+	unsigned int stop;		/* under lock */
+	_Atomic size_t busy;		/* workers still looking at job */
+};
+
+
+/**
+ * Inits a cu_thread_pool and starts its threads
+ * @pool cu_thread_pool to be used
+ * @threads number of threads running loops, the caller included; 0 for
+ *          the number of online cpus, 1 runs everything in the caller
+ *
+ * Init and deinit are not thread safe.
+ */
+inline void cu_thread_pool_init(struct cu_thread_pool* pool,
+                                size_t threads);
+
+/**
+ * Stops the threads and deinits a cu_thread_pool
+ * @pool cu_thread_pool to be used
+ */
+inline void cu_thread_pool_deinit(struct cu_thread_pool* pool);
+
+/**
+ * Returns the number of threads running loops, the caller included
+ * @pool cu_thread_pool to be used
+ */
+inline size_t cu_thread_pool_threads(struct cu_thread_pool* pool);
+
+/**
+ * Runs fn over [0, n) in parallel
+ * @pool cu_thread_pool to be used
+ * @n number of elements
+ * @grain maximum range length given to fn, 0 for one
+ * @fn called on each range [begin, end), from any thread
+ * @data passed to fn
+ */
+inline void cu_thread_pool_parallel_for(struct cu_thread_pool* pool,
+                                        size_t n,
+                                        size_t grain,
+                                        void (*fn)(size_t begin,
+                                                   size_t end,
+                                                   void* data),
+                                        void* data);
+
+/**
+ * Reduces [0, n) in parallel
+ * @pool cu_thread_pool to be used
+ * @n number of elements
+ * @grain maximum range length given to fn, 0 for one
+ * @fn folds the range [begin, end) into a partial result
+ * @combine folds a partial result into result
+ * @result holds the identity of combine (e.g. 0 for a sum) on entry and
+ *         the reduction on return
+ * @size size of result in bytes
+ * @data passed to fn and combine
+ *
+ * Each thread gets its own partial result, a copy of the initial result,
+ * so fn needs no locking. Ranges are folded in no particular order.
+ */
+inline void cu_thread_pool_parallel_reduce(struct cu_thread_pool* pool,
+                                           size_t n,
+                                           size_t grain,
+                                           void (*fn)(size_t begin,
+                                                      size_t end,
+                                                      void* partial,
+                                                      void* data),
+                                           void (*combine)(void* result,
+                                                           const void* partial,
+                                                           void* data),
+                                           void* result,
+                                           size_t size,
+                                           void* data);
+
+
+/* protected api */
+
+/**
+ * Pushes a task on the bottom of a deque, owner only
+ */
+inline void cu_thread_pool_deque_push(struct cu_thread_pool_deque* d,
+                                      size_t task);
+
+/**
+ * Takes the last task pushed on a deque, owner only
+ *
+ * Returns 0 when the deque is empty.
+ */
+inline size_t cu_thread_pool_deque_take(struct cu_thread_pool_deque* d);
+
+/**
+ * Steals the oldest task of a deque, any thread
+ *
+ * Returns 0 when the deque is empty or another thread won the task.
+ */
+inline size_t cu_thread_pool_deque_steal(struct cu_thread_pool_deque* d);
+
+/**
+ * Returns the range of a node of the tree of halves of [0, n), node 1
+ * being the root and nodes 2k, 2k+1 the halves of node k
+ */
+inline void cu_thread_pool_range(size_t n,
+                                 size_t node,
+                                 size_t* begin,
+                                 size_t* end);
+
+/**
+ * Runs tasks of a job until all its elements are done
+ * @slot deque of the running thread
+ */
+inline void cu_thread_pool_work(struct cu_thread_pool* pool,
+                                struct cu_thread_pool_job* job,
+                                unsigned int slot);
+
+/**
+ * Runs a job with the workers and the calling thread
+ */
+inline void cu_thread_pool_run(struct cu_thread_pool* pool,
+                               struct cu_thread_pool_job* job);
+
+/**
+ * Worker threads main loop
+ * @arg the worker's cu_thread_pool_deque
+ */
+inline void* cu_thread_pool_worker(void* arg);
+
+
+
+void cu_thread_pool_init(struct cu_thread_pool* pool,
+                         size_t threads)
+{
+	assert(pool);
+	if (!threads) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? (size_t)cpus : 1;
+	}
+
+	pool->workers = threads - 1;
+	pool->generation = 0;
+	pool->job = NULL;
+	pool->stop = 0;
+	atomic_init(&pool->busy, 0);
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+
+	cu_memblock_init(&pool->deques, threads*sizeof(struct cu_thread_pool_deque));
+	struct cu_thread_pool_deque* deques = (struct cu_thread_pool_deque*)pool->deques.mem;
+	for (size_t i=0; i< threads; i++) {
+		atomic_init(&deques[i].top, 0);
+		atomic_init(&deques[i].bottom, 0);
+		deques[i].pool = pool;
+		deques[i].slot = (unsigned int)i;
+	}
+
+	/* a memblock can't be empty */
+	cu_memblock_init(&pool->threads, threads*sizeof(pthread_t));
+	for (size_t i=0; i< pool->workers; i++)
+		if (pthread_create((pthread_t*)pool->threads.mem + i, NULL,
+		                   cu_thread_pool_worker, deques + i)) {
+			printf("warning cu_thread_pool_init, pthread_create failed\n");
+			assert(0);
+		}
+}
+
+
+void cu_thread_pool_deinit(struct cu_thread_pool* pool)
+{
+	assert(pool);
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (size_t i=0; i< pool->workers; i++)
+		pthread_join(((pthread_t*)pool->threads.mem)[i], NULL);
+	pthread_cond_destroy(&pool->wake);
+	pthread_mutex_destroy(&pool->lock);
+	cu_memblock_deinit(&pool->threads);
+	cu_memblock_deinit(&pool->deques);
+}
+
+
+size_t cu_thread_pool_threads(struct cu_thread_pool* pool)
+{
+	assert(pool);
+	return pool->workers + 1;
+}
+
+
+void cu_thread_pool_parallel_for(struct cu_thread_pool* pool,
+                                 size_t n,
+                                 size_t grain,
+                                 void (*fn)(size_t begin,
+                                            size_t end,
+                                            void* data),
+                                 void* data)
+{
+	assert(pool);
+	assert(fn);
+	struct cu_thread_pool_job job;
+
+	job.n = n;
+	job.grain = grain ? grain : 1;
+	job.fn = fn;
+	job.reduce_fn = NULL;
+	job.partials = NULL;
+	job.partial_stride = 0;
+	job.data = data;
+	cu_thread_pool_run(pool, &job);
+}
+
+
+void cu_thread_pool_parallel_reduce(struct cu_thread_pool* pool,
+                                    size_t n,
+                                    size_t grain,
+                                    void (*fn)(size_t begin,
+                                               size_t end,
+                                               void* partial,
+                                               void* data),
+                                    void (*combine)(void* result,
+                                                    const void* partial,
+                                                    void* data),
+                                    void* result,
+                                    size_t size,
+                                    void* data)
+{
+	assert(pool);
+	assert(fn);
+	assert(combine);
+	assert(result);
+	assert(size);
+	struct cu_thread_pool_job job;
+	struct cu_memblock partials;
+	size_t slots = pool->workers + 1;
+
+	/* partials on separate cache lines, threads write them all along */
+	job.partial_stride = (size + cu_THREAD_POOL_CACHE_LINE - 1)
+	                     & ~(size_t)(cu_THREAD_POOL_CACHE_LINE - 1);
+	cu_memblock_init(&partials, slots*job.partial_stride);
+	for (size_t i=0; i< slots; i++)
+		memcpy((char*)partials.mem + i*job.partial_stride, result, size);
+
+	job.n = n;
+	job.grain = grain ? grain : 1;
+	job.fn = NULL;
+	job.reduce_fn = fn;
+	job.partials = (char*)partials.mem;
+	job.data = data;
+	cu_thread_pool_run(pool, &job);
+
+	for (size_t i=0; i< slots; i++)
+		combine(result, (char*)partials.mem + i*job.partial_stride, data);
+	cu_memblock_deinit(&partials);
+}
+
+
+void cu_thread_pool_deque_push(struct cu_thread_pool_deque* d,
+                               size_t task)
+{
+	int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+	assert(b - atomic_load_explicit(&d->top, memory_order_relaxed)
+	       < cu_THREAD_POOL_DEQUE_SIZE);
+	atomic_store_explicit(&d->tasks[b % cu_THREAD_POOL_DEQUE_SIZE], task,
+	                      memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+
+size_t cu_thread_pool_deque_take(struct cu_thread_pool_deque* d)
+{
+	int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+	size_t task = 0;
+
+	if (t <= b) {
+		task = atomic_load_explicit(&d->tasks[b % cu_THREAD_POOL_DEQUE_SIZE],
+		                            memory_order_relaxed);
+		if (t != b)
+			return task;
+		/* last task: race the thieves for it */
+		if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+		                                             memory_order_seq_cst,
+		                                             memory_order_relaxed))
+			task = 0;
+	}
+	atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+	return task;
+}
+
+
+size_t cu_thread_pool_deque_steal(struct cu_thread_pool_deque* d)
+{
+	int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+	if (t >= b)
+		return 0;
+	size_t task = atomic_load_explicit(&d->tasks[t % cu_THREAD_POOL_DEQUE_SIZE],
+	                                   memory_order_relaxed);
+	if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+	                                             memory_order_seq_cst,
+	                                             memory_order_relaxed))
+		return 0;
+	return task;
+}
+
+
+void cu_thread_pool_range(size_t n,
+                          size_t node,
+                          size_t* begin,
+                          size_t* end)
+{
+	assert(node);
+	int bit = (int)(sizeof(unsigned long)*8 - 1) - __builtin_clzl(node);
+
+	/* follow the path from the root, one bit per level */
+	*begin = 0;
+	*end = n;
+	while (--bit >= 0) {
+		size_t mid = *begin + (*end - *begin)/2;
+		if ((node >> bit) & 1)
+			*begin = mid;
+		else
+			*end = mid;
+	}
+}
+
+
+void cu_thread_pool_work(struct cu_thread_pool* pool,
+                         struct cu_thread_pool_job* job,
+                         unsigned int slot)
+{
+	struct cu_thread_pool_deque* deques = (struct cu_thread_pool_deque*)pool->deques.mem;
+	size_t slots = pool->workers + 1;
+
+	while (atomic_load_explicit(&job->remaining, memory_order_acquire)) {
+		size_t node = cu_thread_pool_deque_take(deques + slot);
+		for (size_t i=1; !node && i< slots; i++)
+			node = cu_thread_pool_deque_steal(deques + (slot + i) % slots);
+		if (!node) {
+			sched_yield();
+			continue;
+		}
+
+		size_t begin, end;
+		cu_thread_pool_range(job->n, node, &begin, &end);
+		/* keep the left half, leave the right one to thieves */
+		while (end - begin > job->grain) {
+			cu_thread_pool_deque_push(deques + slot, 2*node + 1);
+			node = 2*node;
+			end = begin + (end - begin)/2;
+		}
+		if (job->fn)
+			job->fn(begin, end, job->data);
+		else
+			job->reduce_fn(begin, end, job->partials + slot*job->partial_stride,
+			               job->data);
+		atomic_fetch_sub_explicit(&job->remaining, end - begin, memory_order_release);
+	}
+}
+
+
+void cu_thread_pool_run(struct cu_thread_pool* pool,
+                        struct cu_thread_pool_job* job)
+{
+	struct cu_thread_pool_deque* deques = (struct cu_thread_pool_deque*)pool->deques.mem;
+	assert(job->n <= SIZE_MAX/4);
+
+	if (!job->n)
+		return;
+	atomic_init(&job->remaining, job->n);
+	cu_thread_pool_deque_push(deques + pool->workers, 1);
+
+	/* small jobs are not worth waking the workers */
+	if (pool->workers && job->n > job->grain) {
+		pthread_mutex_lock(&pool->lock);
+		pool->job = job;
+		pool->generation ++;
+		pthread_cond_broadcast(&pool->wake);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	cu_thread_pool_work(pool, job, (unsigned int)pool->workers);
+
+	/* the job lives on the stack: wait for the workers to leave it */
+	pthread_mutex_lock(&pool->lock);
+	pool->job = NULL;
+	pthread_mutex_unlock(&pool->lock);
+	while (atomic_load_explicit(&pool->busy, memory_order_acquire))
+		sched_yield();
+}
+
+
+void* cu_thread_pool_worker(void* arg)
+{
+	struct cu_thread_pool_deque* d = (struct cu_thread_pool_deque*)arg;
+	struct cu_thread_pool* pool = d->pool;
+	size_t seen = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (pool->generation == seen && !pool->stop)
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		if (pool->stop)
+			break;
+		seen = pool->generation;
+		struct cu_thread_pool_job* job = pool->job;
+		if (!job)
+			continue;
+
+		atomic_fetch_add_explicit(&pool->busy, 1, memory_order_relaxed);
+		pthread_mutex_unlock(&pool->lock);
+		cu_thread_pool_work(pool, job, d->slot);
+		atomic_fetch_sub_explicit(&pool->busy, 1, memory_order_release);
+		pthread_mutex_lock(&pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+
+#endif /* cu_thread_pool_h */
@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_vector_h
+#define cu_vector_h 1
+
+#include <string.h>
+
+#include "cu_debug.h"
+#include "cu_array_container.h"
+
+
+/*
+ * cu_VECTOR_DECLARE(name, type) declares struct cu_vector_<name>, a vector
+ * of values of the given type, and the following functions:
+ *
+ * void cu_vector_<name>_init(v)
+ *	inits the vector
+ * void cu_vector_<name>_init_allocator(v, a)
+ *	inits the vector, memory comes from a (NULL for
+ *	cu_array_container_default_allocator())
+ * void cu_vector_<name>_deinit(v)
+ *	deinits the vector
+ * type cu_vector_<name>_at(v, at)
+ *	returns the element at a given position
+ * void cu_vector_<name>_set(v, at, value)
+ *	sets the element at a given position
+ * type* cu_vector_<name>_data(v)
+ *	returns the elements as a plain array, valid until the vector grows
+ * void cu_vector_<name>_clear(v)
+ *	clears the vector, reserved memory is kept
+ * void cu_vector_<name>_shrink_to_fit(v)
+ *	releases the reserved memory not used by the vector
+ * void cu_vector_<name>_set_growth(v, policy, arg)
+ *	sets how the vector grows when full, see cu_array_container_set_growth
+ * void cu_vector_<name>_set_min_reserved(v, num_slots)
+ *	sets the minimum number of reserved slots
+ * void cu_vector_<name>_push_back(v, value)
+ *	pushes a new element at the back of the vector
+ * void cu_vector_<name>_append(v, values, n)
+ *	pushes n elements at the back of the vector
+ * void cu_vector_<name>_insert_range(v, at, values, n)
+ *	inserts n elements before position at (at can be the size)
+ * void cu_vector_<name>_erase_range(v, at, n)
+ *	removes n elements starting from position at
+ * void cu_vector_<name>_resize(v, n, fill)
+ *	sets the size to n, new elements are set to fill
+ * void cu_vector_<name>_reserve(v, num_slots)
+ *	reserves memory for the given number of elements
+ * size_t cu_vector_<name>_reserved(v)
+ *	returns the number of reserved slots
+ * size_t cu_vector_<name>_size(v)
+ *	returns the size of the vector
+ * void cu_vector_<name>_clone(dest, src)
+ *	makes dest a copy of src
+ *
+ * Bulk functions grow the vector at most once and copy with memcpy or
+ * memmove; values must not point inside the vector itself.
+ *
+ * cu_VECTOR_DEFINE(name, type) defines them; use it in a single
+ * translation unit. The element size is known at compile time, so element
+ * access compiles down to plain array indexing and loops over
+ * cu_vector_<name>_data(..) can be vectorized.
+ *
+ * type can be any type that can be copied by assignment: integers,
+ * floats, pointers or structs.
+ */
+
+#define cu_VECTOR_DECLARE(name, type)                                        \
+                                                                             \
+struct cu_vector_##name {                                                    \
+	/* private */                                                        \
+	struct cu_array_container ac;                                        \
+};                                                                           \
+                                                                             \
+inline void cu_vector_##name##_init(struct cu_vector_##name* v);             \
+inline void cu_vector_##name##_init_allocator(struct cu_vector_##name* v,    \
+                                              const struct cu_allocator* a); \
+inline void cu_vector_##name##_deinit(struct cu_vector_##name* v);           \
+inline type cu_vector_##name##_at(struct cu_vector_##name* v,                \
+                                  size_t at);                                \
+inline void cu_vector_##name##_set(struct cu_vector_##name* v,               \
+                                   size_t at,                                \
+                                   type value);                              \
+inline type* cu_vector_##name##_data(struct cu_vector_##name* v);            \
+inline void cu_vector_##name##_clear(struct cu_vector_##name* v);            \
+inline void cu_vector_##name##_shrink_to_fit(struct cu_vector_##name* v);    \
+inline void cu_vector_##name##_set_growth(struct cu_vector_##name* v,        \
+                                          unsigned int policy,               \
+                                          unsigned int arg);                 \
+inline void cu_vector_##name##_set_min_reserved(struct cu_vector_##name* v,  \
+                                                size_t num_slots);           \
+inline void cu_vector_##name##_push_back(struct cu_vector_##name* v,         \
+                                         type value);                        \
+inline void cu_vector_##name##_append(struct cu_vector_##name* v,            \
+                                      type const* values,                    \
+                                      size_t n);                             \
+inline void cu_vector_##name##_insert_range(struct cu_vector_##name* v,      \
+                                            size_t at,                       \
+                                            type const* values,              \
+                                            size_t n);                       \
+inline void cu_vector_##name##_erase_range(struct cu_vector_##name* v,       \
+                                           size_t at,                        \
+                                           size_t n);                        \
+inline void cu_vector_##name##_resize(struct cu_vector_##name* v,            \
+                                      size_t n,                              \
+                                      type fill);                            \
+inline void cu_vector_##name##_reserve(struct cu_vector_##name* v,           \
+                                       size_t num_slots);                    \
+inline size_t cu_vector_##name##_reserved(struct cu_vector_##name* v);       \
+inline size_t cu_vector_##name##_size(struct cu_vector_##name* v);           \
+inline void cu_vector_##name##_clone(struct cu_vector_##name* dest,          \
+                                     struct cu_vector_##name* src)
+
+
+#define cu_VECTOR_DEFINE(name, type)                                         \
+                                                                             \
+void cu_vector_##name##_init(struct cu_vector_##name* v)                     \
+{                                                                            \
+	assert(v);                                                           \
+	cu_array_container_init(&v->ac, sizeof(type));                       \
+}                                                                            \
+                                                                             \
+void cu_vector_##name##_init_allocator(struct cu_vector_##name* v,           \
+                                       const struct cu_allocator* a)         \
+{                                                                            \
+	assert(v);                                                           \
+	cu_array_container_init_allocator(&v->ac, a, sizeof(type));          \
+}                                                                            \
+                                                                             \
+void cu_vector_##name##_deinit(struct cu_vector_##name* v)                   \
+{                                                                            \
+	assert(v);                                                           \
+	cu_array_container_deinit(&v->ac);                                   \
+}                                                                            \
+                                                                             \
+type cu_vector_##name##_at(struct cu_vector_##name* v,                       \
+                           size_t at)                                        \
+{                                                                            \
+	assert(v);                                                           \
+	assert(at < v->ac.size);                                             \
+	return ((type*)v->ac.mblock.mem)[at];                                \
+}                                                                            \
+                                                                             \
+void cu_vector_##name##_set(struct cu_vector_##name* v,                      \
+                            size_t at,                                       \
+                            type value)                                      \
+{                                                                            \
+	assert(v);                                                           \
+	assert(at < v->ac.size);                                             \
+	((type*)v->ac.mblock.mem)[at] = value;                               \
+}                                                                            \
+                                                                             \
+type* cu_vector_##name##_data(struct cu_vector_##name* v)                    \
+{                                                                            \
+	assert(v);                                                           \
+	return (type*)v->ac.mblock.mem;                                      \
+}                                                                            \
+                                                                             \
+void cu_vector_##name##_clear(struct cu_vector_##name* v)                    \
+{                                                                            \
+	assert(v);                                                           \
+	cu_array_container_clear(&v->ac, sizeof(type));                      \
+}                                                                            \
+                                                                             \
+void cu_vector_##name##_shrink_to_fit(struct cu_vector_##name* v)            \
+{                                                                            \
+	assert(v);                                                           \
+	cu_array_container_shrink_to_fit(&v->ac);                            \
+}                                                                            \
+                                                                             \
+void cu_vector_##name##_set_growth(struct cu_vector_##name* v,               \
+                                   unsigned int policy,                      \
+                                   unsigned int arg)                         \
+{                                                                            \
+	assert(v);                                                           \
+	cu_array_container_set_growth(&v->ac, policy, arg);                  \
+}                                                                            \
+                                                                             \
+void cu_vector_##name##_set_min_reserved(struct cu_vector_##name* v,         \
+                                         size_t num_slots)                   \
+{                                                                            \
+	assert(v);                                                           \
+	cu_array_container_set_min_reserved(&v->ac, num_slots);              \
+}                                                                            \
+                                                                             \
+void cu_vector_##name##_push_back(struct cu_vector_##name* v,                \
+                                  type value)                                \
+{                                                                            \
+	assert(v);                                                           \
+	/* only the rare full case leaves the inlined path */                \
+	if (v->ac.size == v->ac.reserved)                                    \
+		cu_array_container_grow_once(&v->ac);                        \
+	((type*)v->ac.mblock.mem)[v->ac.size] = value;                       \
+	v->ac.size ++;                                                       \
+}                                                                            \
+                                                                             \
+void cu_vector_##name##_append(struct cu_vector_##name* v,                   \
+                               type const* values,                           \
+                               size_t n)                                     \
+{                                                                            \
+	assert(v);                                                           \
+	assert(values || !n);                                                \
+	assert(n <= SIZE_MAX - v->ac.size);                                  \
+	cu_array_container_grow_to(&v->ac, v->ac.size + n);                  \
+	if (n)                                                               \
+		memcpy((type*)v->ac.mblock.mem + v->ac.size, values, n*sizeof(type)); \
+	v->ac.size += n;                                                     \
+}                                                                            \
+                                                                             \
+void cu_vector_##name##_insert_range(struct cu_vector_##name* v,             \
+                                     size_t at,                              \
+                                     type const* values,                     \
+                                     size_t n)                               \
+{                                                                            \
+	assert(v);                                                           \
+	assert(values || !n);                                                \
+	assert(at <= v->ac.size);                                            \
+	assert(n <= SIZE_MAX - v->ac.size);                                  \
+	cu_array_container_grow_to(&v->ac, v->ac.size + n);                  \
+	type* d = (type*)v->ac.mblock.mem;                                   \
+	if (n) {                                                             \
+		memmove(d + at + n, d + at, (v->ac.size - at)*sizeof(type)); \
+		memcpy(d + at, values, n*sizeof(type));                      \
+	}                                                                    \
+	v->ac.size += n;                                                     \
+}                                                                            \
+                                                                             \
+void cu_vector_##name##_erase_range(struct cu_vector_##name* v,              \
+                                    size_t at,                               \
+                                    size_t n)                                \
+{                                                                            \
+	assert(v);                                                           \
+	assert(at <= v->ac.size && n <= v->ac.size - at);                    \
+	type* d = (type*)v->ac.mblock.mem;                                   \
+	if (n)                                                               \
+		memmove(d + at, d + at + n, (v->ac.size - at - n)*sizeof(type)); \
+	v->ac.size -= n;                                                     \
+}                                                                            \
+                                                                             \
+void cu_vector_##name##_resize(struct cu_vector_##name* v,                   \
+                               size_t n,                                     \
+                               type fill)                                    \
+{                                                                            \
+	assert(v);                                                           \
+	cu_array_container_grow_to(&v->ac, n);                               \
+	type* d = (type*)v->ac.mblock.mem;                                   \
+	for (size_t i=v->ac.size; i< n; i++)                                 \
+		d[i] = fill;                                                 \
+	v->ac.size = n;                                                      \
+}                                                                            \
+                                                                             \
+void cu_vector_##name##_reserve(struct cu_vector_##name* v,                  \
+                                size_t num_slots)                            \
+{                                                                            \
+	assert(v);                                                           \
+	assert(num_slots);                                                   \
+	cu_array_container_reserve(&v->ac, sizeof(type), num_slots);         \
+}                                                                            \
+                                                                             \
+size_t cu_vector_##name##_reserved(struct cu_vector_##name* v)               \
+{                                                                            \
+	assert(v);                                                           \
+	return v->ac.reserved;                                               \
+}                                                                            \
+                                                                             \
+size_t cu_vector_##name##_size(struct cu_vector_##name* v)                   \
+{                                                                            \
+	assert(v);                                                           \
+	return v->ac.size;                                                   \
+}                                                                            \
+                                                                             \
+void cu_vector_##name##_clone(struct cu_vector_##name* dest,                 \
+                              struct cu_vector_##name* src)                  \
+{                                                                            \
+	assert(dest);                                                        \
+	assert(src);                                                         \
+	if (dest == src)                                                     \
+		return;                                                      \
+	dest->ac.size = 0;                                                   \
+	cu_vector_##name##_append(dest, (type*)src->ac.mblock.mem, src->ac.size); \
+}
+
+#endif /* cu_vector_h */
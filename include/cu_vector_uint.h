@@ -24,166 +24,477 @@
 #ifndef cu_vector_uint_h
 #define cu_vector_uint_h 1
 
-#include "cu_debug.h"
-#include "cu_array_container.h"
+#include <stdint.h>
 
+#include "cu_vector.h"
 
-struct cu_vector_uint {
-	/* private */
-	struct cu_array_container ac;
-};
+/* AVX2 (and BMI2) kernels are compiled with a target attribute and picked
+ * at run time, so binaries built for baseline x86-64 still use them */
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#include <immintrin.h>
+#define cu_VECTOR_UINT_AVX2 1
+#endif
 
-/**
- * Inits a cu_vector_uint
- * @v cu_vector_uint to be used
+
+/*
+ * A vector of unsigned ints, see cu_vector.h for its api
  */
-inline void cu_vector_uint_init(struct cu_vector_uint* v);
+cu_VECTOR_DECLARE(uint, unsigned int);
+
+cu_VECTOR_DEFINE(uint, unsigned int)
+
+
+/* predicates for cu_vector_uint_filter, comparing elements to a value */
+#define cu_VECTOR_UINT_LESS          0
+#define cu_VECTOR_UINT_LESS_EQUAL    1
+#define cu_VECTOR_UINT_GREATER       2
+#define cu_VECTOR_UINT_GREATER_EQUAL 3
+#define cu_VECTOR_UINT_EQUAL         4
+#define cu_VECTOR_UINT_NOT_EQUAL     5
+
 
 /**
- * Deinits a cu_vector_uint
+ * Returns the index of the first element equal to a value
  * @v cu_vector_uint to be used
+ * @value value to look for
+ *
+ * Returns cu_vector_uint_size(..) when no such element exists.
  */
-inline void cu_vector_uint_deinit(struct cu_vector_uint* v);
+inline size_t cu_vector_uint_find(struct cu_vector_uint* v,
+                                  unsigned int value);
 
 /**
- * Returns the element at a given position
+ * Returns the number of elements equal to a value
  * @v cu_vector_uint to be used
- * @at index of the elemnt
+ * @value value to look for
  */
-inline unsigned int cu_vector_uint_at(struct cu_vector_uint* v,
-                                      unsigned int at);
+inline size_t cu_vector_uint_count(struct cu_vector_uint* v,
+                                   unsigned int value);
+
 /**
- * Sets the element at a given position
+ * Returns the smallest element of a non empty vector
  * @v cu_vector_uint to be used
- * @at index of the elemnt
- * @value new value
  */
-inline void cu_vector_uint_set(struct cu_vector_uint* v,
-                               unsigned int at,
-                               unsigned int value);
+inline unsigned int cu_vector_uint_min(struct cu_vector_uint* v);
 
 /**
- * Clears the vector
+ * Returns the biggest element of a non empty vector
  * @v cu_vector_uint to be used
  */
-inline void cu_vector_uint_clear(struct cu_vector_uint* v);
+inline unsigned int cu_vector_uint_max(struct cu_vector_uint* v);
 
 /**
- * Pushes a new element at the back of the vector
+ * Returns the sum of the elements, accumulated on 64 bits
  * @v cu_vector_uint to be used
- * @value new value
  */
-inline void cu_vector_uint_push_back(struct cu_vector_uint* v,
-                                     unsigned int value);
+inline uint64_t cu_vector_uint_sum(struct cu_vector_uint* v);
 
 /**
- * Reserves memory for the given number of uints
- * @v cu_vector_uint to be used
- * @r number of uints
+ * Returns the index of the first element not less than a value
+ * @v sorted cu_vector_uint to be used
+ * @value value to look for
+ *
+ * Returns cu_vector_uint_size(..) when all the elements are less than value.
  */
-inline void cu_vector_uint_reserve(struct cu_vector_uint* v,
-                                   unsigned int num_slots);
+inline size_t cu_vector_uint_lower_bound(struct cu_vector_uint* v,
+                                         unsigned int value);
 
 /**
- * Returns the number of reserved slots
- * @v cu_vector_uint to be used
+ * Appends the elements of a vector matching a predicate to another vector
+ * @dest cu_vector_uint the matching elements are appended to
+ * @src cu_vector_uint to be filtered
+ * @op one of cu_VECTOR_UINT_LESS, .._LESS_EQUAL, .._GREATER,
+ *     .._GREATER_EQUAL, .._EQUAL or .._NOT_EQUAL
+ * @value right hand side of the comparison
+ *
+ * The elements keep their order. dest and src must be different vectors.
  */
-inline unsigned int cu_vector_uint_reserved(struct cu_vector_uint* v);
+inline void cu_vector_uint_filter(struct cu_vector_uint* dest,
+                                  struct cu_vector_uint* src,
+                                  unsigned int op,
+                                  unsigned int value);
 
 
-/**
- * Returns the size of the vector
- * @v cu_vector_uint to be used
- */
-inline unsigned int cu_vector_uint_size(struct cu_vector_uint* v);
+/* protected api */
+
+/* number of elements cu_vector_uint_filter makes room for at a time */
+#define cu_VECTOR_UINT_FILTER_BLOCK (size_t)1024
+
+/* returns whether x op value holds, op as in cu_vector_uint_filter */
+inline unsigned int cu_vector_uint_match(unsigned int x,
+                                         unsigned int op,
+                                         unsigned int value);
 
+#ifdef cu_VECTOR_UINT_AVX2
+inline size_t cu_vector_uint_find_avx2(const unsigned int* d, size_t n,
+                                       unsigned int value);
+inline size_t cu_vector_uint_count_avx2(const unsigned int* d, size_t n,
+                                        unsigned int value);
+inline unsigned int cu_vector_uint_min_avx2(const unsigned int* d, size_t n);
+inline unsigned int cu_vector_uint_max_avx2(const unsigned int* d, size_t n);
+inline uint64_t cu_vector_uint_sum_avx2(const unsigned int* d, size_t n);
+inline size_t cu_vector_uint_filter_avx2(unsigned int* out, const unsigned int* d,
+                                         size_t n, unsigned int op,
+                                         unsigned int value);
+#endif
+
+
+/*
+ * Whether the AVX2 kernels can be used: always when the compiler targets
+ * AVX2 and BMI2, else when the cpu running the code supports them
+ */
+#if !defined(cu_VECTOR_UINT_AVX2)
+#define cu_VECTOR_UINT_USE_AVX2() 0
+#elif defined(__AVX2__) && defined(__BMI2__)
+#define cu_VECTOR_UINT_USE_AVX2() 1
+#else
+#define cu_VECTOR_UINT_USE_AVX2() (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2"))
+#endif
+
+
+unsigned int cu_vector_uint_match(unsigned int x,
+                                  unsigned int op,
+                                  unsigned int value)
+{
+	switch (op) {
+	case cu_VECTOR_UINT_LESS:          return x < value;
+	case cu_VECTOR_UINT_LESS_EQUAL:    return x <= value;
+	case cu_VECTOR_UINT_GREATER:       return x > value;
+	case cu_VECTOR_UINT_GREATER_EQUAL: return x >= value;
+	case cu_VECTOR_UINT_EQUAL:         return x == value;
+	default:                           return x != value;
+	}
+}
 
-inline void cu_vector_uint_clone(struct cu_vector_uint* dest,
-                                 struct cu_vector_uint* src );
 
-void cu_vector_uint_init(struct cu_vector_uint* v) {
+size_t cu_vector_uint_find(struct cu_vector_uint* v,
+                           unsigned int value)
+{
 	assert(v);
-	cu_array_container_init(&v->ac, sizeof(unsigned int));
+	const unsigned int* d = (const unsigned int*)v->ac.mblock.mem;
+	size_t i = 0;
+
+#ifdef cu_VECTOR_UINT_AVX2
+	if (cu_VECTOR_UINT_USE_AVX2())
+		return cu_vector_uint_find_avx2(d, v->ac.size, value);
+#endif
+	while (i < v->ac.size && d[i] != value)
+		i++;
+	return i;
 }
 
-void cu_vector_uint_deinit(struct cu_vector_uint* v) {
+
+size_t cu_vector_uint_count(struct cu_vector_uint* v,
+                            unsigned int value)
+{
 	assert(v);
-	cu_array_container_deinit(&v->ac);
+	const unsigned int* d = (const unsigned int*)v->ac.mblock.mem;
+	size_t count = 0;
+
+#ifdef cu_VECTOR_UINT_AVX2
+	if (cu_VECTOR_UINT_USE_AVX2())
+		return cu_vector_uint_count_avx2(d, v->ac.size, value);
+#endif
+	for (size_t i=0; i< v->ac.size; i++)
+		count += d[i] == value;
+	return count;
 }
 
 
-unsigned int cu_vector_uint_at(struct cu_vector_uint* v,
-                               unsigned int at)
+unsigned int cu_vector_uint_min(struct cu_vector_uint* v)
 {
 	assert(v);
-	assert(at < v->ac.size);
-	return ((unsigned int*)v->ac.mblock.mem)[at];
+	assert(v->ac.size);
+	const unsigned int* d = (const unsigned int*)v->ac.mblock.mem;
+	unsigned int m = d[0];
+
+#ifdef cu_VECTOR_UINT_AVX2
+	if (cu_VECTOR_UINT_USE_AVX2())
+		return cu_vector_uint_min_avx2(d, v->ac.size);
+#endif
+	for (size_t i=1; i< v->ac.size; i++)
+		m = d[i] < m ? d[i] : m;
+	return m;
 }
 
 
-void cu_vector_uint_set(struct cu_vector_uint* v,
-                        unsigned int at,
-                        unsigned int value)
+unsigned int cu_vector_uint_max(struct cu_vector_uint* v)
 {
 	assert(v);
-	assert(at < v->ac.size);
-	((unsigned int*)v->ac.mblock.mem)[at] = value;
+	assert(v->ac.size);
+	const unsigned int* d = (const unsigned int*)v->ac.mblock.mem;
+	unsigned int m = d[0];
+
+#ifdef cu_VECTOR_UINT_AVX2
+	if (cu_VECTOR_UINT_USE_AVX2())
+		return cu_vector_uint_max_avx2(d, v->ac.size);
+#endif
+	for (size_t i=1; i< v->ac.size; i++)
+		m = d[i] > m ? d[i] : m;
+	return m;
 }
 
 
-void cu_vector_uint_clear(struct cu_vector_uint* v)
+uint64_t cu_vector_uint_sum(struct cu_vector_uint* v)
 {
 	assert(v);
-	cu_array_container_clear(&v->ac, sizeof(unsigned int));
+	const unsigned int* d = (const unsigned int*)v->ac.mblock.mem;
+	uint64_t sum = 0;
+
+#ifdef cu_VECTOR_UINT_AVX2
+	if (cu_VECTOR_UINT_USE_AVX2())
+		return cu_vector_uint_sum_avx2(d, v->ac.size);
+#endif
+	for (size_t i=0; i< v->ac.size; i++)
+		sum += d[i];
+	return sum;
 }
 
 
-void cu_vector_uint_push_back(struct cu_vector_uint* v,
-                              unsigned int value)
+size_t cu_vector_uint_lower_bound(struct cu_vector_uint* v,
+                                  unsigned int value)
 {
 	assert(v);
+	const unsigned int* d = (const unsigned int*)v->ac.mblock.mem;
+	size_t lo = 0, len = v->ac.size;
+
+	/* binary search down to a window of a few cache lines... */
+	while (len > 64) {
+		size_t half = len/2;
+		if (d[lo + half] < value) {
+			lo += half + 1;
+			len -= half + 1;
+		} else
+			len = half;
+	}
+
+	/* ...then count the elements less than value in it, with no
+	 * unpredictable branches */
+#ifdef cu_VECTOR_UINT_AVX2
+	if (cu_VECTOR_UINT_USE_AVX2())
+		return lo + cu_vector_uint_filter_avx2(NULL, d + lo, len,
+		                                       cu_VECTOR_UINT_LESS, value);
+#endif
+	size_t count = 0;
+	for (size_t i=0; i< len; i++)
+		count += d[lo + i] < value;
+	return lo + count;
+}
+
 
-	/* check for the need of more memory */
-	cu_array_container_check_size_and_grow(&v->ac);
-  
-	((unsigned int*)v->ac.mblock.mem)[v->ac.size] = value;
-	v->ac.size ++;
+void cu_vector_uint_filter(struct cu_vector_uint* dest,
+                           struct cu_vector_uint* src,
+                           unsigned int op,
+                           unsigned int value)
+{
+	assert(dest);
+	assert(src);
+	assert(dest != src);
+	assert(op <= cu_VECTOR_UINT_NOT_EQUAL);
+	const unsigned int* d = (const unsigned int*)src->ac.mblock.mem;
+
+	for (size_t i=0; i< src->ac.size; i+= cu_VECTOR_UINT_FILTER_BLOCK) {
+		size_t n = src->ac.size - i < cu_VECTOR_UINT_FILTER_BLOCK ?
+		           src->ac.size - i : cu_VECTOR_UINT_FILTER_BLOCK;
+		cu_array_container_grow_to(&dest->ac, dest->ac.size + n);
+		unsigned int* out = (unsigned int*)dest->ac.mblock.mem + dest->ac.size;
+
+#ifdef cu_VECTOR_UINT_AVX2
+		if (cu_VECTOR_UINT_USE_AVX2()) {
+			dest->ac.size += cu_vector_uint_filter_avx2(out, d + i, n, op, value);
+			continue;
+		}
+#endif
+		/* store every element, keep the matching ones */
+		size_t k = 0;
+		for (size_t j=0; j< n; j++) {
+			out[k] = d[i + j];
+			k += cu_vector_uint_match(d[i + j], op, value);
+		}
+		dest->ac.size += k;
+	}
 }
 
 
-void cu_vector_uint_reserve(struct cu_vector_uint* v,
-                            unsigned int num_slots)
+#ifdef cu_VECTOR_UINT_AVX2
+
+#define cu_VECTOR_UINT_TARGET_AVX2 __attribute__((target("avx2,bmi2")))
+
+/* unsigned compares, AVX2 only compares signed integers */
+#define cu_VECTOR_UINT_AVX2_SIGN(x) _mm256_xor_si256((x), _mm256_set1_epi32((int)0x80000000))
+
+/*
+ * Filter loop body for one kind of comparison: cmp(a, b) is
+ * _mm256_cmpgt_epi32 or _mm256_cmpeq_epi32, its result is inverted when
+ * inv is all ones
+ */
+#define cu_VECTOR_UINT_AVX2_FILTER(out, d, n, i, k, v, cmp, x_first, inv)    \
+	for (; i + 8 <= n; i+= 8) {                                          \
+		__m256i x_ = _mm256_loadu_si256((const __m256i*)(d + i));    \
+		__m256i sx_ = cu_VECTOR_UINT_AVX2_SIGN(x_);                  \
+		__m256i m_ = x_first ? cmp(sx_, v) : cmp(v, sx_);            \
+		unsigned int bits_ = (unsigned int)_mm256_movemask_ps(       \
+		                     _mm256_castsi256_ps(_mm256_xor_si256(m_, inv))); \
+		if (out) {                                                   \
+			/* move the matching lanes to the front */           \
+			uint64_t lanes_ = _pdep_u64(bits_, 0x0101010101010101ULL)*0xff; \
+			__m256i perm_ = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128( \
+			                (long long)_pext_u64(0x0706050403020100ULL, lanes_))); \
+			_mm256_storeu_si256((__m256i*)(out + k),             \
+			                    _mm256_permutevar8x32_epi32(x_, perm_)); \
+		}                                                            \
+		k += __builtin_popcount(bits_);                              \
+	}
+
+
+cu_VECTOR_UINT_TARGET_AVX2
+size_t cu_vector_uint_find_avx2(const unsigned int* d, size_t n,
+                                unsigned int value)
 {
-	assert(v);
-	assert(num_slots);
-	cu_array_container_reserve(&v->ac, sizeof(unsigned int), num_slots);
+	__m256i v = _mm256_set1_epi32((int)value);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i+= 16) {
+		__m256i a = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(d + i)), v);
+		__m256i b = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(d + i + 8)), v);
+		unsigned int m = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(a))
+		                 | (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(b)) << 8;
+		if (m)
+			return i + __builtin_ctz(m);
+	}
+	while (i < n && d[i] != value)
+		i++;
+	return i;
 }
 
 
-unsigned int cu_vector_uint_reserved(struct cu_vector_uint* v)
+cu_VECTOR_UINT_TARGET_AVX2
+size_t cu_vector_uint_count_avx2(const unsigned int* d, size_t n,
+                                 unsigned int value)
 {
-	assert(v);
-	return v->ac.reserved;
+	__m256i v = _mm256_set1_epi32((int)value);
+	size_t count = 0, i = 0;
+
+	while (i + 8 <= n) {
+		/* per lane counters, flushed before they can overflow */
+		__m256i acc = _mm256_setzero_si256();
+		size_t end = n - i > ((size_t)1 << 30) ? i + ((size_t)1 << 30) : n;
+		for (; i + 8 <= end; i+= 8)
+			acc = _mm256_sub_epi32(acc, _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(d + i)), v));
+
+		unsigned int lanes[8];
+		_mm256_storeu_si256((__m256i*)lanes, acc);
+		for (unsigned int k=0; k< 8; k++)
+			count += lanes[k];
+	}
+	for (; i< n; i++)
+		count += d[i] == value;
+	return count;
 }
 
 
-inline unsigned int cu_vector_uint_size(struct cu_vector_uint* v)
+cu_VECTOR_UINT_TARGET_AVX2
+unsigned int cu_vector_uint_min_avx2(const unsigned int* d, size_t n)
 {
-	assert(v);
-	return v->ac.size;
+	__m256i m = _mm256_set1_epi32((int)d[0]);
+	unsigned int lanes[8], r = d[0];
+	size_t i = 0;
+
+	for (; i + 8 <= n; i+= 8)
+		m = _mm256_min_epu32(m, _mm256_loadu_si256((const __m256i*)(d + i)));
+	_mm256_storeu_si256((__m256i*)lanes, m);
+	for (unsigned int k=0; k< 8; k++)
+		r = lanes[k] < r ? lanes[k] : r;
+	for (; i< n; i++)
+		r = d[i] < r ? d[i] : r;
+	return r;
 }
 
 
-void cu_vector_uint_clone(struct cu_vector_uint* dest,
-                          struct cu_vector_uint* src )
+cu_VECTOR_UINT_TARGET_AVX2
+unsigned int cu_vector_uint_max_avx2(const unsigned int* d, size_t n)
 {
-	assert(dest);
-	assert(src);
-	cu_vector_uint_clear(dest);
-  
-	for (unsigned int i=0; i< cu_vector_uint_size(src); i++)
-		cu_vector_uint_push_back(dest, cu_vector_uint_at(src,i));
+	__m256i m = _mm256_set1_epi32((int)d[0]);
+	unsigned int lanes[8], r = d[0];
+	size_t i = 0;
+
+	for (; i + 8 <= n; i+= 8)
+		m = _mm256_max_epu32(m, _mm256_loadu_si256((const __m256i*)(d + i)));
+	_mm256_storeu_si256((__m256i*)lanes, m);
+	for (unsigned int k=0; k< 8; k++)
+		r = lanes[k] > r ? lanes[k] : r;
+	for (; i< n; i++)
+		r = d[i] > r ? d[i] : r;
+	return r;
+}
+
+
+cu_VECTOR_UINT_TARGET_AVX2
+uint64_t cu_vector_uint_sum_avx2(const unsigned int* d, size_t n)
+{
+	__m256i lo = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+	uint64_t lanes[4], sum = 0;
+	size_t i = 0;
+
+	/* widen to 64 bit lanes before adding */
+	for (; i + 8 <= n; i+= 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(d + i));
+		lo = _mm256_add_epi64(lo, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(x)));
+		hi = _mm256_add_epi64(hi, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(x, 1)));
+	}
+	_mm256_storeu_si256((__m256i*)lanes, _mm256_add_epi64(lo, hi));
+	sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	for (; i< n; i++)
+		sum += d[i];
+	return sum;
+}
+
+
+/*
+ * Stores the elements of d matching op and value to out, returns how many
+ * matched. With out NULL they are only counted.
+ */
+cu_VECTOR_UINT_TARGET_AVX2
+size_t cu_vector_uint_filter_avx2(unsigned int* out, const unsigned int* d,
+                                  size_t n, unsigned int op,
+                                  unsigned int value)
+{
+	__m256i v = cu_VECTOR_UINT_AVX2_SIGN(_mm256_set1_epi32((int)value));
+	__m256i ones = _mm256_set1_epi32(-1), zeros = _mm256_setzero_si256();
+	size_t k = 0, i = 0;
+
+	/* matching lanes are compacted with a permutation taken from the
+	 * mask with pdep/pext, stores can write up to 7 extra elements
+	 * after the matching ones but never past out + n */
+	switch (op) {
+	case cu_VECTOR_UINT_LESS:
+		cu_VECTOR_UINT_AVX2_FILTER(out, d, n, i, k, v, _mm256_cmpgt_epi32, 0, zeros);
+		break;
+	case cu_VECTOR_UINT_LESS_EQUAL:
+		cu_VECTOR_UINT_AVX2_FILTER(out, d, n, i, k, v, _mm256_cmpgt_epi32, 1, ones);
+		break;
+	case cu_VECTOR_UINT_GREATER:
+		cu_VECTOR_UINT_AVX2_FILTER(out, d, n, i, k, v, _mm256_cmpgt_epi32, 1, zeros);
+		break;
+	case cu_VECTOR_UINT_GREATER_EQUAL:
+		cu_VECTOR_UINT_AVX2_FILTER(out, d, n, i, k, v, _mm256_cmpgt_epi32, 0, ones);
+		break;
+	case cu_VECTOR_UINT_EQUAL:
+		cu_VECTOR_UINT_AVX2_FILTER(out, d, n, i, k, v, _mm256_cmpeq_epi32, 1, zeros);
+		break;
+	default:
+		cu_VECTOR_UINT_AVX2_FILTER(out, d, n, i, k, v, _mm256_cmpeq_epi32, 1, ones);
+		break;
+	}
+	for (; i< n; i++) {
+		unsigned int match = cu_vector_uint_match(d[i], op, value);
+		if (out)
+			out[k] = d[i];
+		k += match;
+	}
+	return k;
 }
 
-#endif /*cu_vector_uint_h*/
+#endif /* cu_VECTOR_UINT_AVX2 */
 
+#endif /* cu_vector_uint_h */
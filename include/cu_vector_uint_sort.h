@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef cu_vector_uint_sort_h
+#define cu_vector_uint_sort_h 1
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cu_debug.h"
+#include "cu_vector_uint.h"
+
+
+/*
+ * LSD radix sort with 11 bit digits (3 passes over 32 bit keys), passes
+ * in which every key has the same digit are skipped. Small vectors are
+ * insertion sorted.
+ */
+#define cu_VECTOR_UINT_SORT_DIGIT_BITS 11
+#define cu_VECTOR_UINT_SORT_BUCKETS (1 << cu_VECTOR_UINT_SORT_DIGIT_BITS)
+#define cu_VECTOR_UINT_SORT_PASSES 3
+#define cu_VECTOR_UINT_SORT_SMALL (size_t)64
+
+/* the sorted set operations gallop through the bigger vector when it is
+ * at least this many times bigger than the other one */
+#define cu_VECTOR_UINT_GALLOP_RATIO (size_t)32
+
+
+/**
+ * Sorts a vector in increasing order
+ * @v cu_vector_uint to be sorted
+ * @scratch a cu_vector_uint used as temporary buffer, NULL to allocate one
+ *
+ * Passing the same scratch vector to repeated sorts avoids allocating
+ * memory each time. Its contents are left unspecified; v keeps its own
+ * storage and allocator.
+ */
+inline void cu_vector_uint_sort(struct cu_vector_uint* v,
+                                struct cu_vector_uint* scratch);
+
+/**
+ * Removes repeated elements from a sorted vector
+ * @v cu_vector_uint to be used
+ */
+inline void cu_vector_uint_unique(struct cu_vector_uint* v);
+
+/**
+ * Sets dest to the elements both in a and b
+ * @dest cu_vector_uint the result goes to
+ * @a sorted cu_vector_uint without repeated elements
+ * @b sorted cu_vector_uint without repeated elements
+ *
+ * dest must be different from a and b.
+ */
+inline void cu_vector_uint_intersect(struct cu_vector_uint* dest,
+                                     struct cu_vector_uint* a,
+                                     struct cu_vector_uint* b);
+
+/**
+ * Sets dest to the elements in a or b
+ * @dest cu_vector_uint the result goes to
+ * @a sorted cu_vector_uint without repeated elements
+ * @b sorted cu_vector_uint without repeated elements
+ *
+ * dest must be different from a and b.
+ */
+inline void cu_vector_uint_union(struct cu_vector_uint* dest,
+                                 struct cu_vector_uint* a,
+                                 struct cu_vector_uint* b);
+
+/**
+ * Sets dest to the elements in a but not in b
+ * @dest cu_vector_uint the result goes to
+ * @a sorted cu_vector_uint without repeated elements
+ * @b sorted cu_vector_uint without repeated elements
+ *
+ * dest must be different from a and b.
+ */
+inline void cu_vector_uint_difference(struct cu_vector_uint* dest,
+                                      struct cu_vector_uint* a,
+                                      struct cu_vector_uint* b);
+
+
+/* protected api */
+
+/**
+ * Returns the first index at or after from whose element is not less
+ * than value, n if none
+ * @d sorted elements
+ * @from index the search starts from
+ * @n number of elements
+ * @value value to look for
+ *
+ * Probes from, from+1, from+3, from+7, ... then binary searches the last
+ * step, so finding an element k places away costs O(log k).
+ */
+inline size_t cu_vector_uint_gallop(const unsigned int* d,
+                                    size_t from,
+                                    size_t n,
+                                    unsigned int value);
+
+/**
+ * Makes room for n more elements at the back of a vector and returns
+ * where they go
+ */
+inline unsigned int* cu_vector_uint_make_room(struct cu_vector_uint* v,
+                                              size_t n);
+
+
+
+void cu_vector_uint_sort(struct cu_vector_uint* v,
+                         struct cu_vector_uint* scratch)
+{
+	assert(v);
+	assert(v != scratch);
+	size_t n = v->ac.size;
+	unsigned int* d = (unsigned int*)v->ac.mblock.mem;
+
+	if (n <= cu_VECTOR_UINT_SORT_SMALL) {
+		for (size_t i=1; i< n; i++) {
+			unsigned int x = d[i];
+			size_t j = i;
+			for (; j > 0 && d[j-1] > x; j--)
+				d[j] = d[j-1];
+			d[j] = x;
+		}
+		return;
+	}
+
+	struct cu_vector_uint tmp;
+	if (!scratch) {
+		cu_vector_uint_init(&tmp);
+		scratch = &tmp;
+	}
+	cu_array_container_grow_to(&scratch->ac, n);
+	scratch->ac.size = n;
+
+	/* all the histograms in a single read of the keys */
+	size_t count[cu_VECTOR_UINT_SORT_PASSES][cu_VECTOR_UINT_SORT_BUCKETS];
+	memset(count, 0, sizeof(count));
+	for (size_t i=0; i< n; i++)
+		for (unsigned int p=0; p< cu_VECTOR_UINT_SORT_PASSES; p++)
+			count[p][(d[i] >> (p*cu_VECTOR_UINT_SORT_DIGIT_BITS)) & (cu_VECTOR_UINT_SORT_BUCKETS - 1)]++;
+
+	unsigned int* src = d;
+	unsigned int* dst = (unsigned int*)scratch->ac.mblock.mem;
+	for (unsigned int p=0; p< cu_VECTOR_UINT_SORT_PASSES; p++) {
+		unsigned int shift = p*cu_VECTOR_UINT_SORT_DIGIT_BITS;
+		size_t* c = count[p];
+
+		/* every key has the same digit, nothing to do */
+		if (c[(src[0] >> shift) & (cu_VECTOR_UINT_SORT_BUCKETS - 1)] == n)
+			continue;
+
+		size_t sum = 0;
+		for (unsigned int b=0; b< cu_VECTOR_UINT_SORT_BUCKETS; b++) {
+			size_t t = c[b];
+			c[b] = sum;
+			sum += t;
+		}
+		for (size_t i=0; i< n; i++)
+			dst[c[(src[i] >> shift) & (cu_VECTOR_UINT_SORT_BUCKETS - 1)]++] = src[i];
+
+		unsigned int* t = src;
+		src = dst;
+		dst = t;
+	}
+
+	/* an odd number of passes left the keys in scratch, copy them back
+	 * rather than exchanging storage (and allocators) with it */
+	if (src != d)
+		memcpy(d, src, n*sizeof(unsigned int));
+	if (scratch == &tmp)
+		cu_vector_uint_deinit(&tmp);
+}
+
+
+void cu_vector_uint_unique(struct cu_vector_uint* v)
+{
+	assert(v);
+	unsigned int* d = (unsigned int*)v->ac.mblock.mem;
+	size_t k = 0;
+
+	if (!v->ac.size)
+		return;
+	for (size_t i=1; i< v->ac.size; i++) {
+		d[k+1] = d[i];
+		k += d[i] != d[k];
+	}
+	v->ac.size = k + 1;
+}
+
+
+size_t cu_vector_uint_gallop(const unsigned int* d,
+                             size_t from,
+                             size_t n,
+                             unsigned int value)
+{
+	size_t lo = from, step = 1, hi;
+
+	/* d[lo-1] < value (or lo == from) and value <= d[hi] (or hi == n) */
+	while (lo + step - 1 < n && d[lo + step - 1] < value) {
+		lo += step;
+		step *= 2;
+	}
+	hi = lo + step - 1 < n ? lo + step - 1 : n;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo)/2;
+		if (d[mid] < value)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+
+unsigned int* cu_vector_uint_make_room(struct cu_vector_uint* v,
+                                       size_t n)
+{
+	cu_array_container_grow_to(&v->ac, v->ac.size + n);
+	return (unsigned int*)v->ac.mblock.mem + v->ac.size;
+}
+
+
+void cu_vector_uint_intersect(struct cu_vector_uint* dest,
+                              struct cu_vector_uint* a,
+                              struct cu_vector_uint* b)
+{
+	assert(dest);
+	assert(a);
+	assert(b);
+	assert(dest != a && dest != b);
+
+	/* a is the smaller one */
+	if (a->ac.size > b->ac.size) {
+		struct cu_vector_uint* t = a;
+		a = b;
+		b = t;
+	}
+	const unsigned int* x = (const unsigned int*)a->ac.mblock.mem;
+	const unsigned int* y = (const unsigned int*)b->ac.mblock.mem;
+	size_t n = a->ac.size, m = b->ac.size, i = 0, j = 0, k = 0;
+
+	dest->ac.size = 0;
+	unsigned int* out = cu_vector_uint_make_room(dest, n);
+
+	if (n*cu_VECTOR_UINT_GALLOP_RATIO < m) {
+		for (; i< n && j< m; i++) {
+			j = cu_vector_uint_gallop(y, j, m, x[i]);
+			out[k] = x[i];
+			k += j < m && y[j] == x[i];
+		}
+	} else {
+		while (i < n && j < m) {
+			out[k] = x[i];
+			k += x[i] == y[j];
+			unsigned int xi = x[i];
+			i += xi <= y[j];
+			j += y[j] <= xi;
+		}
+	}
+	dest->ac.size = k;
+}
+
+
+void cu_vector_uint_union(struct cu_vector_uint* dest,
+                          struct cu_vector_uint* a,
+                          struct cu_vector_uint* b)
+{
+	assert(dest);
+	assert(a);
+	assert(b);
+	assert(dest != a && dest != b);
+
+	if (a->ac.size > b->ac.size) {
+		struct cu_vector_uint* t = a;
+		a = b;
+		b = t;
+	}
+	const unsigned int* x = (const unsigned int*)a->ac.mblock.mem;
+	const unsigned int* y = (const unsigned int*)b->ac.mblock.mem;
+	size_t n = a->ac.size, m = b->ac.size, i = 0, j = 0, k = 0;
+
+	dest->ac.size = 0;
+	unsigned int* out = cu_vector_uint_make_room(dest, n + m);
+
+	if (n*cu_VECTOR_UINT_GALLOP_RATIO < m) {
+		/* copy the runs of b between the elements of a in one go */
+		for (; i< n; i++) {
+			size_t p = cu_vector_uint_gallop(y, j, m, x[i]);
+			memcpy(out + k, y + j, (p - j)*sizeof(unsigned int));
+			k += p - j;
+			j = p + (p < m && y[p] == x[i]);
+			out[k++] = x[i];
+		}
+	} else {
+		while (i < n && j < m) {
+			unsigned int xi = x[i], yj = y[j];
+			out[k++] = xi < yj ? xi : yj;
+			i += xi <= yj;
+			j += yj <= xi;
+		}
+		memcpy(out + k, x + i, (n - i)*sizeof(unsigned int));
+		k += n - i;
+	}
+	memcpy(out + k, y + j, (m - j)*sizeof(unsigned int));
+	k += m - j;
+	dest->ac.size = k;
+}
+
+
+void cu_vector_uint_difference(struct cu_vector_uint* dest,
+                               struct cu_vector_uint* a,
+                               struct cu_vector_uint* b)
+{
+	assert(dest);
+	assert(a);
+	assert(b);
+	assert(dest != a && dest != b);
+	const unsigned int* x = (const unsigned int*)a->ac.mblock.mem;
+	const unsigned int* y = (const unsigned int*)b->ac.mblock.mem;
+	size_t n = a->ac.size, m = b->ac.size, i = 0, j = 0, k = 0;
+
+	dest->ac.size = 0;
+	unsigned int* out = cu_vector_uint_make_room(dest, n);
+
+	if (n*cu_VECTOR_UINT_GALLOP_RATIO < m) {
+		/* look each element of a up in b */
+		for (; i< n; i++) {
+			j = cu_vector_uint_gallop(y, j, m, x[i]);
+			out[k] = x[i];
+			k += j == m || y[j] != x[i];
+		}
+	} else if (m*cu_VECTOR_UINT_GALLOP_RATIO < n) {
+		/* copy the runs of a between the elements of b in one go */
+		for (; j< m && i< n; j++) {
+			size_t p = cu_vector_uint_gallop(x, i, n, y[j]);
+			memcpy(out + k, x + i, (p - i)*sizeof(unsigned int));
+			k += p - i;
+			i = p + (p < n && x[p] == y[j]);
+		}
+	} else {
+		while (i < n && j < m) {
+			unsigned int xi = x[i], yj = y[j];
+			out[k] = xi;
+			k += xi < yj;
+			i += xi <= yj;
+			j += yj <= xi;
+		}
+	}
+	if (i < n) {
+		memcpy(out + k, x + i, (n - i)*sizeof(unsigned int));
+		k += n - i;
+	}
+	dest->ac.size = k;
+}
+
+#endif /* cu_vector_uint_sort_h */
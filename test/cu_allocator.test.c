@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cu_allocator.h"
+#include "cu_allocator_mmap.h"
+
+/* buil with:  
+   gcc -g -O2 -Wall -o cu_allocator.test -I../include/ cu_allocator.test.c
+*/
+
+#define times (unsigned int) 1000
+//#define VERBOSE
+
+#define PAGE (size_t)4096
+#define THRESHOLD (size_t)(64*1024)
+
+static void fill(unsigned char* p, size_t s, unsigned int seed)
+{
+	size_t i;
+	for (i=0; i<s; i++)
+		p[i] = (unsigned char)(i*31 + seed);
+}
+
+static int check(const unsigned char* p, size_t s, unsigned int seed)
+{
+	size_t i;
+	for (i=0; i<s; i++)
+		if (p[i] != (unsigned char)(i*31 + seed))
+			return 0;
+	return 1;
+}
+
+static int aligned(const void* p, size_t alignment)
+{
+	return !((uintptr_t)p & (alignment - 1));
+}
+
+/* grows a block from below the threshold to several mapped sizes and back */
+static int grow_and_shrink(const struct cu_allocator* a, size_t alignment)
+{
+	static const size_t sizes[] = {
+		100, 4000, THRESHOLD - 1, THRESHOLD, 3*THRESHOLD + 7,
+		5*1024*1024 + 1, 9*1024*1024, THRESHOLD + 1, 1000, 10
+	};
+	unsigned int i, n = sizeof(sizes)/sizeof(sizes[0]);
+	size_t s = sizes[0];
+	unsigned char* p = (unsigned char*)a->alloc(a->ctx, s);
+
+	if (!p || !aligned(p, alignment))
+		return 0;
+	fill(p, s, 7);
+	for (i=1; i<n; i++) {
+		size_t ns = sizes[i];
+		p = (unsigned char*)a->realloc(a->ctx, p, s, ns);
+		if (!p || !aligned(p, alignment))
+			return 0;
+		if (!check(p, s < ns ? s : ns, 7))
+			return 0;
+		fill(p, ns, 7);
+		s = ns;
+	}
+	a->free(a->ctx, p, s);
+	return 1;
+}
+
+int main() {
+	unsigned int i;
+	void* blocks[times];
+	struct cu_allocator page;
+	struct cu_allocator_mmap ma;
+	const struct cu_allocator* a;
+	printf(" * test cu_allocator\n");
+
+	printf(" * heap\n");
+	a = cu_allocator_heap();
+	if (!grow_and_shrink(a, sizeof(void*)))
+		printf(" ! heap realloc failed\n");
+
+	printf(" * cacheline\n");
+	a = cu_allocator_cacheline();
+	for (i=0; i<times; i++) {
+		blocks[i] = a->alloc(a->ctx, i + 1);
+		if (!blocks[i] || !aligned(blocks[i], cu_ALLOCATOR_CACHELINE))
+			printf(" ! cacheline block %u misaligned\n", i);
+	}
+	for (i=0; i<times; i++) {
+		fill((unsigned char*)blocks[i], i + 1, i);
+		blocks[i] = a->realloc(a->ctx, blocks[i], i + 1, 2*i + 100);
+		if (!blocks[i] || !aligned(blocks[i], cu_ALLOCATOR_CACHELINE) ||
+		    !check((unsigned char*)blocks[i], i + 1, i))
+			printf(" ! cacheline realloc %u failed\n", i);
+	}
+	for (i=0; i<times; i++)
+		a->free(a->ctx, blocks[i], 2*i + 100);
+	if (!grow_and_shrink(a, cu_ALLOCATOR_CACHELINE))
+		printf(" ! cacheline realloc failed\n");
+
+	printf(" * aligned to a page\n");
+	cu_allocator_aligned(&page, PAGE);
+	if (!grow_and_shrink(&page, PAGE))
+		printf(" ! page aligned realloc failed\n");
+#ifndef __SANITIZE_ADDRESS__
+	/* a failing realloc must leave the block alone (asan aborts instead
+	   of failing huge allocations) */
+	{
+		unsigned char* p = (unsigned char*)page.alloc(page.ctx, 1000);
+		fill(p, 1000, 3);
+		if (page.realloc(page.ctx, p, 1000, SIZE_MAX - PAGE) || !check(p, 1000, 3))
+			printf(" ! failing realloc lost the block\n");
+		page.free(page.ctx, p, 1000);
+	}
+#endif
+
+	printf(" * mmap\n");
+	cu_allocator_mmap_init(&ma, THRESHOLD, 0);
+	a = cu_allocator_mmap_get(&ma);
+	if (cu_allocator_mmap_length(&ma, 1) != PAGE ||
+	    cu_allocator_mmap_length(&ma, PAGE) != PAGE ||
+	    cu_allocator_mmap_length(&ma, PAGE + 1) != 2*PAGE)
+		printf(" ! mmap length failed\n");
+	/* heap blocks are cache line aligned, mapped ones page aligned */
+	if (!grow_and_shrink(a, cu_ALLOCATOR_CACHELINE))
+		printf(" ! mmap realloc failed\n");
+	for (i=0; i<times; i++) {
+		size_t s = (size_t)(i % 4)*THRESHOLD + i;
+		blocks[i] = a->alloc(a->ctx, s);
+		if (!blocks[i] || !aligned(blocks[i], s < THRESHOLD ?
+		                           cu_ALLOCATOR_CACHELINE : PAGE))
+			printf(" ! mmap block %u misaligned\n", i);
+		fill((unsigned char*)blocks[i], s, i);
+	}
+	for (i=0; i<times; i++) {
+		size_t s = (size_t)(i % 4)*THRESHOLD + i;
+		if (!check((unsigned char*)blocks[i], s, i))
+			printf(" ! mmap block %u corrupted\n", i);
+		a->free(a->ctx, blocks[i], s);
+	}
+
+	printf(" * mmap with the default threshold\n");
+	cu_allocator_mmap_init(&ma, 0, 0);
+	if (ma.threshold != cu_ALLOCATOR_MMAP_DEFAULT_THRESHOLD)
+		printf(" ! mmap default threshold failed\n");
+
+	printf(" * mmap on transparent huge pages\n");
+	cu_allocator_mmap_init(&ma, THRESHOLD, cu_ALLOCATOR_MMAP_THP);
+	a = cu_allocator_mmap_get(&ma);
+	if (cu_allocator_mmap_length(&ma, THRESHOLD) != cu_ALLOCATOR_MMAP_HUGE_PAGE_SIZE)
+		printf(" ! huge page length failed\n");
+	if (!grow_and_shrink(a, cu_ALLOCATOR_CACHELINE))
+		printf(" ! THP realloc failed\n");
+
+	printf(" * mmap on hugetlb pages (or the fallback)\n");
+	/* with no huge pages reserved MAP_HUGETLB fails and a normal mapping
+	   is used instead, either way blocks must work */
+	cu_allocator_mmap_init(&ma, THRESHOLD, cu_ALLOCATOR_MMAP_HUGETLB);
+	a = cu_allocator_mmap_get(&ma);
+	if (!grow_and_shrink(a, cu_ALLOCATOR_CACHELINE))
+		printf(" ! hugetlb realloc failed\n");
+	return 0;
+}
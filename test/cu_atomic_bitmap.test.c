@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "cu_atomic_bitmap.h"
+
+/* buil with:  
+   gcc -g -O2 -Wall -pthread -o cu_atomic_bitmap.test -I../include/ cu_atomic_bitmap.test.c
+*/
+
+#define times (size_t) 1000003
+#define THREADS 4
+//#define VERBOSE
+
+static struct cu_atomic_bitmap bm;
+static _Atomic unsigned char claims[times];
+static unsigned char owner[times];
+
+
+/* claims bits until the bitmap is full */
+static void* claimer(void* arg)
+{
+	size_t slot = (size_t)(uintptr_t)arg, at;
+	size_t hint = slot*(times/THREADS/cu_ATOMIC_BITMAP_LINE_BITS)*cu_ATOMIC_BITMAP_LINE_BITS;
+
+	while ((at = cu_atomic_bitmap_claim_first_zero(&bm, hint)) < times) {
+		atomic_fetch_add(&claims[at], 1);
+		owner[at] = (unsigned char)slot;
+		hint = at;
+	}
+	return NULL;
+}
+
+
+/* gives back the even bits the thread owns */
+static void* releaser(void* arg)
+{
+	size_t slot = (size_t)(uintptr_t)arg, at;
+	for (at=0; at< times; at+= 2)
+		if (owner[at] == slot && !cu_atomic_bitmap_test_and_clear(&bm, at))
+			printf(" ! released a cleared bit at place %zu\n", at);
+	return NULL;
+}
+
+
+static void run(void* (*fn)(void*))
+{
+	pthread_t threads[THREADS];
+	size_t i;
+	for (i=0; i< THREADS; i++)
+		pthread_create(&threads[i], NULL, fn, (void*)(uintptr_t)i);
+	for (i=0; i< THREADS; i++)
+		pthread_join(threads[i], NULL);
+}
+
+
+int main() {
+	struct cu_bitmap copy;
+	size_t i;
+	printf(" * test cu_atomic_bitmap\n");
+
+	cu_atomic_bitmap_init(&bm, times);
+	if ((uintptr_t)bm.mblock.mem % 64)
+		printf(" ! words not cache line aligned\n");
+
+	printf(" * claim with %d threads\n", THREADS);
+	run(claimer);
+	for (i=0; i< times; i++)
+		if (claims[i] != 1) {
+			printf(" ! bit %zu claimed %u times\n", i, claims[i]);
+			break;
+		}
+	if (cu_atomic_bitmap_claim_first_zero(&bm, 0) != times)
+		printf(" ! claimed a bit of a full bitmap\n");
+
+	printf(" * release and claim again\n");
+	run(releaser);
+	run(claimer);
+	for (i=0; i< times; i++)
+		if (claims[i] != 1 + (i % 2 == 0) || !cu_atomic_bitmap_get_bit(&bm, i)) {
+			printf(" ! bit %zu claimed %u times\n", i, claims[i]);
+			break;
+		}
+
+	cu_bitmap_init(&copy, times);
+	cu_atomic_bitmap_to_bitmap(&copy, &bm);
+	if (cu_bitmap_popcount(&copy) != times)
+		printf(" ! to_bitmap failed\n");
+	cu_bitmap_deinit(&copy);
+	cu_atomic_bitmap_deinit(&bm);
+	return 0;
+}
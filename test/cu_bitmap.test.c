@@ -36,15 +36,31 @@
 //#define BENCH_STD
 
 #define BENCH_SEQ_ACCESS
+#define BENCH_BULK_OPS
+#define BENCH_FIND
+#define BENCH_RANGE
+#define BENCH_RANK
 
 #ifdef BENCH_LIBSB
 #include "cu_bitmap.h"
+#include "cu_bitmap_rank.h"
 #endif
 
 #ifdef BENCH_STD
 #include <vector>
 #endif
 
+#ifdef BENCH_FIND
+static void count_set(size_t at, void* data)
+{
+	unsigned int* last = (unsigned int*)data;
+	if (!(at & 0x0101) || (last[1] && at <= last[0]))
+		printf(" ! foreach_set visited bad place %zu\n", at);
+	last[0] = at;
+	last[1]++;
+}
+#endif
+
 int main() {
 	unsigned int i;
 	printf(" * test cu_bitmap\n");
@@ -53,6 +69,7 @@ int main() {
 	printf(" * build cu_bitmap\n");
 	struct cu_bitmap bitmap;
 	cu_bitmap_init(&bitmap, times);
+	cu_bitmap_clear(&bitmap);
 	for (i=0; i<times; i++)
 		if (i & 0x0101) cu_bitmap_set_bit(&bitmap, i);
 #endif
@@ -84,6 +101,144 @@ int main() {
 #endif
 
 
+#ifdef BENCH_BULK_OPS
+#ifdef BENCH_LIBSB
+	printf(" * check bulk ops\n");
+	{
+		struct cu_bitmap other, res;
+		unsigned int count = 0;
+		cu_bitmap_init(&other, times);
+		cu_bitmap_init(&res, times);
+		cu_bitmap_clear(&other);
+		for (i=0; i<times; i++)
+			if (i % 3 == 0) cu_bitmap_set_bit(&other, i);
+
+		cu_bitmap_and(&res, &bitmap, &other);
+		for (i=0; i<times; i++)
+			if (cu_bitmap_get_bit(&res, i) != ((i & 0x0101) && i % 3 == 0))
+				printf(" ! and failed at place %d\n", i);
+
+		cu_bitmap_or(&res, &bitmap, &other);
+		for (i=0; i<times; i++)
+			if (cu_bitmap_get_bit(&res, i) != ((i & 0x0101) || i % 3 == 0))
+				printf(" ! or failed at place %d\n", i);
+
+		cu_bitmap_xor(&res, &bitmap, &other);
+		for (i=0; i<times; i++)
+			if (cu_bitmap_get_bit(&res, i) != (!(i & 0x0101) != !(i % 3 == 0)))
+				printf(" ! xor failed at place %d\n", i);
+
+		cu_bitmap_andnot(&res, &bitmap, &other);
+		for (i=0; i<times; i++) {
+			if (cu_bitmap_get_bit(&res, i) != ((i & 0x0101) && i % 3 != 0))
+				printf(" ! andnot failed at place %d\n", i);
+			count += ((i & 0x0101) && i % 3 != 0);
+		}
+		if (cu_bitmap_popcount(&res) != count)
+			printf(" ! popcount failed, %zu instead of %u\n", cu_bitmap_popcount(&res), count);
+
+		cu_bitmap_not(&res, &res);
+		if (cu_bitmap_popcount(&res) != times - count)
+			printf(" ! not failed, %zu bits set\n", cu_bitmap_popcount(&res));
+
+		cu_bitmap_deinit(&other);
+		cu_bitmap_deinit(&res);
+	}
+#endif
+#endif
+
+
+#ifdef BENCH_FIND
+#ifdef BENCH_LIBSB
+	printf(" * check find\n");
+	{
+		unsigned int at, last[2] = {0, 0}, count = 0;
+		for (at = cu_bitmap_find_first_set(&bitmap); at < times;
+		     at = cu_bitmap_find_next_set(&bitmap, at+1)) {
+			if (!(at & 0x0101))
+				printf(" ! find_next_set returned bad place %d\n", at);
+			count++;
+		}
+		if (count != cu_bitmap_popcount(&bitmap))
+			printf(" ! find_next_set found %u bits\n", count);
+
+		count = 0;
+		for (at = cu_bitmap_find_first_zero(&bitmap); at < times;
+		     at = cu_bitmap_find_next_zero(&bitmap, at+1)) {
+			if (at & 0x0101)
+				printf(" ! find_next_zero returned bad place %d\n", at);
+			count++;
+		}
+		if (count != times - cu_bitmap_popcount(&bitmap))
+			printf(" ! find_next_zero found %u bits\n", count);
+
+		cu_bitmap_foreach_set(&bitmap, count_set, last);
+		if (last[1] != cu_bitmap_popcount(&bitmap))
+			printf(" ! foreach_set visited %u bits\n", last[1]);
+	}
+#endif
+#endif
+
+
+#ifdef BENCH_RANK
+#ifdef BENCH_LIBSB
+	printf(" * check rank/select\n");
+	{
+		struct cu_bitmap_rank rs;
+		unsigned int rank = 0;
+		cu_bitmap_rank_init(&rs, &bitmap);
+		if (cu_bitmap_rank_count(&rs) != cu_bitmap_popcount(&bitmap))
+			printf(" ! rank count differs\n");
+		for (i=0; i<times; i++) {
+			if (cu_bitmap_rank(&rs, i) != rank)
+				printf(" ! rank failed at place %d\n", i);
+			if (cu_bitmap_get_bit(&bitmap, i)) {
+				if (cu_bitmap_select(&rs, rank) != i)
+					printf(" ! select failed for %d\n", rank);
+				rank++;
+			}
+		}
+		if (cu_bitmap_rank(&rs, times) != rank || cu_bitmap_select(&rs, rank) != times)
+			printf(" ! rank/select failed at the end\n");
+		cu_bitmap_rank_deinit(&rs);
+	}
+#endif
+#endif
+
+
+#ifdef BENCH_RANGE
+#ifdef BENCH_LIBSB
+	printf(" * check ranges\n");
+	{
+		struct cu_bitmap range;
+		unsigned int from, len;
+		cu_bitmap_init(&range, 1000);
+		for (from = 0; from < 1000; from += 37)
+			for (len = 0; from + len <= 1000; len += 13) {
+				cu_bitmap_clear(&range);
+				cu_bitmap_set_range(&range, from, len);
+				if (cu_bitmap_popcount(&range) != len
+				    || !cu_bitmap_test_range_all(&range, from, len)
+				    || (len && !cu_bitmap_test_range_any(&range, from, len))
+				    || cu_bitmap_test_range_any(&range, 0, from)
+				    || cu_bitmap_test_range_any(&range, from + len, 1000 - from - len))
+					printf(" ! set_range failed at %d, %d\n", from, len);
+
+				cu_bitmap_set_range(&range, 0, 1000);
+				cu_bitmap_clear_range(&range, from, len);
+				if (cu_bitmap_popcount(&range) != 1000 - len
+				    || cu_bitmap_test_range_any(&range, from, len)
+				    || (len && cu_bitmap_test_range_all(&range, from, len))
+				    || !cu_bitmap_test_range_all(&range, 0, from)
+				    || !cu_bitmap_test_range_all(&range, from + len, 1000 - from - len))
+					printf(" ! clear_range failed at %d, %d\n", from, len);
+			}
+		cu_bitmap_deinit(&range);
+	}
+#endif
+#endif
+
+
 #ifdef BENCH_LIBSB
 	cu_bitmap_deinit(&bitmap);
 #endif
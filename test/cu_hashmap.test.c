@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "cu_hashmap_uint.h"
+#include "cu_hashmap_ptr.h"
+
+/* buil with:  
+   gcc -g -O2 -Wall -o cu_hashmap.test -I../include/ cu_hashmap.test.c
+*/
+
+#define times (unsigned int) 4000000
+//#define VERBOSE
+
+static void sum_values(unsigned int key, unsigned int* value, void* data)
+{
+	*(unsigned long long*)data += key ^ *value;
+}
+
+int main() {
+	unsigned int i, value, found;
+	unsigned long long sum, expected;
+	struct cu_hashmap_uint m;
+	struct cu_hashmap_ptr p;
+	clock_t start;
+	printf(" * test cu_hashmap\n");
+
+	cu_hashmap_uint_init(&m);
+
+	printf(" * put\n");
+	start = clock();
+	for (i=0; i<times; i++)
+		if (!cu_hashmap_uint_put(&m, i*2654435761u, i))
+			printf(" ! put failed at place %d\n", i);
+	if (cu_hashmap_uint_put(&m, 0, 42) || cu_hashmap_uint_size(&m) != times)
+		printf(" ! put replaced a key badly\n");
+	cu_hashmap_uint_put(&m, 0, 0);
+	printf("   %f secs\n", (double)(clock() - start)/CLOCKS_PER_SEC);
+
+	printf(" * find\n");
+	start = clock();
+	found = 0;
+	for (i=0; i<times*2; i++) {
+		unsigned int* v = cu_hashmap_uint_find(&m, i*2654435761u);
+		if (v) {
+			found ++;
+			if (*v != i)
+				printf(" ! find failed at place %d\n", i);
+		}
+	}
+	if (found != times)
+		printf(" ! find found %u keys instead of %u\n", found, times);
+	printf("   %f secs\n", (double)(clock() - start)/CLOCKS_PER_SEC);
+
+	printf(" * erase\n");
+	for (i=0; i<times; i+= 2)
+		if (!cu_hashmap_uint_erase(&m, i*2654435761u))
+			printf(" ! erase failed at place %d\n", i);
+	if (cu_hashmap_uint_erase(&m, 0) || cu_hashmap_uint_size(&m) != times/2)
+		printf(" ! erase removed a missing key\n");
+	for (i=0; i<times; i++)
+		if (cu_hashmap_uint_get(&m, i*2654435761u, &value) != (int)(i & 1)
+		    || ((i & 1) && value != i)) {
+			printf(" ! get failed at place %d\n", i);
+			break;
+		}
+	/* churn: the table must reuse its tombstones instead of growing */
+	size_t capacity = m.capacity;
+	for (i=0; i<times*4; i++) {
+		cu_hashmap_uint_put(&m, (times + i)*2654435761u, i);
+		cu_hashmap_uint_erase(&m, (times + i)*2654435761u);
+	}
+	if (m.capacity != capacity || cu_hashmap_uint_size(&m) != times/2)
+		printf(" ! churn grew the table to %zu slots\n", m.capacity);
+
+	printf(" * foreach\n");
+	sum = 0;
+	expected = 0;
+	cu_hashmap_uint_foreach(&m, sum_values, &sum);
+	for (i=1; i<times; i+= 2)
+		expected += (i*2654435761u) ^ i;
+	if (sum != expected)
+		printf(" ! foreach failed\n");
+
+	cu_hashmap_uint_clear(&m);
+	cu_hashmap_uint_reserve(&m, 1000);
+	if (cu_hashmap_uint_size(&m) || cu_hashmap_uint_find(&m, 2654435761u))
+		printf(" ! clear failed\n");
+	cu_hashmap_uint_deinit(&m);
+
+	printf(" * pointer keys\n");
+	cu_hashmap_ptr_init(&p);
+	unsigned int* keys = (unsigned int*)malloc(times*sizeof(unsigned int));
+	for (i=0; i<times; i++)
+		cu_hashmap_ptr_put(&p, keys + i, keys + times - 1 - i);
+	for (i=0; i<times; i++)
+		if (!cu_hashmap_ptr_find(&p, keys + i)
+		    || *cu_hashmap_ptr_find(&p, keys + i) != keys + times - 1 - i) {
+			printf(" ! ptr find failed at place %d\n", i);
+			break;
+		}
+	free(keys);
+	cu_hashmap_ptr_deinit(&p);
+	return 0;
+}
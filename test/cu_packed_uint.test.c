@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "cu_vector_uint.h"
+#include "cu_packed_uint.h"
+
+/* buil with:  
+   gcc -g -O2 -Wall -o cu_packed_uint.test -I../include/ cu_packed_uint.test.c
+*/
+
+#define times (unsigned int) 10000003
+//#define VERBOSE
+
+static void check(struct cu_packed_uint* p, struct cu_vector_uint* v, const char* what)
+{
+	struct cu_vector_uint out;
+	unsigned int i;
+
+	if (cu_packed_uint_size(p) != cu_vector_uint_size(v))
+		printf(" ! %s: size %zu instead of %zu\n", what,
+		       cu_packed_uint_size(p), cu_vector_uint_size(v));
+	for (i=0; i<times; i+= 7)
+		if (cu_packed_uint_at(p, i) != cu_vector_uint_at(v, i)) {
+			printf(" ! %s: at failed at place %d\n", what, i);
+			break;
+		}
+
+	cu_vector_uint_init(&out);
+	cu_vector_uint_push_back(&out, 42);
+	cu_packed_uint_decode(p, &out);
+	if (cu_vector_uint_size(&out) != times + 1 || cu_vector_uint_at(&out, 0) != 42
+	    || memcmp(cu_vector_uint_data(&out) + 1, cu_vector_uint_data(v), times*sizeof(unsigned int)))
+		printf(" ! %s: decode failed\n", what);
+	cu_vector_uint_deinit(&out);
+#ifdef VERBOSE
+	printf("   %zu bytes instead of %zu\n", cu_packed_uint_memory_usage(p),
+	       cu_vector_uint_size(v)*sizeof(unsigned int));
+#endif
+}
+
+int main() {
+	unsigned int i, seed = 1, value = 0;
+	struct cu_vector_uint v;
+	struct cu_packed_uint p;
+	printf(" * test cu_packed_uint\n");
+
+	cu_vector_uint_init(&v);
+	cu_packed_uint_init(&p);
+
+	printf(" * sorted values, delta encoded\n");
+	for (i=0; i<times; i++) {
+		seed = seed*1103515245 + 12345;
+		/* mostly small gaps, a few big jumps */
+		value += (seed >> 16) % 64 == 0 ? (seed >> 20) : (seed >> 16) % 20;
+		cu_vector_uint_push_back(&v, value);
+	}
+	cu_packed_uint_from_vector(&p, &v, cu_PACKED_UINT_DELTA);
+	check(&p, &v, "delta");
+
+	printf(" * lower_bound\n");
+	for (i=0; i<times; i+= 1009) {
+		unsigned int x = cu_vector_uint_at(&v, i);
+		if (cu_packed_uint_lower_bound(&p, x) != cu_vector_uint_lower_bound(&v, x)
+		    || cu_packed_uint_lower_bound(&p, x + 1) != cu_vector_uint_lower_bound(&v, x + 1))
+			printf(" ! lower_bound failed at place %d\n", i);
+	}
+	if (cu_packed_uint_lower_bound(&p, 0) != 0 || cu_packed_uint_lower_bound(&p, ~0u) != times)
+		printf(" ! lower_bound failed at the ends\n");
+
+	printf(" * small range values, frame of reference encoded\n");
+	cu_vector_uint_clear(&v);
+	for (i=0; i<times; i++) {
+		seed = seed*1103515245 + 12345;
+		cu_vector_uint_push_back(&v, 3000000000u + (seed >> 8) % (i % 1000 ? 1000 : 100000));
+	}
+	cu_packed_uint_from_vector(&p, &v, cu_PACKED_UINT_FOR);
+	check(&p, &v, "for");
+
+	cu_packed_uint_deinit(&p);
+	cu_vector_uint_deinit(&v);
+	return 0;
+}
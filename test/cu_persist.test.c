@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "cu_vector_uint.h"
+#include "cu_bitmap.h"
+#include "cu_persist.h"
+
+/* buil with:  
+   gcc -g -O2 -Wall -o cu_persist.test -I../include/ cu_persist.test.c
+*/
+
+#define times (unsigned int) 5000000
+#define VECTOR_FILE "/tmp/cu_persist.test.vector"
+#define BITMAP_FILE "/tmp/cu_persist.test.bitmap"
+//#define VERBOSE
+
+cu_VECTOR_DECLARE(double, double);
+cu_VECTOR_DEFINE(double, double)
+
+int main() {
+	unsigned int i;
+	struct cu_persist_file f;
+	struct cu_vector_uint v, mapped;
+	struct cu_vector_double dv;
+	struct cu_bitmap bm, mbm;
+	printf(" * test cu_persist\n");
+
+	printf(" * save and map a vector\n");
+	cu_vector_uint_init(&v);
+	for (i=0; i<times; i++)
+		cu_vector_uint_push_back(&v, i*3);
+	if (cu_persist_save_vector(VECTOR_FILE, &v.ac))
+		printf(" ! save_vector failed\n");
+	if (cu_persist_open_vector(&f, &mapped.ac, VECTOR_FILE, sizeof(unsigned int), cu_PERSIST_READ_ONLY))
+		printf(" ! open_vector failed\n");
+	else {
+		if (cu_vector_uint_size(&mapped) != times
+		    || memcmp(cu_vector_uint_data(&mapped), cu_vector_uint_data(&v), times*sizeof(unsigned int)))
+			printf(" ! mapped vector differs\n");
+		cu_vector_uint_deinit(&mapped);
+	}
+	cu_vector_uint_deinit(&v);
+
+	printf(" * reject a mismatching file\n");
+	if (!cu_persist_open_vector(&f, &dv.ac, VECTOR_FILE, sizeof(double), cu_PERSIST_READ_ONLY))
+		printf(" ! opened a vector of uints as doubles\n");
+
+	printf(" * file backed vector\n");
+	if (cu_persist_open_vector(&f, &dv.ac, VECTOR_FILE, sizeof(double),
+	                           cu_PERSIST_WRITE | cu_PERSIST_CREATE))
+		printf(" ! create failed\n");
+	else {
+		for (i=0; i<times; i++)
+			cu_vector_double_push_back(&dv, i*0.5);
+		cu_vector_double_shrink_to_fit(&dv);
+		cu_persist_sync_vector(&f, &dv.ac);
+		cu_vector_double_deinit(&dv);
+	}
+	if (cu_persist_open_vector(&f, &dv.ac, VECTOR_FILE, sizeof(double), cu_PERSIST_WRITE))
+		printf(" ! reopen failed\n");
+	else {
+		for (i=0; i<times; i++)
+			if (cu_vector_double_at(&dv, i) != i*0.5) {
+				printf(" ! file backed vector differs at place %d\n", i);
+				break;
+			}
+		/* keep growing it */
+		cu_vector_double_push_back(&dv, -1);
+		cu_persist_sync_vector(&f, &dv.ac);
+		cu_vector_double_deinit(&dv);
+	}
+	if (cu_persist_open_vector(&f, &dv.ac, VECTOR_FILE, sizeof(double), cu_PERSIST_READ_ONLY)
+	    || cu_vector_double_size(&dv) != times + 1 || cu_vector_double_at(&dv, times) != -1)
+		printf(" ! reopened vector differs\n");
+	else
+		cu_vector_double_deinit(&dv);
+
+	printf(" * save and map a bitmap\n");
+	cu_bitmap_init(&bm, times);
+	cu_bitmap_clear(&bm);
+	for (i=0; i<times; i+= 7)
+		cu_bitmap_set_bit(&bm, i);
+	if (cu_persist_save_bitmap(BITMAP_FILE, &bm))
+		printf(" ! save_bitmap failed\n");
+	if (cu_persist_open_bitmap(&f, &mbm, BITMAP_FILE, cu_PERSIST_WRITE))
+		printf(" ! open_bitmap failed\n");
+	else {
+		if (cu_bitmap_size(&mbm) != times || cu_bitmap_popcount(&mbm) != cu_bitmap_popcount(&bm))
+			printf(" ! mapped bitmap differs\n");
+		cu_bitmap_set_bit(&mbm, 1);
+		cu_persist_sync(&f);
+		cu_bitmap_deinit(&mbm);
+	}
+	if (cu_persist_open_bitmap(&f, &mbm, BITMAP_FILE, cu_PERSIST_READ_ONLY)
+	    || !cu_bitmap_get_bit(&mbm, 1) || cu_bitmap_popcount(&mbm) != cu_bitmap_popcount(&bm) + 1)
+		printf(" ! bitmap changes were not written\n");
+	else
+		cu_bitmap_deinit(&mbm);
+	cu_bitmap_deinit(&bm);
+
+	unlink(VECTOR_FILE);
+	unlink(BITMAP_FILE);
+	return 0;
+}
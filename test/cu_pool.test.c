@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cu_pool.h"
+
+/* buil with:  
+   gcc -g -O2 -Wall -o cu_pool.test -I../include/ cu_pool.test.c
+*/
+
+#define times (unsigned int) 1000000
+//#define VERBOSE
+
+struct node {
+	unsigned int key;
+	void* next;
+};
+
+static void sum_keys(void* obj, void* data)
+{
+	*(unsigned long long*)data += ((struct node*)obj)->key;
+}
+
+static void free_odd(void* obj, void* data)
+{
+	struct cu_pool* p = (struct cu_pool*)data;
+	if (((struct node*)obj)->key & 1)
+		cu_pool_free(p, obj);
+}
+
+int main() {
+	unsigned int i;
+	unsigned long long sum, expected;
+	struct cu_pool p, q;
+	struct node** nodes;
+	printf(" * test cu_pool\n");
+
+	cu_pool_init(&p, sizeof(struct node), 0);
+	nodes = (struct node**)malloc(times*sizeof(struct node*));
+
+	printf(" * alloc\n");
+	for (i=0; i<times; i++) {
+		nodes[i] = (struct node*)cu_pool_alloc(&p);
+		/* objects are fully writable, whatever the pool keeps next to them */
+		memset(nodes[i], 0xff, sizeof(struct node));
+		nodes[i]->key = i;
+	}
+	if (cu_pool_size(&p) != times)
+		printf(" ! alloc failed\n");
+
+	printf(" * foreach\n");
+	sum = 0;
+	expected = (unsigned long long)times*(times - 1)/2;
+	cu_pool_foreach(&p, sum_keys, &sum);
+	if (sum != expected)
+		printf(" ! foreach failed\n");
+
+	printf(" * free inside foreach\n");
+	cu_pool_foreach(&p, free_odd, &p);
+	sum = 0;
+	cu_pool_foreach(&p, sum_keys, &sum);
+	expected = 0;
+	for (i=0; i<times; i+= 2)
+		expected += i;
+	if (cu_pool_size(&p) != times/2 || sum != expected)
+		printf(" ! free inside foreach failed\n");
+
+	printf(" * free and reuse\n");
+	for (i=0; i<times; i+= 4)
+		cu_pool_free(&p, nodes[i]);
+	for (i=0; i<times; i+= 4) {
+		struct node* n = (struct node*)cu_pool_alloc(&p);
+		n->key = 1;
+		nodes[i] = n;
+	}
+	sum = 0;
+	cu_pool_foreach(&p, sum_keys, &sum);
+	expected = 0;
+	for (i=0; i<times; i+= 2)
+		expected += i % 4 ? i : 1;
+	if (cu_pool_size(&p) != times/2 || sum != expected)
+		printf(" ! free and reuse failed\n");
+
+	printf(" * clear\n");
+	cu_pool_clear(&p);
+	sum = 0;
+	cu_pool_foreach(&p, sum_keys, &sum);
+	if (cu_pool_size(&p) || sum)
+		printf(" ! clear failed\n");
+	size_t slabs = p.slabs.size;
+	for (i=0; i<times; i++)
+		cu_pool_alloc(&p);
+	if (cu_pool_size(&p) != times || p.slabs.size != slabs)
+		printf(" ! clear didn't reuse the slabs\n");
+	free(nodes);
+	cu_pool_deinit(&p);
+
+	printf(" * big objects\n");
+	/* a slab over 4GB, its size must not wrap */
+	cu_pool_init(&q, 70000, 65536);
+	char* obj = (char*)cu_pool_alloc(&q);
+	memset(obj, 1, 70000);
+	cu_pool_free(&q, obj);
+	cu_pool_deinit(&q);
+	return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "cu_ring.h"
+
+/* buil with:  
+   gcc -g -O2 -Wall -pthread -o cu_ring.test -I../include/ cu_ring.test.c
+*/
+
+#define times (size_t) 20000000
+#define THREADS 4
+#define BATCH 32
+//#define VERBOSE
+
+static struct cu_ring_spsc spsc;
+static struct cu_ring_mpmc mpmc;
+static _Atomic size_t popped_sum;
+
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+
+static void* spsc_producer(void* arg)
+{
+	void* items[BATCH];
+	size_t i = 1, k;
+	(void)arg;
+	while (i <= times) {
+		/* half the items go one by one, half in batches */
+		if (i < times/2) {
+			while (!cu_ring_spsc_push(&spsc, (void*)(uintptr_t)i))
+				sched_yield();
+			i ++;
+			continue;
+		}
+		size_t n = times + 1 - i < BATCH ? times + 1 - i : BATCH;
+		for (k=0; k< n; k++)
+			items[k] = (void*)(uintptr_t)(i + k);
+		for (k=0; k< n; ) {
+			size_t pushed = cu_ring_spsc_push_batch(&spsc, items + k, n - k);
+			if (!pushed)
+				sched_yield();
+			k += pushed;
+		}
+		i += n;
+	}
+	return NULL;
+}
+
+
+static void* mpmc_producer(void* arg)
+{
+	void* items[BATCH];
+	size_t first = (size_t)(uintptr_t)arg, i, k;
+	for (i=first; i< times; i+= THREADS*BATCH) {
+		size_t n = 0;
+		for (k=i; k< i + THREADS*BATCH && k< times; k+= THREADS)
+			items[n++] = (void*)(uintptr_t)(k + 1);
+		for (k=0; k< n; ) {
+			size_t pushed = cu_ring_mpmc_push_batch(&mpmc, items + k, n - k);
+			if (!pushed)
+				sched_yield();
+			k += pushed;
+		}
+	}
+	return NULL;
+}
+
+
+static void* mpmc_consumer(void* arg)
+{
+	void* items[BATCH];
+	size_t count = 0, sum = 0, k, n;
+	(void)arg;
+	while (count < times/THREADS) {
+		n = times/THREADS - count < BATCH ? times/THREADS - count : BATCH;
+		if (count & 1)
+			n = cu_ring_mpmc_pop(&mpmc, items);
+		else
+			n = cu_ring_mpmc_pop_batch(&mpmc, items, n);
+		if (!n)
+			sched_yield();
+		for (k=0; k< n; k++)
+			sum += (size_t)(uintptr_t)items[k];
+		count += n;
+	}
+	atomic_fetch_add(&popped_sum, sum);
+	return NULL;
+}
+
+
+int main() {
+	pthread_t producers[THREADS], consumers[THREADS];
+	void* item;
+	size_t i, expected = 0;
+	double start;
+	printf(" * test cu_ring\n");
+
+	printf(" * spsc single thread\n");
+	cu_ring_spsc_init(&spsc, 100);
+	if (cu_ring_spsc_capacity(&spsc) != 128 || cu_ring_spsc_pop(&spsc, &item))
+		printf(" ! spsc init failed\n");
+	for (i=0; i< 128; i++)
+		cu_ring_spsc_push(&spsc, (void*)(uintptr_t)i);
+	if (cu_ring_spsc_push(&spsc, NULL) || cu_ring_spsc_size(&spsc) != 128)
+		printf(" ! spsc push on a full queue\n");
+	for (i=0; i< 128; i++)
+		if (!cu_ring_spsc_pop(&spsc, &item) || item != (void*)(uintptr_t)i)
+			printf(" ! spsc pop failed at place %zu\n", i);
+
+	printf(" * spsc two threads\n");
+	start = now();
+	pthread_create(&producers[0], NULL, spsc_producer, NULL);
+	for (i=1; i<= times; ) {
+		void* items[BATCH];
+		size_t n = cu_ring_spsc_pop_batch(&spsc, items, BATCH);
+		if (!n)
+			sched_yield();
+		for (size_t k=0; k< n; k++, i++)
+			if (items[k] != (void*)(uintptr_t)i) {
+				printf(" ! spsc order failed at place %zu\n", i);
+				i = times + 1;
+				break;
+			}
+	}
+	pthread_join(producers[0], NULL);
+	printf("   %.1f M items/s\n", times/(now() - start)/1e6);
+	cu_ring_spsc_deinit(&spsc);
+
+	printf(" * mpmc single thread\n");
+	cu_ring_mpmc_init(&mpmc, 1000);
+	for (i=0; i< 1024; i++)
+		cu_ring_mpmc_push(&mpmc, (void*)(uintptr_t)i);
+	if (cu_ring_mpmc_push(&mpmc, NULL) || cu_ring_mpmc_size(&mpmc) != 1024)
+		printf(" ! mpmc push on a full queue\n");
+	for (i=0; i< 1024; i++)
+		if (!cu_ring_mpmc_pop(&mpmc, &item) || item != (void*)(uintptr_t)i)
+			printf(" ! mpmc pop failed at place %zu\n", i);
+	if (cu_ring_mpmc_pop(&mpmc, &item))
+		printf(" ! mpmc pop on an empty queue\n");
+
+	printf(" * mpmc %d producers, %d consumers\n", THREADS, THREADS);
+	start = now();
+	for (i=0; i< THREADS; i++) {
+		pthread_create(&producers[i], NULL, mpmc_producer, (void*)(uintptr_t)i);
+		pthread_create(&consumers[i], NULL, mpmc_consumer, NULL);
+	}
+	for (i=0; i< THREADS; i++) {
+		pthread_join(producers[i], NULL);
+		pthread_join(consumers[i], NULL);
+	}
+	printf("   %.1f M items/s\n", times/(now() - start)/1e6);
+	for (i=1; i<= times; i++)
+		expected += i;
+	if (atomic_load(&popped_sum) != expected || cu_ring_mpmc_size(&mpmc))
+		printf(" ! mpmc lost or duplicated items\n");
+	cu_ring_mpmc_deinit(&mpmc);
+	return 0;
+}
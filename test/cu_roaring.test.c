@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "cu_bitmap.h"
+#include "cu_roaring.h"
+
+/* buil with:  
+   gcc -g -O2 -Wall -o cu_roaring.test -I../include/ cu_roaring.test.c
+*/
+
+#define times (unsigned int) 8000000
+//#define VERBOSE
+
+/* sparse values, a few dense chunks and some long runs */
+static unsigned int pattern_a(unsigned int i)
+{
+	return (i % 7919 == 0) || (i >= 1000000 && i < 1100000 && i % 3)
+		|| (i >= 5000000 && i < 5600000);
+}
+
+static unsigned int pattern_b(unsigned int i)
+{
+	return (i % 4099 == 0) || (i >= 1050000 && i < 1200000 && i % 5)
+		|| (i >= 5500000 && i < 5500100);
+}
+
+static void check(struct cu_roaring* r, struct cu_bitmap* bm, const char* what)
+{
+	unsigned int i;
+	if (cu_roaring_cardinality(r) != cu_bitmap_popcount(bm))
+		printf(" ! %s: cardinality %lu instead of %zu\n", what,
+		       cu_roaring_cardinality(r), cu_bitmap_popcount(bm));
+	for (i=0; i<times; i++)
+		if (cu_roaring_get_bit(r, i) != cu_bitmap_get_bit(bm, i)) {
+			printf(" ! %s: bit has bad value at place %d\n", what, i);
+			break;
+		}
+}
+
+int main() {
+	unsigned int i;
+	struct cu_roaring a, b, res;
+	struct cu_bitmap bma, bmb, bmres;
+	printf(" * test cu_roaring\n");
+
+	cu_roaring_init(&a);
+	cu_roaring_init(&b);
+	cu_roaring_init(&res);
+	cu_bitmap_init(&bma, times);
+	cu_bitmap_init(&bmb, times);
+	cu_bitmap_init(&bmres, times);
+	cu_bitmap_clear(&bma);
+	cu_bitmap_clear(&bmb);
+
+	printf(" * set_bit\n");
+	for (i=0; i<times; i++) {
+		if (pattern_a(i)) {
+			cu_roaring_set_bit(&a, i);
+			cu_bitmap_set_bit(&bma, i);
+		}
+		if (pattern_b(i)) {
+			cu_roaring_set_bit(&b, i);
+			cu_bitmap_set_bit(&bmb, i);
+		}
+	}
+	check(&a, &bma, "set_bit");
+	check(&b, &bmb, "set_bit");
+
+	printf(" * optimize\n");
+	cu_roaring_optimize(&a);
+	check(&a, &bma, "optimize");
+#ifdef VERBOSE
+	printf("   %lu bytes instead of %zu\n", cu_roaring_memory_usage(&a), bma.mblock.size);
+#endif
+
+	printf(" * or\n");
+	cu_roaring_or(&res, &a, &b);
+	cu_bitmap_or(&bmres, &bma, &bmb);
+	check(&res, &bmres, "or");
+
+	printf(" * and\n");
+	cu_roaring_and(&res, &a, &b);
+	cu_bitmap_and(&bmres, &bma, &bmb);
+	check(&res, &bmres, "and");
+
+	printf(" * clear_bit\n");
+	for (i=0; i<times; i+= 3) {
+		cu_roaring_clear_bit(&a, i);
+		cu_bitmap_clear_bit(&bma, i);
+	}
+	check(&a, &bma, "clear_bit");
+
+	printf(" * from/to cu_bitmap\n");
+	if (cu_roaring_from_bitmap(&res, &bmb))
+		printf(" ! from_bitmap failed\n");
+	check(&res, &bmb, "from_bitmap");
+	cu_roaring_to_bitmap(&a, &bmres);
+	check(&a, &bmres, "to_bitmap");
+
+	cu_roaring_deinit(&a);
+	cu_roaring_deinit(&b);
+	cu_roaring_deinit(&res);
+	cu_bitmap_deinit(&bma);
+	cu_bitmap_deinit(&bmb);
+	cu_bitmap_deinit(&bmres);
+
+	return 0;
+}
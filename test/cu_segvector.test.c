@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "cu_vector_uint.h"
+#include "cu_segvector_uint.h"
+#include "cu_segvector_ptrs.h"
+
+/* buil with:  
+   gcc -g -O2 -Wall -o cu_segvector.test -I../include/ cu_segvector.test.c
+*/
+
+#define times (unsigned int) 50000000
+//#define VERBOSE
+
+int main() {
+	unsigned int i;
+	size_t c, n, k;
+	unsigned long long sum, expected;
+	clock_t start;
+	struct cu_segvector_uint v;
+	struct cu_vector_uint u;
+	printf(" * test cu_segvector\n");
+
+	cu_segvector_uint_init(&v);
+
+	printf(" * push_back\n");
+	start = clock();
+	cu_segvector_uint_push_back(&v, 0);
+	unsigned int* first = cu_segvector_uint_ptr(&v, 0);
+	for (i=1; i<times; i++)
+		cu_segvector_uint_push_back(&v, i);
+	printf("   %f secs\n", (double)(clock() - start)/CLOCKS_PER_SEC);
+	if (cu_segvector_uint_size(&v) != times || first != cu_segvector_uint_ptr(&v, 0))
+		printf(" ! push_back moved the elements\n");
+	for (i=0; i<times; i+= 3)
+		if (cu_segvector_uint_at(&v, i) != i) {
+			printf(" ! at failed at place %d\n", i);
+			break;
+		}
+
+	printf(" * cu_vector_uint push_back\n");
+	start = clock();
+	cu_vector_uint_init(&u);
+	for (i=0; i<times; i++)
+		cu_vector_uint_push_back(&u, i);
+	printf("   %f secs\n", (double)(clock() - start)/CLOCKS_PER_SEC);
+
+	printf(" * chunk loop\n");
+	start = clock();
+	sum = 0;
+	for (c=0; c< cu_segvector_uint_chunks(&v); c++) {
+		unsigned int* d = cu_segvector_uint_chunk(&v, c, &n);
+		for (k=0; k< n; k++)
+			sum += d[k];
+	}
+	printf("   %f secs\n", (double)(clock() - start)/CLOCKS_PER_SEC);
+	expected = (unsigned long long)times*(times - 1)/2;
+	if (sum != expected)
+		printf(" ! chunk loop failed\n");
+
+	printf(" * append\n");
+	cu_segvector_uint_clear(&v);
+	cu_segvector_uint_push_back(&v, 7);
+	cu_segvector_uint_append(&v, cu_vector_uint_data(&u), times);
+	if (cu_segvector_uint_size(&v) != times + 1 || cu_segvector_uint_at(&v, 0) != 7
+	    || first != cu_segvector_uint_ptr(&v, 0))
+		printf(" ! append failed\n");
+	for (i=0; i<times; i+= 5)
+		if (cu_segvector_uint_at(&v, i + 1) != i) {
+			printf(" ! append failed at place %d\n", i);
+			break;
+		}
+	cu_segvector_uint_set(&v, times, 1);
+	if (cu_segvector_uint_at(&v, times) != 1)
+		printf(" ! set failed\n");
+
+	cu_segvector_uint_clear(&v);
+	cu_segvector_uint_append(&v, cu_vector_uint_data(&u), cu_SEGVECTOR_CHUNK + 1);
+	cu_segvector_uint_shrink_to_fit(&v);
+	if (cu_segvector_uint_chunks(&v) != 2 || cu_vector_ptrs_size(&v.chunks) != 2)
+		printf(" ! shrink_to_fit failed\n");
+	cu_vector_uint_deinit(&u);
+	cu_segvector_uint_deinit(&v);
+
+	printf(" * pointers\n");
+	struct cu_segvector_ptrs p;
+	cu_segvector_ptrs_init(&p);
+	cu_segvector_ptrs_reserve(&p, 3*cu_SEGVECTOR_CHUNK);
+	for (i=0; i< 10000; i++)
+		cu_segvector_ptrs_push_back(&p, &p);
+	if (cu_vector_ptrs_size(&p.chunks) != 3 || cu_segvector_ptrs_at(&p, 9999) != &p)
+		printf(" ! pointers failed\n");
+	cu_segvector_ptrs_deinit(&p);
+	return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cu_vector_uint.h"
+#include "cu_smallvector_uint.h"
+
+/* buil with:  
+   gcc -g -O2 -Wall -o cu_smallvector.test -I../include/ cu_smallvector.test.c
+*/
+
+#define times (unsigned int) 2000000
+#define DEGREE 4
+//#define VERBOSE
+
+int main() {
+	unsigned int i, k, values[20];
+	clock_t start;
+	printf(" * test cu_smallvector\n");
+
+	printf(" * %u lists of %u cu_vector_uint\n", times, DEGREE);
+	start = clock();
+	struct cu_vector_uint* vectors = malloc(times*sizeof(struct cu_vector_uint));
+	for (i=0; i<times; i++) {
+		cu_vector_uint_init(vectors + i);
+		for (k=0; k< DEGREE; k++)
+			cu_vector_uint_push_back(vectors + i, i + k);
+	}
+	for (i=0; i<times; i++)
+		cu_vector_uint_deinit(vectors + i);
+	free(vectors);
+	printf("   %f secs\n", (double)(clock() - start)/CLOCKS_PER_SEC);
+
+	printf(" * %u lists of %u cu_smallvector_uint\n", times, DEGREE);
+	start = clock();
+	struct cu_smallvector_uint* lists = malloc(times*sizeof(struct cu_smallvector_uint));
+	for (i=0; i<times; i++) {
+		cu_smallvector_uint_init(lists + i);
+		for (k=0; k< DEGREE; k++)
+			cu_smallvector_uint_push_back(lists + i, i + k);
+	}
+	for (i=0; i<times; i++)
+		if (cu_smallvector_uint_reserved(lists + i) != 6
+		    || cu_smallvector_uint_at(lists + i, DEGREE - 1) != i + DEGREE - 1) {
+			printf(" ! push_back failed at place %d\n", i);
+			break;
+		}
+	for (i=0; i<times; i++)
+		cu_smallvector_uint_deinit(lists + i);
+	free(lists);
+	printf("   %f secs\n", (double)(clock() - start)/CLOCKS_PER_SEC);
+
+	printf(" * spill and shrink\n");
+	struct cu_smallvector_uint v;
+	cu_smallvector_uint_init(&v);
+	for (i=0; i< 20; i++)
+		values[i] = i*3;
+	cu_smallvector_uint_append(&v, values, 5);
+	cu_smallvector_uint_push_back(&v, 15);
+	if (cu_smallvector_uint_reserved(&v) != 6)
+		printf(" ! spilled too early\n");
+	cu_smallvector_uint_push_back(&v, 18);
+	cu_smallvector_uint_append(&v, values + 7, 13);
+	if (cu_smallvector_uint_size(&v) != 20 || cu_smallvector_uint_reserved(&v) < 20
+	    || memcmp(cu_smallvector_uint_data(&v), values, sizeof(values)))
+		printf(" ! spill failed\n");
+	cu_smallvector_uint_erase_range(&v, 2, 16);
+	cu_smallvector_uint_shrink_to_fit(&v);
+	if (cu_smallvector_uint_size(&v) != 4 || cu_smallvector_uint_reserved(&v) != 6
+	    || cu_smallvector_uint_at(&v, 1) != 3 || cu_smallvector_uint_at(&v, 2) != 54)
+		printf(" ! shrink_to_fit failed\n");
+	cu_smallvector_uint_set(&v, 3, 1);
+	if (cu_smallvector_uint_at(&v, 3) != 1)
+		printf(" ! set failed\n");
+	cu_smallvector_uint_deinit(&v);
+	return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "cu_vector_uint.h"
+#include "cu_bitmap.h"
+#include "cu_stream.h"
+
+/* buil with:  
+   gcc -g -O2 -Wall -o cu_stream.test -I../include/ cu_stream.test.c
+*/
+
+#define times (unsigned int) 3000000
+#define STREAM_FILE "/tmp/cu_stream.test"
+//#define VERBOSE
+
+/* toy codec: run length encoding of bytes, as (count, byte) pairs */
+static size_t rle_compress(void* ctx, const void* src, size_t n, void* dst, size_t cap)
+{
+	const unsigned char* s = (const unsigned char*)src;
+	unsigned char* d = (unsigned char*)dst;
+	size_t i = 0, k = 0;
+	(void)ctx;
+	while (i < n) {
+		size_t run = 1;
+		while (i + run < n && run < 255 && s[i + run] == s[i])
+			run++;
+		if (k + 2 > cap)
+			return 0;
+		d[k++] = (unsigned char)run;
+		d[k++] = s[i];
+		i += run;
+	}
+	return k;
+}
+
+static size_t rle_decompress(void* ctx, const void* src, size_t n, void* dst, size_t cap)
+{
+	const unsigned char* s = (const unsigned char*)src;
+	unsigned char* d = (unsigned char*)dst;
+	size_t i, k = 0;
+	(void)ctx;
+	for (i=0; i+1< n; i+= 2) {
+		if (k + s[i] > cap)
+			return 0;
+		memset(d + k, s[i+1], s[i]);
+		k += s[i];
+	}
+	return k;
+}
+
+static const struct cu_stream_codec rle = { rle_compress, rle_decompress, NULL };
+
+/* writes a vector, a bitmap and a memblock, reads them back */
+static void round_trip(const struct cu_stream_codec* codec, const char* what)
+{
+	struct cu_stream_writer w;
+	struct cu_stream_reader r;
+	struct cu_vector_uint v, rv;
+	struct cu_bitmap bm, rbm;
+	struct cu_memblock mb, rmb;
+	unsigned int i;
+	int fd;
+
+	cu_vector_uint_init(&v);
+	cu_vector_uint_init(&rv);
+	for (i=0; i<times; i++)
+		cu_vector_uint_push_back(&v, i < times/2 ? i : 0);
+	cu_bitmap_init(&bm, times);
+	cu_bitmap_init(&rbm, 1);
+	cu_bitmap_clear(&bm);
+	for (i=0; i<times; i+= 3)
+		cu_bitmap_set_bit(&bm, i);
+	cu_memblock_init(&mb, 1000);
+	cu_memblock_init(&rmb, 1);
+	memset(mb.mem, 0x5a, 1000);
+
+	fd = open(STREAM_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (cu_stream_writer_init(&w, fd, codec)
+	    || cu_stream_write_vector(&w, &v.ac)
+	    || cu_stream_write_bitmap(&w, &bm)
+	    || cu_stream_write_memblock(&w, &mb)
+	    || cu_stream_writer_finish(&w))
+		printf(" ! %s: write failed\n", what);
+	cu_stream_writer_deinit(&w);
+#ifdef VERBOSE
+	printf("   %ld bytes\n", (long)lseek(fd, 0, SEEK_CUR));
+#endif
+	close(fd);
+
+	fd = open(STREAM_FILE, O_RDONLY);
+	if (cu_stream_reader_init(&r, fd, codec)
+	    || cu_stream_read_vector(&r, &rv.ac)
+	    || cu_stream_read_bitmap(&r, &rbm)
+	    || cu_stream_read_memblock(&r, &rmb))
+		printf(" ! %s: read failed\n", what);
+	else if (cu_vector_uint_size(&rv) != times
+	         || memcmp(cu_vector_uint_data(&rv), cu_vector_uint_data(&v), times*sizeof(unsigned int))
+	         || cu_bitmap_size(&rbm) != times || cu_bitmap_popcount(&rbm) != (times + 2)/3
+	         || rmb.size != 1000 || memcmp(rmb.mem, mb.mem, 1000))
+		printf(" ! %s: read back different contents\n", what);
+	cu_stream_reader_deinit(&r);
+	close(fd);
+
+	cu_memblock_deinit(&rmb);
+	cu_memblock_deinit(&mb);
+	cu_bitmap_deinit(&rbm);
+	cu_bitmap_deinit(&bm);
+	cu_vector_uint_deinit(&rv);
+	cu_vector_uint_deinit(&v);
+}
+
+int main() {
+	struct cu_stream_reader r;
+	struct cu_vector_uint v;
+	unsigned int i;
+	int fd;
+	printf(" * test cu_stream\n");
+
+	printf(" * crc32c\n");
+	if (cu_stream_crc32c(0, "123456789", 9) != 0xe3069283
+	    || cu_stream_crc32c(cu_stream_crc32c(0, "1234", 4), "56789", 5) != 0xe3069283)
+		printf(" ! crc32c failed\n");
+
+	printf(" * stored chunks\n");
+	round_trip(NULL, "stored");
+
+	printf(" * compressed chunks\n");
+	round_trip(&rle, "compressed");
+
+	printf(" * detect corruption\n");
+	fd = open(STREAM_FILE, O_RDWR);
+	lseek(fd, 4000, SEEK_SET);
+	i = 0xdeadbeef;
+	if (write(fd, &i, sizeof(i)) != sizeof(i))
+		printf(" ! can't corrupt the stream\n");
+	lseek(fd, 0, SEEK_SET);
+	cu_vector_uint_init(&v);
+	if (!cu_stream_reader_init(&r, fd, &rle) && !cu_stream_read_vector(&r, &v.ac))
+		printf(" ! corruption not detected\n");
+	cu_stream_reader_deinit(&r);
+	cu_vector_uint_deinit(&v);
+	close(fd);
+
+	printf(" * reject bad record sizes\n");
+	struct cu_stream_writer w;
+	fd = open(STREAM_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (cu_stream_writer_init(&w, fd, NULL)
+	    || cu_stream_write_record(&w, cu_STREAM_VECTOR, sizeof(unsigned int), SIZE_MAX/2)
+	    || cu_stream_writer_finish(&w))
+		printf(" ! can't write a bad record\n");
+	cu_stream_writer_deinit(&w);
+	close(fd);
+	fd = open(STREAM_FILE, O_RDONLY);
+	cu_vector_uint_init(&v);
+	if (cu_stream_reader_init(&r, fd, NULL) || cu_stream_read_vector(&r, &v.ac) != -1
+	    || cu_vector_uint_size(&v))
+		printf(" ! bad vector size not rejected\n");
+	cu_stream_reader_deinit(&r);
+	cu_vector_uint_deinit(&v);
+	close(fd);
+
+	unlink(STREAM_FILE);
+	return 0;
+}
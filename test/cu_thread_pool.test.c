@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2007-2008 Riccardo Lucchese, riccardo.lucchese at gmail.com
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "cu_parallel.h"
+
+/* buil with:  
+   gcc -g -O2 -Wall -pthread -o cu_thread_pool.test -I../include/ cu_thread_pool.test.c
+*/
+
+#define times (unsigned int) 100000000
+#define THREADS 4
+//#define VERBOSE
+
+
+static double now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+static void mark(size_t begin, size_t end, void* data)
+{
+	unsigned char* seen = (unsigned char*)data;
+	for (size_t i=begin; i< end; i++)
+		seen[i] ++;
+}
+
+static void count(size_t begin, size_t end, void* partial, void* data)
+{
+	(void)data;
+	*(size_t*)partial += end - begin;
+}
+
+static void add(void* result, const void* partial, void* data)
+{
+	(void)data;
+	*(size_t*)result += *(const size_t*)partial;
+}
+
+static unsigned int twice(unsigned int x)
+{
+	return x*2;
+}
+
+static void* next(void* p)
+{
+	return (char*)p + 1;
+}
+
+static cu_BITMAP_WORD invert(cu_BITMAP_WORD w)
+{
+	return ~w;
+}
+
+int main() {
+	struct cu_thread_pool pool;
+	struct cu_vector_uint v, w;
+	struct cu_vector_ptrs p, q;
+	struct cu_bitmap bm, bm2;
+	unsigned char seen[100000];
+	size_t i, n, total;
+	uint64_t sum;
+	double start;
+	printf(" * test cu_thread_pool\n");
+
+	cu_thread_pool_init(&pool, THREADS);
+
+	printf(" * parallel_for\n");
+	for (n=0; n< 100000; n = n*3 + 1) {
+		memset(seen, 0, sizeof(seen));
+		cu_thread_pool_parallel_for(&pool, n, n % 7, mark, seen);
+		for (i=0; i< sizeof(seen); i++)
+			if (seen[i] != (i < n)) {
+				printf(" ! parallel_for failed at place %zu of %zu\n", i, n);
+				break;
+			}
+	}
+
+	printf(" * parallel_reduce\n");
+	total = 0;
+	cu_thread_pool_parallel_reduce(&pool, 12345678, 1000, count, add,
+	                               &total, sizeof(total), NULL);
+	if (total != 12345678)
+		printf(" ! parallel_reduce failed\n");
+
+	printf(" * vector_uint\n");
+	cu_vector_uint_init(&v);
+	cu_vector_uint_init(&w);
+	cu_vector_uint_resize(&v, times, 0);
+	cu_parallel_vector_uint_fill(&pool, &v, 3);
+	cu_parallel_vector_uint_transform(&pool, &w, &v, twice);
+	if (cu_vector_uint_size(&w) != times || cu_vector_uint_at(&w, times - 1) != 6)
+		printf(" ! transform failed\n");
+	start = now();
+	sum = cu_parallel_vector_uint_sum(&pool, &w);
+	printf("   parallel sum %f secs\n", now() - start);
+	start = now();
+	if (sum != cu_vector_uint_sum(&w) || sum != (uint64_t)times*6)
+		printf(" ! sum failed\n");
+	printf("   sum %f secs\n", now() - start);
+	cu_vector_uint_set(&v, 12345, 1);
+	cu_parallel_vector_uint_clone(&pool, &w, &v);
+	if (cu_vector_uint_size(&w) != times
+	    || memcmp(cu_vector_uint_data(&w), cu_vector_uint_data(&v), times*sizeof(unsigned int)))
+		printf(" ! clone failed\n");
+	cu_vector_uint_deinit(&w);
+	cu_vector_uint_deinit(&v);
+
+	printf(" * vector_ptrs\n");
+	cu_vector_ptrs_init(&p);
+	cu_vector_ptrs_init(&q);
+	cu_vector_ptrs_resize(&p, times/10, NULL);
+	cu_parallel_vector_ptrs_fill(&pool, &p, seen);
+	cu_parallel_vector_ptrs_transform(&pool, &q, &p, next);
+	cu_parallel_vector_ptrs_clone(&pool, &p, &q);
+	for (i=0; i< times/10; i+= 997)
+		if (cu_vector_ptrs_at(&p, i) != seen + 1) {
+			printf(" ! ptrs failed at place %zu\n", i);
+			break;
+		}
+	cu_vector_ptrs_deinit(&q);
+	cu_vector_ptrs_deinit(&p);
+
+	printf(" * bitmap\n");
+	cu_bitmap_init(&bm, times + 5);
+	cu_bitmap_init(&bm2, 10);
+	cu_parallel_bitmap_fill(&pool, &bm, 1);
+	if (cu_parallel_bitmap_popcount(&pool, &bm) != times + 5 || cu_bitmap_popcount(&bm) != times + 5)
+		printf(" ! fill failed\n");
+	cu_bitmap_clear_bit(&bm, 7);
+	cu_parallel_bitmap_clone(&pool, &bm2, &bm);
+	cu_parallel_bitmap_transform(&pool, &bm2, &bm2, invert);
+	if (cu_bitmap_size(&bm2) != times + 5 || cu_parallel_bitmap_popcount(&pool, &bm2) != 1
+	    || !cu_bitmap_get_bit(&bm2, 7))
+		printf(" ! transform failed\n");
+	cu_bitmap_deinit(&bm2);
+	cu_bitmap_deinit(&bm);
+
+	cu_thread_pool_deinit(&pool);
+	return 0;
+}
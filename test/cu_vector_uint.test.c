@@ -37,15 +37,28 @@
 
 //#define BENCH_RESERVE
 #define BENCH_PUSH_BACK
+#define BENCH_ARENA
+#define BENCH_GROWTH
+#define BENCH_GENERIC
+#define BENCH_BULK
+#define BENCH_SIMD
+#define BENCH_SORT
 
 #ifdef BENCH_LIBSB
 #include "cu_vector_uint.h"
+#include "cu_vector_uint_sort.h"
+#include "cu_arena.h"
 #endif
 
 #ifdef BENCH_STD
 #include <vector>
 #endif
 
+#ifdef BENCH_GENERIC
+cu_VECTOR_DECLARE(double, double);
+cu_VECTOR_DEFINE(double, double)
+#endif
+
 int main() {
 	unsigned int i;
 	printf(" * test cu_vector_uint\n");
@@ -122,6 +135,293 @@ int main() {
 		}
 	}
 #endif
+#endif
+
+#ifdef BENCH_ARENA
+#ifdef BENCH_LIBSB
+	printf(" * arena \n");
+	{
+		struct cu_arena arena;
+		cu_arena_init(&arena, 0);
+
+		for (i=1; i< times/100000; i++)
+		{
+			struct cu_vector_uint vectors[16];
+			unsigned int j, k;
+			for (j=0; j< 16; j++) {
+				cu_vector_uint_init_allocator(&vectors[j], cu_arena_allocator(&arena));
+				for (k=0; k< i; k++)
+					cu_vector_uint_push_back(&vectors[j], k*j);
+			}
+			for (j=0; j< 16; j++)
+				for (k=0; k< i; k++)
+					if (cu_vector_uint_at(&vectors[j], k) != k*j)
+						printf(" ! values differ at iteration: %d:\n", i);
+			cu_arena_reset(&arena);
+		}
+		cu_arena_deinit(&arena);
+	}
+#endif
+#endif
+
+#ifdef BENCH_GROWTH
+#ifdef BENCH_LIBSB
+	printf(" * growth policies \n");
+	{
+		unsigned int policy;
+		for (policy = cu_ARRAY_CONTAINER_GROW_FACTOR; policy <= cu_ARRAY_CONTAINER_GROW_SIZE_CLASS; policy++)
+		{
+			struct cu_vector_uint vector;
+			unsigned int reserved;
+			cu_vector_uint_init(&vector);
+			cu_vector_uint_set_growth(&vector, policy,
+			                          policy == cu_ARRAY_CONTAINER_GROW_INCREMENT ? 1000 : 24);
+			cu_vector_uint_set_min_reserved(&vector, 3);
+
+			for (i=0; i< times/100; i++)
+				cu_vector_uint_push_back(&vector, i);
+			for (i=0; i< times/100; i++)
+				if (cu_vector_uint_at(&vector, i) != i)
+					printf(" ! values differ at %d, policy %d\n", i, policy);
+
+			reserved = cu_vector_uint_reserved(&vector);
+			cu_vector_uint_clear(&vector);
+			if (cu_vector_uint_size(&vector) || cu_vector_uint_reserved(&vector) != reserved)
+				printf(" ! clear didn't keep capacity, policy %d\n", policy);
+			cu_vector_uint_push_back(&vector, 1);
+			cu_vector_uint_shrink_to_fit(&vector);
+			if (cu_vector_uint_reserved(&vector) != 3 || cu_vector_uint_at(&vector, 0) != 1)
+				printf(" ! shrink_to_fit failed, policy %d\n", policy);
+			cu_vector_uint_deinit(&vector);
+		}
+	}
+#endif
+#endif
+
+#ifdef BENCH_BULK
+#ifdef BENCH_LIBSB
+	printf(" * bulk append, insert and erase \n");
+	{
+		struct cu_vector_uint vector, copy;
+		unsigned int chunk[10000];
+		cu_vector_uint_init(&vector);
+		cu_vector_uint_init(&copy);
+
+		/* batch ingest, 10K elements at a time */
+		for (i=0; i< times; i+= 10000) {
+			unsigned int k;
+			for (k=0; k< 10000; k++)
+				chunk[k] = i + k;
+			cu_vector_uint_append(&vector, chunk, 10000);
+		}
+		for (i=0; i< times; i++)
+			if (cu_vector_uint_at(&vector, i) != i)
+				printf(" ! append failed at %d\n", i);
+
+		cu_vector_uint_clone(&copy, &vector);
+		if (cu_vector_uint_size(&copy) != times
+		    || memcmp(cu_vector_uint_data(&copy), cu_vector_uint_data(&vector), times*sizeof(unsigned int)))
+			printf(" ! clone failed\n");
+
+		/* move [10, 20) in front of the vector and back */
+		cu_vector_uint_insert_range(&vector, 0, chunk + 10, 10);
+		cu_vector_uint_erase_range(&vector, 0, 10);
+		cu_vector_uint_erase_range(&copy, 10, times - 20);
+		cu_vector_uint_insert_range(&copy, 10, chunk, 5);
+		if (cu_vector_uint_size(&vector) != times || cu_vector_uint_at(&vector, 0) != 0
+		    || cu_vector_uint_size(&copy) != 25 || cu_vector_uint_at(&copy, 9) != 9
+		    || cu_vector_uint_at(&copy, 10) != chunk[0] || cu_vector_uint_at(&copy, 15) != times - 10)
+			printf(" ! insert_range/erase_range failed\n");
+
+		cu_vector_uint_resize(&copy, 100, 7);
+		if (cu_vector_uint_at(&copy, 24) != times - 1 || cu_vector_uint_at(&copy, 99) != 7)
+			printf(" ! resize failed\n");
+		cu_vector_uint_resize(&copy, 3, 7);
+		if (cu_vector_uint_size(&copy) != 3 || cu_vector_uint_at(&copy, 2) != 2)
+			printf(" ! resize failed\n");
+
+		cu_vector_uint_deinit(&copy);
+		cu_vector_uint_deinit(&vector);
+	}
+#endif
+#endif
+
+#ifdef BENCH_SIMD
+#ifdef BENCH_LIBSB
+	printf(" * find, count, min, max, sum, lower_bound and filter \n");
+	{
+		struct cu_vector_uint vector, out;
+		unsigned int op, seed = 1, min = ~0u, max = 0, count = 0;
+		unsigned long long sum = 0;
+		cu_vector_uint_init(&vector);
+		cu_vector_uint_init(&out);
+
+		for (i=0; i< times/10 + 3; i++) {
+			unsigned int x;
+			seed = seed*1103515245 + 12345;
+			x = i == times/10 ? 12345 : seed;
+			cu_vector_uint_push_back(&vector, x);
+			min = x < min ? x : min;
+			max = x > max ? x : max;
+			sum += x;
+			count += x == 12345;
+		}
+
+		if (cu_vector_uint_find(&vector, 12345) > times/10
+		    || cu_vector_uint_at(&vector, cu_vector_uint_find(&vector, 12345)) != 12345)
+			printf(" ! find failed\n");
+		if (cu_vector_uint_count(&vector, 12345) != count)
+			printf(" ! count failed\n");
+		if (cu_vector_uint_min(&vector) != min || cu_vector_uint_max(&vector) != max)
+			printf(" ! min/max failed\n");
+		if (cu_vector_uint_sum(&vector) != sum)
+			printf(" ! sum failed\n");
+
+		for (op = cu_VECTOR_UINT_LESS; op <= cu_VECTOR_UINT_NOT_EQUAL; op++) {
+			unsigned int k = 0;
+			cu_vector_uint_clear(&out);
+			cu_vector_uint_filter(&out, &vector, op, 1u << 31);
+			for (i=0; i< cu_vector_uint_size(&vector); i++) {
+				unsigned int x = cu_vector_uint_at(&vector, i);
+				if (cu_vector_uint_match(x, op, 1u << 31)
+				    && (k >= cu_vector_uint_size(&out) || cu_vector_uint_at(&out, k++) != x))
+					break;
+			}
+			if (k != cu_vector_uint_size(&out))
+				printf(" ! filter failed, op %d\n", op);
+		}
+
+		/* lower_bound on the sorted values 0, 2, 4, ... */
+		cu_vector_uint_clear(&out);
+		for (i=0; i< 100000; i++)
+			cu_vector_uint_push_back(&out, 2*i);
+		for (i=0; i< 200001; i++)
+			if (cu_vector_uint_lower_bound(&out, i) != (i+1)/2)
+				printf(" ! lower_bound failed at %d\n", i);
+
+		cu_vector_uint_deinit(&out);
+		cu_vector_uint_deinit(&vector);
+	}
+#endif
+#endif
+
+#ifdef BENCH_SORT
+#ifdef BENCH_LIBSB
+	printf(" * radix sort, unique and sorted set operations \n");
+	{
+		struct cu_vector_uint vector, scratch, a, b, res;
+		unsigned int seed = 1, round;
+		cu_vector_uint_init(&vector);
+		cu_vector_uint_init(&scratch);
+		cu_vector_uint_init(&a);
+		cu_vector_uint_init(&b);
+		cu_vector_uint_init(&res);
+
+		for (i=0; i< times/10; i++) {
+			seed = seed*1103515245 + 12345;
+			cu_vector_uint_push_back(&vector, seed >> (i & 0x7));
+		}
+		cu_vector_uint_sort(&vector, &scratch);
+		for (i=1; i< cu_vector_uint_size(&vector); i++)
+			if (cu_vector_uint_at(&vector, i-1) > cu_vector_uint_at(&vector, i))
+				printf(" ! sort failed at %d\n", i);
+		cu_vector_uint_unique(&vector);
+		for (i=1; i< cu_vector_uint_size(&vector); i++)
+			if (cu_vector_uint_at(&vector, i-1) >= cu_vector_uint_at(&vector, i))
+				printf(" ! unique failed at %d\n", i);
+
+		/* keys below 2^11 sort in a single pass, which ends in the
+		 * scratch buffer; v must keep its arena storage */
+		{
+			struct cu_arena arena;
+			struct cu_vector_uint small;
+			unsigned int pass;
+			cu_arena_init(&arena, 0);
+			cu_vector_uint_init_allocator(&small, cu_arena_allocator(&arena));
+			for (pass=0; pass< 2; pass++) {
+				cu_vector_uint_clear(&small);
+				for (i=0; i< 10000; i++) {
+					seed = seed*1103515245 + 12345;
+					cu_vector_uint_push_back(&small, seed >> 21);
+				}
+				cu_vector_uint_sort(&small, pass ? &scratch : NULL);
+				for (i=1; i< cu_vector_uint_size(&small); i++)
+					if (cu_vector_uint_at(&small, i-1) > cu_vector_uint_at(&small, i))
+						printf(" ! arena sort failed at %d\n", i);
+				if (small.ac.mblock.allocator != cu_arena_allocator(&arena) ||
+				    scratch.ac.mblock.allocator == cu_arena_allocator(&arena))
+					printf(" ! arena sort swapped allocators\n");
+			}
+			cu_vector_uint_deinit(&small);
+			cu_arena_deinit(&arena);
+		}
+
+		/* multiples of 2 and of 3 (or of 3*65, skewed) below 6*10^6 */
+		for (round=0; round< 2; round++) {
+			unsigned int step = round ? 3*65 : 3, expect, k;
+			cu_vector_uint_clear(&a);
+			cu_vector_uint_clear(&b);
+			for (i=0; i< 6000000; i+= 2)
+				cu_vector_uint_push_back(&a, i);
+			for (i=0; i< 6000000; i+= step)
+				cu_vector_uint_push_back(&b, i);
+
+			cu_vector_uint_intersect(&res, &a, &b);
+			for (k=0, i=0; i< 6000000; i+= 6*(step/3))
+				if (k >= cu_vector_uint_size(&res) || cu_vector_uint_at(&res, k++) != i)
+					break;
+			if (k != cu_vector_uint_size(&res) || i < 6000000)
+				printf(" ! intersect failed, step %d\n", step);
+
+			cu_vector_uint_union(&res, &b, &a);
+			for (k=0, i=0; i< 6000000; i++)
+				if ((i % 2 == 0 || i % step == 0)
+				    && (k >= cu_vector_uint_size(&res) || cu_vector_uint_at(&res, k++) != i))
+					break;
+			if (k != cu_vector_uint_size(&res) || i < 6000000)
+				printf(" ! union failed, step %d\n", step);
+
+			cu_vector_uint_difference(&res, &a, &b);
+			expect = 3000000 - (6000000 + 6*(step/3) - 1)/(6*(step/3));
+			if (cu_vector_uint_size(&res) != expect || cu_vector_uint_find(&res, 0) != expect)
+				printf(" ! difference failed, step %d\n", step);
+			cu_vector_uint_difference(&res, &b, &a);
+			if (cu_vector_uint_size(&res) != cu_vector_uint_size(&b) - (3000000 - expect))
+				printf(" ! difference failed, step %d\n", step);
+		}
+
+		cu_vector_uint_deinit(&res);
+		cu_vector_uint_deinit(&b);
+		cu_vector_uint_deinit(&a);
+		cu_vector_uint_deinit(&scratch);
+		cu_vector_uint_deinit(&vector);
+	}
+#endif
+#endif
+
+#ifdef BENCH_GENERIC
+#ifdef BENCH_LIBSB
+	printf(" * generic vector of doubles \n");
+	{
+		struct cu_vector_double vector, copy;
+		double sum = 0;
+		cu_vector_double_init(&vector);
+		cu_vector_double_init(&copy);
+
+		for (i=0; i< times/10; i++)
+			cu_vector_double_push_back(&vector, i*0.5);
+		cu_vector_double_clone(&copy, &vector);
+
+		const double* d = cu_vector_double_data(&copy);
+		for (i=0; i< cu_vector_double_size(&copy); i++)
+			sum += d[i];
+		if (cu_vector_double_size(&copy) != times/10 || sum != (double)(times/10 - 1)*(times/10)/4)
+			printf(" ! generic vector failed, sum %f\n", sum);
+
+		cu_vector_double_deinit(&copy);
+		cu_vector_double_deinit(&vector);
+	}
+#endif
 #endif
 
 	return 0;